@@ -0,0 +1,172 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "AssetPreloadManager.h"
+#include "DefaultEscapePawn.h"
+#include "Components/Interactable.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "UObject/UObjectIterator.h"
+
+void UAssetPreloadManager::AddAsset(const FSoftObjectPath& Asset, int32 Priority)
+{
+	if (Asset.IsNull())
+	{
+		return;
+	}
+
+	for (FManifestAsset& ManifestAsset : Manifest)
+	{
+		if (ManifestAsset.Path == Asset)
+		{
+			ManifestAsset.Priority = FMath::Max(ManifestAsset.Priority, Priority);
+			return;
+		}
+	}
+
+	if (bHasStarted)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s was added to the preload manifest after preloading started and won't be preloaded!"), *Asset.ToString());
+		return;
+	}
+
+	FManifestAsset ManifestAsset;
+	ManifestAsset.Path = Asset;
+	ManifestAsset.Priority = Priority;
+	Manifest.Add(ManifestAsset);
+}
+
+void UAssetPreloadManager::AddAssets(const TArray<FPreloadAssetEntry>& Entries)
+{
+	for (const FPreloadAssetEntry& Entry : Entries)
+	{
+		AddAsset(Entry.Asset, Entry.Priority);
+	}
+}
+
+void UAssetPreloadManager::CollectFromWorld(UWorld* World, TSubclassOf<APawn> PawnClass)
+{
+	if (PawnClass)
+	{
+		if (const ADefaultEscapePawn* PawnDefaults = Cast<ADefaultEscapePawn>(PawnClass->GetDefaultObject()))
+		{
+			AddAssets(PawnDefaults->GetPreloadAssets());
+		}
+	}
+
+	//Interactables exist already, but haven't begun play yet; most of them ask for the same widgets, which only end up in the manifest once
+	for (TObjectIterator<UInteractable> It; It; ++It)
+	{
+		if (It->GetWorld() == World && !It->IsTemplate())
+		{
+			AddAssets(It->GetPreloadAssets());
+		}
+	}
+}
+
+void UAssetPreloadManager::StartPreloading()
+{
+	if (bHasStarted)
+	{
+		return;
+	}
+	bHasStarted = true;
+	PreloadStartTime = FPlatformTime::Seconds();
+	PendingAssetCount = Manifest.Num();
+
+	if (PendingAssetCount == 0)
+	{
+		OnPreloadComplete.Broadcast();
+		return;
+	}
+
+	//Every asset gets its own request, so each one can carry its priority and report its own timing
+	Manifest.Sort([](const FManifestAsset& A, const FManifestAsset& B) { return A.Priority > B.Priority; });
+	FStreamableManager& StreamableManager = UAssetManager::GetStreamableManager();
+	for (int32 ManifestIndex = 0; ManifestIndex < Manifest.Num(); ManifestIndex++)
+	{
+		FManifestAsset& ManifestAsset = Manifest[ManifestIndex];
+		ManifestAsset.RequestTime = FPlatformTime::Seconds();
+		ManifestAsset.Handle = StreamableManager.RequestAsyncLoad(
+			ManifestAsset.Path,
+			FStreamableDelegate::CreateUObject(this, &UAssetPreloadManager::OnAssetLoaded, ManifestIndex),
+			ManifestAsset.Priority);
+
+		//A path that couldn't be resolved produces no handle and would otherwise keep the manager from ever being ready
+		if (!ManifestAsset.Handle.IsValid() && !ManifestAsset.bIsLoaded)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Preloading %s couldn't be requested!"), *ManifestAsset.Path.ToString());
+			OnAssetLoaded(ManifestIndex);
+		}
+	}
+}
+
+bool UAssetPreloadManager::WaitForAssets(int32 MinPriority, float Timeout)
+{
+	const double EndTime = FPlatformTime::Seconds() + Timeout;
+	bool bAllLoaded = true;
+
+	for (FManifestAsset& ManifestAsset : Manifest)
+	{
+		if (ManifestAsset.Priority < MinPriority || ManifestAsset.bIsLoaded || !ManifestAsset.Handle.IsValid()) { continue; }
+
+		const float RemainingTime = FMath::Max(0.f, (float)(EndTime - FPlatformTime::Seconds()));
+		bAllLoaded &= (ManifestAsset.Handle->WaitUntilComplete(RemainingTime) == EAsyncPackageState::Complete);
+	}
+	return bAllLoaded;
+}
+
+void UAssetPreloadManager::OnAssetLoaded(int32 ManifestIndex)
+{
+	FManifestAsset& ManifestAsset = Manifest[ManifestIndex];
+	if (ManifestAsset.bIsLoaded)
+	{
+		return;
+	}
+	ManifestAsset.bIsLoaded = true;
+
+	FPreloadAssetTiming Timing;
+	Timing.Asset = ManifestAsset.Path;
+	Timing.Priority = ManifestAsset.Priority;
+	Timing.LoadMilliseconds = (FPlatformTime::Seconds() - ManifestAsset.RequestTime) * 1000.0;
+	AssetTimings.Add(Timing);
+
+	if (--PendingAssetCount > 0)
+	{
+		return;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Preloaded %d assets in %.1f ms"), Manifest.Num(), (FPlatformTime::Seconds() - PreloadStartTime) * 1000.0);
+	for (const FPreloadAssetTiming& AssetTiming : AssetTimings)
+	{
+		UE_LOG(LogTemp, Log, TEXT("    %8.1f ms  priority %4d  %s"), AssetTiming.LoadMilliseconds, AssetTiming.Priority, *AssetTiming.Asset.ToString());
+	}
+	OnPreloadComplete.Broadcast();
+}
+
+bool UAssetPreloadManager::IsReady() const
+{
+	return bHasStarted && PendingAssetCount == 0;
+}
+
+const TArray<FPreloadAssetTiming>& UAssetPreloadManager::GetAssetTimings() const
+{
+	return AssetTimings;
+}
+
+void UAssetPreloadManager::BeginDestroy()
+{
+	//Releasing the handles lets the assets be garbage collected once nothing else references them
+	for (FManifestAsset& ManifestAsset : Manifest)
+	{
+		if (ManifestAsset.Handle.IsValid())
+		{
+			ManifestAsset.Handle->CancelHandle();
+			ManifestAsset.Handle.Reset();
+		}
+	}
+
+	Super::BeginDestroy();
+}
@@ -0,0 +1,90 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "UObject/SoftObjectPath.h"
+#include "AssetPreloadManager.generated.h"
+
+class APawn;
+struct FStreamableHandle;
+
+//A single asset that should be resident before gameplay needs it; higher priorities are loaded first
+USTRUCT(BlueprintType)
+struct FPreloadAssetEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Preloading")
+	FSoftObjectPath Asset;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Preloading")
+	int32 Priority = 0;
+};
+
+//How long a single preloaded asset took, measured from the moment its request was issued
+USTRUCT(BlueprintType)
+struct FPreloadAssetTiming
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Preloading")
+	FSoftObjectPath Asset;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Preloading")
+	int32 Priority = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Preloading")
+	float LoadMilliseconds = 0.f;
+};
+
+DECLARE_MULTICAST_DELEGATE(FAssetPreloadCompleteDelegate);
+
+/**
+ * Collects a manifest of soft references to the assets gameplay uses for the first time in the middle of the action(montages, widgets, data tables)
+ * and streams them in asynchronously while the level loads. The loaded assets are kept resident for as long as the manager lives.
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UAssetPreloadManager : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	//Adding an asset that is already in the manifest only raises its priority
+	void AddAsset(const FSoftObjectPath& Asset, int32 Priority);
+	void AddAssets(const TArray<FPreloadAssetEntry>& Entries);
+	//Adds the assets requested by the pawn class and by every interactable placed in the world
+	void CollectFromWorld(UWorld* World, TSubclassOf<APawn> PawnClass);
+
+	//Issues one asynchronous request per asset in the manifest, highest priorities first
+	void StartPreloading();
+	//Blocks until every asset with at least MinPriority is loaded or the timeout runs out; returns true if they all made it
+	bool WaitForAssets(int32 MinPriority, float Timeout);
+
+	bool IsReady() const;
+	const TArray<FPreloadAssetTiming>& GetAssetTimings() const;
+
+	//Broadcast once every asset of the manifest is loaded; if that already happened it isn't broadcast again
+	FAssetPreloadCompleteDelegate OnPreloadComplete;
+
+	virtual void BeginDestroy() override;
+
+private:
+	struct FManifestAsset
+	{
+		FSoftObjectPath Path;
+		int32 Priority = 0;
+		double RequestTime = 0.0;
+		bool bIsLoaded = false;
+		TSharedPtr<FStreamableHandle> Handle;
+	};
+
+	TArray<FManifestAsset> Manifest;
+	TArray<FPreloadAssetTiming> AssetTimings;
+	int32 PendingAssetCount = 0;
+	double PreloadStartTime = 0.0;
+	bool bHasStarted = false;
+
+	void OnAssetLoaded(int32 ManifestIndex);
+};
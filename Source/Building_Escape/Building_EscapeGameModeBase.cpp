@@ -2,4 +2,62 @@
 
 
 #include "Building_EscapeGameModeBase.h"
+#include "Engine/World.h"
+#include "EscapeHUD.h"
+#include "EscapePlayerController.h"
+#include "UObject/ConstructorHelpers.h"
 
+ABuilding_EscapeGameModeBase::ABuilding_EscapeGameModeBase()
+{
+	AssetPreloadManager = CreateDefaultSubobject<UAssetPreloadManager>(TEXT("AssetPreloadManager"));
+	//Interaction indicators are drawn by the HUD in one batched pass
+	HUDClass = AEscapeHUD::StaticClass();
+	//This is the project's default game mode; it plays with the same pawn and controller the EscapeGameMode Blueprint used to set
+	PlayerControllerClass = AEscapePlayerController::StaticClass();
+	static ConstructorHelpers::FClassFinder<APawn> EscapePawnClass(TEXT("/Game/Blueprints/EscapeDefaultPlayerPawn"));
+	if (EscapePawnClass.Succeeded())
+	{
+		DefaultPawnClass = EscapePawnClass.Class;
+	}
+}
+
+void ABuilding_EscapeGameModeBase::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	//The level is loaded, but nothing has begun play yet, so the requests overlap with the rest of the level initialisation
+	AssetPreloadManager->AddAssets(PreloadAssets);
+	AssetPreloadManager->CollectFromWorld(GetWorld(), DefaultPawnClass);
+	AssetPreloadManager->OnPreloadComplete.AddUObject(this, &ABuilding_EscapeGameModeBase::OnPreloadComplete);
+	AssetPreloadManager->StartPreloading();
+}
+
+void ABuilding_EscapeGameModeBase::StartPlay()
+{
+	if (!AssetPreloadManager->IsReady() && !AssetPreloadManager->WaitForAssets(CriticalPreloadPriority, MaxCriticalPreloadWait))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Critical gameplay assets weren't loaded within %.1f s, the first use of some of them might hitch."), MaxCriticalPreloadWait);
+	}
+
+	Super::StartPlay();
+}
+
+bool ABuilding_EscapeGameModeBase::AreGameplayAssetsReady() const
+{
+	return AssetPreloadManager->IsReady();
+}
+
+TArray<FPreloadAssetTiming> ABuilding_EscapeGameModeBase::GetPreloadTimings() const
+{
+	return AssetPreloadManager->GetAssetTimings();
+}
+
+UAssetPreloadManager* ABuilding_EscapeGameModeBase::GetAssetPreloadManager() const
+{
+	return AssetPreloadManager;
+}
+
+void ABuilding_EscapeGameModeBase::OnPreloadComplete()
+{
+	OnGameplayAssetsReady.Broadcast();
+}
@@ -4,8 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "AssetPreloadManager.h"
 #include "Building_EscapeGameModeBase.generated.h"
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FGameplayAssetsReadyDelegate);
+
 /**
  * 
  */
@@ -13,5 +16,41 @@ UCLASS()
 class BUILDING_ESCAPE_API ABuilding_EscapeGameModeBase : public AGameModeBase
 {
 	GENERATED_BODY()
-	
+
+public:
+	ABuilding_EscapeGameModeBase();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
+
+	UFUNCTION(BlueprintPure, Category = "Preloading")
+	bool AreGameplayAssetsReady() const;
+
+	UFUNCTION(BlueprintPure, Category = "Preloading")
+	TArray<FPreloadAssetTiming> GetPreloadTimings() const;
+
+	//Broadcast once every asset of the preload manifest is resident
+	UPROPERTY(BlueprintAssignable, Category = "Preloading")
+	FGameplayAssetsReadyDelegate OnGameplayAssetsReady;
+
+	UAssetPreloadManager* GetAssetPreloadManager() const;
+
+protected:
+	//Assets preloaded on top of the ones the pawn and the interactables ask for
+	UPROPERTY(EditDefaultsOnly, Category = "Preloading")
+	TArray<FPreloadAssetEntry> PreloadAssets;
+
+	//Assets with at least this priority are waited for before play starts, so the first hang, slide or focus can't hitch
+	UPROPERTY(EditDefaultsOnly, Category = "Preloading")
+	int32 CriticalPreloadPriority = 100;
+
+	//Upper limit for the wait on the critical assets, in seconds
+	UPROPERTY(EditDefaultsOnly, Category = "Preloading")
+	float MaxCriticalPreloadWait = 2.f;
+
+private:
+	UPROPERTY()
+	UAssetPreloadManager* AssetPreloadManager = nullptr;
+
+	void OnPreloadComplete();
 };
@@ -0,0 +1,217 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "CheckpointBenchmarkCommandlet.h"
+#include "CommandletWorldLoader.h"
+#include "DefaultEscapePawn.h"
+#include "Components/MassTreshold.h"
+#include "Components/OpenDoor.h"
+#include "Components/ParkourMovementComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Subsystems/CheckpointSubsystem.h"
+#include "Subsystems/PhysicsPropSleepSubsystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+
+static double GetUsedPhysicalMegabytes()
+{
+	return FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0);
+}
+
+//A pawn possessed by an AI controller stands in for the player, so the capture has a pawn record to restore
+static APawn* SpawnBenchmarkPawn(UWorld* World, const FString& PawnClassPath)
+{
+	UClass* PawnClass = LoadClass<ADefaultEscapePawn>(nullptr, *PawnClassPath);
+	if (!PawnClass)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Pawn class %s couldn't be loaded, native defaults of ADefaultEscapePawn will be used instead."), *PawnClassPath);
+		PawnClass = ADefaultEscapePawn::StaticClass();
+	}
+
+	FTransform SpawnTransform = FTransform::Identity;
+	for (TActorIterator<APlayerStart> It(World); It; ++It)
+	{
+		SpawnTransform = It->GetActorTransform();
+		break;
+	}
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	APawn* Pawn = World->SpawnActor<APawn>(PawnClass, SpawnTransform, SpawnParameters);
+	if (Pawn)
+	{
+		Pawn->SpawnDefaultController();
+	}
+	if (!Pawn || !Pawn->GetController())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No controlled pawn could be spawned, the checkpoint won't contain a pawn record."));
+	}
+	return Pawn;
+}
+
+//Changes everything a checkpoint covers, so the restore that follows has real work to do: doors reverse, every prop takes the place of the next one
+//(moving props on and off the plates), and the pawn is moved, crouched and set in motion
+static void ChangeCheckpointedState(UWorld* World, APawn* Pawn, int32 Iteration)
+{
+	for (TObjectIterator<UOpenDoor> It; It; ++It)
+	{
+		if (It->GetWorld() == World && It->HasBegunPlay())
+		{
+			It->ToggleShouldBeOpened(!It->GetMotionState().bIsOpen);
+		}
+	}
+
+	TArray<FVector> PlateLocations;
+	for (TObjectIterator<UMassTreshold> It; It; ++It)
+	{
+		if (It->GetWorld() == World && It->HasBegunPlay() && It->GetAttachParent())
+		{
+			PlateLocations.Add(It->GetAttachParent()->GetComponentLocation());
+		}
+	}
+
+	if (UPhysicsPropSleepSubsystem* SleepSubsystem = World->GetSubsystem<UPhysicsPropSleepSubsystem>())
+	{
+		TArray<UPrimitiveComponent*> Bodies;
+		SleepSubsystem->GetRegisteredBodies(OUT Bodies);
+		TArray<FVector> Locations;
+		for (UPrimitiveComponent* Body : Bodies)
+		{
+			Locations.Add(Body->GetComponentLocation());
+		}
+		//The first props go onto the plates, the others shift by one; the plate each prop lands on changes every iteration
+		for (int32 BodyIndex = 0; BodyIndex < Bodies.Num(); BodyIndex++)
+		{
+			const FVector NewLocation = BodyIndex < PlateLocations.Num()
+				? PlateLocations[(BodyIndex + Iteration) % PlateLocations.Num()] + FVector(0.f, 0.f, 20.f)
+				: Locations[(BodyIndex + 1) % Locations.Num()];
+			Bodies[BodyIndex]->SetWorldLocation(NewLocation, false, nullptr, ETeleportType::TeleportPhysics);
+		}
+	}
+
+	UParkourMovementComponent* ParkourMovement = Pawn ? Pawn->FindComponentByClass<UParkourMovementComponent>() : nullptr;
+	if (ParkourMovement)
+	{
+		Pawn->TeleportTo(Pawn->GetActorLocation() + FVector(100.f, 50.f, 0.f), Pawn->GetActorRotation() + FRotator(0.f, 90.f, 0.f), false, true);
+		ParkourMovement->SetMovementMode(MOVE_Falling);
+		ParkourMovement->Velocity = FVector(300.f, 0.f, 200.f);
+		ParkourMovement->Crouch();
+	}
+}
+
+UCheckpointBenchmarkCommandlet::UCheckpointBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UCheckpointBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString MapName = TEXT("/Game/Levels/BuildingEscape1");
+	FParse::Value(*Params, TEXT("Map="), MapName);
+
+	FString PawnClassPath = TEXT("/Game/Blueprints/EscapeDefaultPlayerPawn.EscapeDefaultPlayerPawn_C");
+	FParse::Value(*Params, TEXT("Pawn="), PawnClassPath);
+
+	int32 Iterations = 20;
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	Iterations = FMath::Max(Iterations, 1);
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("CheckpointBenchmark") / FPackageName::GetShortName(MapName) + TEXT(".txt");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	UWorld* World = CommandletWorldLoader::LoadWorld(MapName);
+	if (!World)
+	{
+		return 1;
+	}
+	CommandletWorldLoader::BeginPlay(World);
+
+	UCheckpointSubsystem* Checkpoints = World->GetSubsystem<UCheckpointSubsystem>();
+	if (!Checkpoints)
+	{
+		UE_LOG(LogTemp, Error, TEXT("The world of %s has no checkpoint subsystem!"), *MapName);
+		CommandletWorldLoader::ReleaseWorld(World);
+		return 1;
+	}
+
+	APawn* Pawn = SpawnBenchmarkPawn(World, PawnClassPath);
+
+	//Every iteration captures the world, changes it and goes back to the capture in the same world, which is what retrying a room does.
+	//Only the capture and the restore are timed
+	FCheckpoint Checkpoint;
+	double CaptureSeconds = 0.0;
+	double RestoreSeconds = 0.0;
+	double MaxRestoreSeconds = 0.0;
+	const double MemoryBeforeRestores = GetUsedPhysicalMegabytes();
+	double PeakRestoreMemory = MemoryBeforeRestores;
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		double StartTime = FPlatformTime::Seconds();
+		Checkpoints->CaptureCheckpoint(OUT Checkpoint);
+		CaptureSeconds += FPlatformTime::Seconds() - StartTime;
+
+		ChangeCheckpointedState(World, Pawn, Iteration);
+
+		StartTime = FPlatformTime::Seconds();
+		Checkpoints->RestoreCheckpoint(Checkpoint);
+		const double IterationSeconds = FPlatformTime::Seconds() - StartTime;
+		RestoreSeconds += IterationSeconds;
+		MaxRestoreSeconds = FMath::Max(MaxRestoreSeconds, IterationSeconds);
+		PeakRestoreMemory = FMath::Max(PeakRestoreMemory, GetUsedPhysicalMegabytes());
+	}
+	const FCheckpointStats Stats = Checkpoints->GetStats();
+	CommandletWorldLoader::ReleaseWorld(World);
+
+	//A reload tears the level down and loads it again; both halves count, since both happen when a room is retried that way
+	double ReloadSeconds = 0.0;
+	double MaxReloadSeconds = 0.0;
+	const double MemoryBeforeReloads = GetUsedPhysicalMegabytes();
+	double PeakReloadMemory = MemoryBeforeReloads;
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		World = CommandletWorldLoader::LoadWorld(MapName);
+		if (!World)
+		{
+			return 1;
+		}
+		CommandletWorldLoader::BeginPlay(World);
+		PeakReloadMemory = FMath::Max(PeakReloadMemory, GetUsedPhysicalMegabytes());
+		CommandletWorldLoader::ReleaseWorld(World);
+
+		const double IterationSeconds = FPlatformTime::Seconds() - StartTime;
+		ReloadSeconds += IterationSeconds;
+		MaxReloadSeconds = FMath::Max(MaxReloadSeconds, IterationSeconds);
+	}
+
+	const double AverageRestoreMilliseconds = RestoreSeconds * 1000.0 / Iterations;
+	const double AverageReloadMilliseconds = ReloadSeconds * 1000.0 / Iterations;
+
+	FString Report;
+	Report += FString::Printf(TEXT("Checkpoint benchmark report for %s, %d iterations\n"), *MapName, Iterations);
+	Report += FString::Printf(TEXT("Checkpoint: %d records, %d bytes, %d records skipped on the last restore\n"), Stats.LastRecords, Stats.LastSizeBytes, Stats.LastSkippedRecords);
+	Report += FString::Printf(TEXT("Capture: %.3f ms average\n"), CaptureSeconds * 1000.0 / Iterations);
+	Report += FString::Printf(TEXT("Restore: %.3f ms average, %.3f ms max, peak memory growth %.1f MB\n"), AverageRestoreMilliseconds, MaxRestoreSeconds * 1000.0, PeakRestoreMemory - MemoryBeforeRestores);
+	Report += FString::Printf(TEXT("Reload: %.3f ms average, %.3f ms max, peak memory growth %.1f MB\n"), AverageReloadMilliseconds, MaxReloadSeconds * 1000.0, PeakReloadMemory - MemoryBeforeReloads);
+	if (AverageRestoreMilliseconds > 0.0)
+	{
+		Report += FString::Printf(TEXT("Restoring is %.1f times faster than reloading\n"), AverageReloadMilliseconds / AverageRestoreMilliseconds);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("%s"), *Report);
+	if (!FFileHelper::SaveStringToFile(Report, *OutputPath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to write the report to %s"), *OutputPath);
+	}
+	return 0;
+}
@@ -0,0 +1,28 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CheckpointBenchmarkCommandlet.generated.h"
+
+/**
+ * Compares restoring a checkpoint with reloading the level, which is what retrying a room took before. The map is loaded and begun play on, and a pawn
+ * possessed by an AI controller is spawned at the first player start to stand in for the player. Every iteration captures a checkpoint, toggles the doors,
+ * moves the props onto the plates and each other's places, moves the pawn, and restores the checkpoint; the level is then released and loaded again as
+ * many times. The report lists the times of both and how much the used physical memory grew over each, next to the size of the checkpoint.
+ * Physics isn't simulated in a commandlet, so the bodies are only teleported, and door motions aren't advanced between the change and the restore.
+ *
+ * Usage: UE4Editor-Cmd Building_Escape.uproject -run=CheckpointBenchmark -Map=/Game/Levels/BuildingEscape1
+ *        [-Pawn=<pawn class path>] [-Iterations=20] [-Output=<report path>]
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UCheckpointBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCheckpointBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,98 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "CommandletWorldLoader.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreaming.h"
+#include "EngineUtils.h"
+#include "GameFramework/WorldSettings.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+UWorld* CommandletWorldLoader::LoadWorld(const FString& MapName)
+{
+	//Short names are resolved against the content directories
+	FString PackageName = MapName;
+	if (!FPackageName::IsValidLongPackageName(PackageName) && !FPackageName::SearchForPackageOnDisk(MapName, &PackageName))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Map %s could not be found!"), *MapName);
+		return nullptr;
+	}
+
+	UPackage* MapPackage = LoadPackage(nullptr, *PackageName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Package %s doesn't contain a world!"), *PackageName);
+		return nullptr;
+	}
+
+	//The world has to survive garbage collection for as long as the commandlet works on it
+	World->AddToRoot();
+	World->WorldType = EWorldType::Editor;
+
+	if (!World->bIsWorldInitialized)
+	{
+		UWorld::InitializationValues InitValues;
+		InitValues
+			.ShouldSimulatePhysics(false)
+			.EnableTraceCollision(true)
+			.CreatePhysicsScene(true)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.AllowAudioPlayback(false)
+			.RequiresHitProxies(false);
+		World->InitWorld(InitValues);
+	}
+
+	//Registering the components creates their physics bodies, which is what the traces run against
+	World->PersistentLevel->UpdateModelComponents();
+	World->UpdateWorldComponents(true, false);
+
+	//Every sublevel is brought in as well, so the commandlets see the whole map
+	for (ULevelStreaming* StreamingLevel : World->GetStreamingLevels())
+	{
+		if (StreamingLevel)
+		{
+			StreamingLevel->SetShouldBeLoaded(true);
+			StreamingLevel->SetShouldBeVisible(true);
+		}
+	}
+	World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+	return World;
+}
+
+void CommandletWorldLoader::BeginPlay(UWorld* World)
+{
+	if (!World || World->HasBegunPlay())
+	{
+		return;
+	}
+
+	//Without a game mode nothing dispatches BeginPlay, so the world settings are asked to do it like the game state would
+	World->InitializeActorsForPlay(FURL());
+	World->GetWorldSettings()->NotifyBeginPlay();
+}
+
+void CommandletWorldLoader::ReleaseWorld(UWorld* World)
+{
+	if (!World)
+	{
+		return;
+	}
+
+	//Components unregister from the world's subsystems in EndPlay, which has to happen before the world is cleaned up
+	if (World->HasBegunPlay())
+	{
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			It->RouteEndPlay(EEndPlayReason::Quit);
+		}
+	}
+
+	World->CleanupWorld();
+	World->RemoveFromRoot();
+	CollectGarbage(RF_NoFlags);
+}
@@ -0,0 +1,20 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+//Helpers shared by the commandlets that need a loaded, collision-enabled world without starting the game
+namespace CommandletWorldLoader
+{
+	//Loads a map(long package name like /Game/Levels/BuildingEscape1 or just its short name), initialises its world with a physics scene and makes all of its levels visible so scene queries can be performed. Returns nullptr on failure
+	UWorld* LoadWorld(const FString& MapName);
+
+	//Initializes the actors of a world returned by LoadWorld and begins play on them, without a game mode or players; for commandlets that need the components in their runtime state
+	void BeginPlay(UWorld* World);
+
+	//Tears down a world returned by LoadWorld, ending play first if it was begun
+	void ReleaseWorld(UWorld* World);
+}
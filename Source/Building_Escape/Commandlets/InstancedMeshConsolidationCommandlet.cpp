@@ -0,0 +1,394 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "InstancedMeshConsolidationCommandlet.h"
+#include "CommandletWorldLoader.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Level.h"
+#include "Engine/LevelBounds.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/PlatformTime.h"
+#include "Materials/MaterialInterface.h"
+#include "Math/RandomStream.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+
+namespace
+{
+	//Counts gathered over every registered primitive of the world
+	struct FSceneCounts
+	{
+		int32 Actors = 0;
+		int32 Primitives = 0;			//Visible registered primitive components; each one is a render proxy
+		int32 CollisionComponents = 0;	//Primitive components with collision enabled
+		int32 Bodies = 0;				//Physics bodies; instanced components own one per instance
+	};
+
+	//One benchmark query and what it hit; the hits are compared after the consolidation to prove the collision didn't change
+	struct FBenchmarkTrace
+	{
+		FVector Start;
+		FVector End;
+		bool bIsSweep;
+		bool bHit = false;
+		float Distance = 0.f;
+	};
+
+	struct FBenchmarkResult
+	{
+		double LineTraceSeconds = 0.0;
+		double SweepSeconds = 0.0;
+		int32 Hits = 0;
+	};
+
+	//Static mesh actors that can share one instanced component
+	struct FInstanceGroup
+	{
+		ULevel* Level = nullptr;
+		UStaticMeshComponent* Template = nullptr;
+		TArray<AStaticMeshActor*> Actors;
+	};
+
+	FSceneCounts CountScene(UWorld* World)
+	{
+		FSceneCounts Counts;
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			Counts.Actors++;
+
+			TInlineComponentArray<UPrimitiveComponent*> Primitives(*It);
+			for (UPrimitiveComponent* Primitive : Primitives)
+			{
+				if (!Primitive->IsRegistered()) { continue; }
+
+				if (Primitive->IsVisible())
+				{
+					Counts.Primitives++;
+				}
+
+				if (!Primitive->IsCollisionEnabled()) { continue; }
+				Counts.CollisionComponents++;
+
+				if (UInstancedStaticMeshComponent* InstancedMesh = Cast<UInstancedStaticMeshComponent>(Primitive))
+				{
+					for (FBodyInstance* InstanceBody : InstancedMesh->InstanceBodies)
+					{
+						Counts.Bodies += (InstanceBody && InstanceBody->IsValidBodyInstance()) ? 1 : 0;
+					}
+				}
+				else if (Primitive->GetBodyInstance() && Primitive->GetBodyInstance()->IsValidBodyInstance())
+				{
+					Counts.Bodies++;
+				}
+			}
+		}
+		return Counts;
+	}
+
+	//Random line traces on Visibility(interaction and hang traces) and capsule sweeps on Pawn(movement), both crossing the whole level
+	TArray<FBenchmarkTrace> MakeBenchmarkTraces(const FBox& Bounds, int32 NumTraces)
+	{
+		FRandomStream RandomStream(2020);
+		TArray<FBenchmarkTrace> Traces;
+		Traces.Reserve(NumTraces);
+		for (int32 Index = 0; Index < NumTraces; Index++)
+		{
+			FBenchmarkTrace Trace;
+			Trace.Start = RandomStream.RandPointInBox(Bounds);
+			Trace.End = RandomStream.RandPointInBox(Bounds);
+			Trace.bIsSweep = (Index % 2) == 1;
+			Traces.Add(Trace);
+		}
+		return Traces;
+	}
+
+	FBenchmarkResult RunBenchmark(UWorld* World, TArray<FBenchmarkTrace>& Traces)
+	{
+		FBenchmarkResult Result;
+		FCollisionQueryParams QueryParams(FName(TEXT("ConsolidationBenchmark")), false);
+		const FCollisionShape Capsule = FCollisionShape::MakeCapsule(34.f, 88.f);
+
+		for (FBenchmarkTrace& Trace : Traces)
+		{
+			FHitResult Hit;
+			double StartTime = FPlatformTime::Seconds();
+			if (Trace.bIsSweep)
+			{
+				Trace.bHit = World->SweepSingleByChannel(OUT Hit, Trace.Start, Trace.End, FQuat::Identity, ECC_Pawn, Capsule, QueryParams);
+				Result.SweepSeconds += FPlatformTime::Seconds() - StartTime;
+			}
+			else
+			{
+				Trace.bHit = World->LineTraceSingleByChannel(OUT Hit, Trace.Start, Trace.End, ECC_Visibility, QueryParams);
+				Result.LineTraceSeconds += FPlatformTime::Seconds() - StartTime;
+			}
+			Trace.Distance = Trace.bHit ? Hit.Distance : 0.f;
+			Result.Hits += Trace.bHit ? 1 : 0;
+		}
+		return Result;
+	}
+
+	//Only plain static mesh actors are safe to merge: nothing attached, no extra components, nothing that could be referenced or moved at runtime
+	bool CanBeConsolidated(AStaticMeshActor* Actor)
+	{
+		UStaticMeshComponent* MeshComponent = Actor->GetStaticMeshComponent();
+		if (!MeshComponent || !MeshComponent->GetStaticMesh() || MeshComponent->Mobility != EComponentMobility::Static) { return false; }
+		if (MeshComponent->IsSimulatingPhysics() || MeshComponent->GetGenerateOverlapEvents()) { return false; }
+		if (Actor->Tags.Num() > 0 || Actor->GetAttachParentActor()) { return false; }
+
+		TArray<AActor*> AttachedActors;
+		Actor->GetAttachedActors(AttachedActors);
+		if (AttachedActors.Num() > 0) { return false; }
+
+		TInlineComponentArray<UActorComponent*> Components(Actor);
+		return Components.Num() == 1;
+	}
+
+	//Actors end up in the same group only if an instanced component can reproduce all of them exactly, including every collision response
+	FString MakeGroupKey(AStaticMeshActor* Actor)
+	{
+		UStaticMeshComponent* MeshComponent = Actor->GetStaticMeshComponent();
+		FString Key = Actor->GetLevel()->GetPathName() + TEXT("|") + MeshComponent->GetStaticMesh()->GetPathName();
+
+		for (int32 MaterialIndex = 0; MaterialIndex < MeshComponent->GetNumMaterials(); MaterialIndex++)
+		{
+			UMaterialInterface* Material = MeshComponent->GetMaterial(MaterialIndex);
+			Key += TEXT("|") + (Material ? Material->GetPathName() : FString(TEXT("None")));
+		}
+
+		Key += FString::Printf(TEXT("|%s|%d|%d|%d|%d"),
+			*MeshComponent->GetCollisionProfileName().ToString(),
+			(int32)MeshComponent->GetCollisionEnabled(),
+			(int32)MeshComponent->GetCollisionObjectType(),
+			MeshComponent->CastShadow ? 1 : 0,
+			MeshComponent->CanEverAffectNavigation() ? 1 : 0);
+
+		const FCollisionResponseContainer& Responses = MeshComponent->GetCollisionResponseToChannels();
+		for (int32 Channel = 0; Channel < ECC_MAX; Channel++)
+		{
+			Key.AppendChar(TEXT('0') + Responses.GetResponse((ECollisionChannel)Channel));
+		}
+		return Key;
+	}
+
+	//Spawns the actor holding the instanced component and moves every actor of the group into it as an instance
+	int32 ConsolidateGroup(UWorld* World, const FInstanceGroup& Group)
+	{
+		UStaticMeshComponent* Template = Group.Template;
+		UStaticMesh* Mesh = Template->GetStaticMesh();
+
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.OverrideLevel = Group.Level;
+		SpawnParameters.Name = MakeUniqueObjectName(Group.Level, AActor::StaticClass(), *FString::Printf(TEXT("ISM_%s"), *Mesh->GetName()));
+		AActor* InstancesActor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParameters);
+		if (!InstancesActor)
+		{
+			return 0;
+		}
+
+		UHierarchicalInstancedStaticMeshComponent* Instances = NewObject<UHierarchicalInstancedStaticMeshComponent>(InstancesActor, TEXT("Instances"));
+		Instances->SetMobility(EComponentMobility::Static);
+		Instances->SetStaticMesh(Mesh);
+		for (int32 MaterialIndex = 0; MaterialIndex < Template->GetNumOverrideMaterials(); MaterialIndex++)
+		{
+			Instances->SetMaterial(MaterialIndex, Template->GetMaterial(MaterialIndex));
+		}
+
+		//The collision setup is copied member by member, as the parkour traces rely on the exact responses(Visibility for hanging, Pawn for movement)
+		Instances->SetCollisionProfileName(Template->GetCollisionProfileName());
+		Instances->SetCollisionEnabled(Template->GetCollisionEnabled());
+		Instances->SetCollisionObjectType(Template->GetCollisionObjectType());
+		Instances->SetCollisionResponseToChannels(Template->GetCollisionResponseToChannels());
+		Instances->SetGenerateOverlapEvents(false);
+		Instances->SetCastShadow(Template->CastShadow);
+		Instances->SetCanEverAffectNavigation(Template->CanEverAffectNavigation());
+
+		//Instances are added before registering, so every instance body is created at once along with the physics state
+		for (AStaticMeshActor* Actor : Group.Actors)
+		{
+			Instances->AddInstanceWorldSpace(Actor->GetStaticMeshComponent()->GetComponentTransform());
+		}
+
+		InstancesActor->SetRootComponent(Instances);
+		InstancesActor->AddInstanceComponent(Instances);
+		Instances->RegisterComponent();
+		Instances->BuildTreeIfOutdated(false, true);
+		//The instances have no lightmaps of their own; marking the lighting as unbuilt makes the editor and the map check report it instead of shipping preview lighting unnoticed
+		Instances->InvalidateLightingCache();
+
+		for (AStaticMeshActor* Actor : Group.Actors)
+		{
+			World->DestroyActor(Actor);
+		}
+		return Group.Actors.Num();
+	}
+
+	FString FormatCounts(const TCHAR* Label, const FSceneCounts& Before, const FSceneCounts& After)
+	{
+		return FString::Printf(TEXT("%-22s actors %6d -> %6d, primitives %6d -> %6d, collision components %6d -> %6d, physics bodies %6d -> %6d\n"),
+			Label, Before.Actors, After.Actors, Before.Primitives, After.Primitives, Before.CollisionComponents, After.CollisionComponents, Before.Bodies, After.Bodies);
+	}
+}
+
+UInstancedMeshConsolidationCommandlet::UInstancedMeshConsolidationCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UInstancedMeshConsolidationCommandlet::Main(const FString& Params)
+{
+	FString MapName = TEXT("/Game/Levels/BuildingEscape1");
+	FParse::Value(*Params, TEXT("Map="), MapName);
+
+	int32 MinInstances = 4;
+	FParse::Value(*Params, TEXT("MinInstances="), MinInstances);
+	MinInstances = FMath::Max(MinInstances, 2);
+
+	int32 NumTraces = 20000;
+	FParse::Value(*Params, TEXT("Traces="), NumTraces);
+	NumTraces = FMath::Max(NumTraces, 1);
+
+	const bool bSave = FParse::Param(*Params, TEXT("Save"));
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Consolidation") / FPackageName::GetShortName(MapName) + TEXT(".txt");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	UWorld* World = CommandletWorldLoader::LoadWorld(MapName);
+	if (!World)
+	{
+		return 1;
+	}
+
+	FBox Bounds(ForceInit);
+	for (ULevel* Level : World->GetLevels())
+	{
+		if (Level && Level->bIsVisible)
+		{
+			Bounds += ALevelBounds::CalculateLevelBounds(Level);
+		}
+	}
+	if (!Bounds.IsValid)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Map %s has no geometry to consolidate!"), *MapName);
+		CommandletWorldLoader::ReleaseWorld(World);
+		return 1;
+	}
+
+	//Measuring the level as it was authored
+	TArray<FBenchmarkTrace> Traces = MakeBenchmarkTraces(Bounds, NumTraces);
+	RunBenchmark(World, Traces); // Warm up, so the first run doesn't pay for cold caches
+	const FSceneCounts CountsBefore = CountScene(World);
+	const FBenchmarkResult BenchmarkBefore = RunBenchmark(World, Traces);
+	const TArray<FBenchmarkTrace> TracesBefore = Traces;
+
+	//Grouping
+	TMap<FString, FInstanceGroup> Groups;
+	for (TActorIterator<AStaticMeshActor> It(World); It; ++It)
+	{
+		if (!CanBeConsolidated(*It)) { continue; }
+
+		FInstanceGroup& Group = Groups.FindOrAdd(MakeGroupKey(*It));
+		if (!Group.Template)
+		{
+			Group.Level = It->GetLevel();
+			Group.Template = It->GetStaticMeshComponent();
+		}
+		Group.Actors.Add(*It);
+	}
+
+	FString GroupReport;
+	int32 ConsolidatedGroups = 0;
+	int32 ConsolidatedActors = 0;
+	for (const TPair<FString, FInstanceGroup>& Group : Groups)
+	{
+		if (Group.Value.Actors.Num() < MinInstances) { continue; }
+
+		const FString MeshName = Group.Value.Template->GetStaticMesh()->GetName();
+		const int32 ActorCount = ConsolidateGroup(World, Group.Value);
+		if (ActorCount > 0)
+		{
+			ConsolidatedGroups++;
+			ConsolidatedActors += ActorCount;
+			GroupReport += FString::Printf(TEXT("    %-40s %5d instances\n"), *MeshName, ActorCount);
+		}
+	}
+
+	//Measuring the consolidated level with exactly the same traces
+	RunBenchmark(World, Traces);
+	const FSceneCounts CountsAfter = CountScene(World);
+	const FBenchmarkResult BenchmarkAfter = RunBenchmark(World, Traces);
+
+	int32 MismatchedTraces = 0;
+	for (int32 Index = 0; Index < Traces.Num(); Index++)
+	{
+		if (Traces[Index].bHit != TracesBefore[Index].bHit || !FMath::IsNearlyEqual(Traces[Index].Distance, TracesBefore[Index].Distance, 0.1f))
+		{
+			MismatchedTraces++;
+		}
+	}
+
+	FString Report;
+	Report += FString::Printf(TEXT("Instanced mesh consolidation report for %s\n"), *MapName);
+	Report += FString::Printf(TEXT("Consolidated %d actors into %d hierarchical instanced components(groups of at least %d)\n"), ConsolidatedActors, ConsolidatedGroups, MinInstances);
+	Report += GroupReport;
+	Report += FormatCounts(TEXT("Scene:"), CountsBefore, CountsAfter);
+	Report += FString::Printf(TEXT("%d line traces(Visibility): %.3f ms -> %.3f ms\n"), (NumTraces + 1) / 2, BenchmarkBefore.LineTraceSeconds * 1000.0, BenchmarkAfter.LineTraceSeconds * 1000.0);
+	Report += FString::Printf(TEXT("%d capsule sweeps(Pawn): %.3f ms -> %.3f ms\n"), NumTraces / 2, BenchmarkBefore.SweepSeconds * 1000.0, BenchmarkAfter.SweepSeconds * 1000.0);
+	Report += FString::Printf(TEXT("Hits %d -> %d, %d traces with a different result\n"), BenchmarkBefore.Hits, BenchmarkAfter.Hits, MismatchedTraces);
+	//Each instance still gets its own body in the physics scene, so the broadphase only gets smaller by whatever wasn't consolidated; the saving is mostly on the render and component side
+	Report += TEXT("Note: instanced static mesh components create one physics body per instance, the body count is expected to stay roughly the same.\n");
+	Report += TEXT("Note: the instanced components are created without built lighting; the lighting of the map has to be rebuilt after saving.\n");
+
+	UE_LOG(LogTemp, Display, TEXT("%s"), *Report);
+	if (!FFileHelper::SaveStringToFile(Report, *OutputPath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to write the report to %s"), *OutputPath);
+	}
+
+	int32 ReturnCode = 0;
+	if (MismatchedTraces > 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%d benchmark traces hit something else after the consolidation, the map won't be saved!"), MismatchedTraces);
+		ReturnCode = 1;
+	}
+	else if (bSave && ConsolidatedActors > 0)
+	{
+		//Every level that received an instanced component is saved back to its own package
+		TSet<ULevel*> ModifiedLevels;
+		for (const TPair<FString, FInstanceGroup>& Group : Groups)
+		{
+			if (Group.Value.Actors.Num() >= MinInstances)
+			{
+				ModifiedLevels.Add(Group.Value.Level);
+			}
+		}
+
+		//Rebuilding the lighting takes the full lighting build, which is left to the editor or the ResavePackages commandlet
+		UE_LOG(LogTemp, Warning, TEXT("The consolidated meshes have no built lighting. Rebuild the lighting of %s before shipping, e.g. with -run=ResavePackages -buildlighting -map=%s"), *MapName, *FPackageName::GetShortName(MapName));
+
+		for (ULevel* Level : ModifiedLevels)
+		{
+			UPackage* Package = Level->GetOutermost();
+			UWorld* LevelWorld = CastChecked<UWorld>(Level->GetOuter());
+			const FString Filename = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetMapPackageExtension());
+			if (!UPackage::SavePackage(Package, LevelWorld, RF_NoFlags, *Filename, GError, nullptr, false, true, SAVE_NoError))
+			{
+				UE_LOG(LogTemp, Error, TEXT("Failed to save %s"), *Filename);
+				ReturnCode = 1;
+			}
+		}
+	}
+
+	CommandletWorldLoader::ReleaseWorld(World);
+	return ReturnCode;
+}
@@ -0,0 +1,26 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "InstancedMeshConsolidationCommandlet.generated.h"
+
+/**
+ * Replaces static mesh actors that repeat the same mesh, materials and collision setup with a single hierarchical instanced static mesh component per group.
+ * Physics bodies, render primitives and the cost of a fixed set of traces are measured before and after, and every trace is checked to hit the same thing afterwards.
+ * The new components have no built lighting and are marked as such; a map saved with -Save needs its lighting rebuilt before it ships.
+ *
+ * Usage: UE4Editor-Cmd Building_Escape.uproject -run=InstancedMeshConsolidation -Map=/Game/Levels/BuildingEscape1
+ *        [-MinInstances=4] [-Traces=20000] [-Save] [-Output=<report path>]
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UInstancedMeshConsolidationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UInstancedMeshConsolidationCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,110 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "InteractableValidationCommandlet.h"
+#include "CommandletWorldLoader.h"
+#include "Components/Interactable.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectIterator.h"
+
+UInteractableValidationCommandlet::UInteractableValidationCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UInteractableValidationCommandlet::Main(const FString& Params)
+{
+	FString MapName = TEXT("/Game/Levels/BuildingEscape1");
+	FParse::Value(*Params, TEXT("Map="), MapName);
+
+	const bool bSave = FParse::Param(*Params, TEXT("Save"));
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("InteractableValidation") / FPackageName::GetShortName(MapName) + TEXT(".txt");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	UWorld* World = CommandletWorldLoader::LoadWorld(MapName);
+	if (!World)
+	{
+		return 1;
+	}
+
+	FString ProblemReport;
+	int32 Interactables = 0;
+	int32 BakedInteractables = 0;
+	int32 InteractablesWithProblems = 0;
+	int32 UnboundInteractables = 0;
+	TSet<ULevel*> ModifiedLevels;
+	for (TObjectIterator<UInteractable> It; It; ++It)
+	{
+		UInteractable* Interactable = *It;
+		if (Interactable->IsTemplate() || Interactable->GetWorld() != World || !Interactable->GetOwner()) { continue; }
+
+		Interactables++;
+		if (Interactable->BakeBinding())
+		{
+			BakedInteractables++;
+			ModifiedLevels.Add(Interactable->GetOwner()->GetLevel());
+		}
+
+		TArray<FString> Problems;
+		if (!Interactable->ValidateBinding(OUT Problems))
+		{
+			UnboundInteractables++;
+		}
+		if (Problems.Num() == 0) { continue; }
+
+		InteractablesWithProblems++;
+		ProblemReport += FString::Printf(TEXT("    %s.%s\n"), *Interactable->GetOwner()->GetName(), *Interactable->GetName());
+		for (const FString& Problem : Problems)
+		{
+			ProblemReport += FString::Printf(TEXT("        %s\n"), *Problem);
+		}
+	}
+
+	FString Report;
+	Report += FString::Printf(TEXT("Interactable validation report for %s\n"), *MapName);
+	Report += FString::Printf(TEXT("%d interactables, %d bindings baked or updated, %d with problems\n"), Interactables, BakedInteractables, InteractablesWithProblems);
+	Report += ProblemReport;
+
+	UE_LOG(LogTemp, Display, TEXT("%s"), *Report);
+	if (!FFileHelper::SaveStringToFile(Report, *OutputPath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to write the report to %s"), *OutputPath);
+	}
+
+	int32 ReturnCode = 0;
+	if (UnboundInteractables > 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%d interactables have no primitive to bind to!"), UnboundInteractables);
+		ReturnCode = 1;
+	}
+
+	//Saving runs PreSave, which bakes the same binding again, so the saved levels match what the cook produces
+	if (bSave)
+	{
+		for (ULevel* Level : ModifiedLevels)
+		{
+			UPackage* Package = Level->GetOutermost();
+			UWorld* LevelWorld = CastChecked<UWorld>(Level->GetOuter());
+			const FString Filename = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetMapPackageExtension());
+			if (!UPackage::SavePackage(Package, LevelWorld, RF_NoFlags, *Filename, GError, nullptr, false, true, SAVE_NoError))
+			{
+				UE_LOG(LogTemp, Error, TEXT("Failed to save %s"), *Filename);
+				ReturnCode = 1;
+			}
+		}
+	}
+
+	CommandletWorldLoader::ReleaseWorld(World);
+	return ReturnCode;
+}
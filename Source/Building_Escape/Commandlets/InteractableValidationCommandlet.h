@@ -0,0 +1,25 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "InteractableValidationCommandlet.generated.h"
+
+/**
+ * Bakes the primitive binding of every interactable of a map, the same way saving the level does, and writes a report of the interactables
+ * whose binding or collision setup is wrong. Fails if any interactable has no primitive at all, so it can guard the cook.
+ *
+ * Usage: UE4Editor-Cmd Building_Escape.uproject -run=InteractableValidation -Map=/Game/Levels/BuildingEscape1
+ *        [-Save] [-Output=<report path>]
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UInteractableValidationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UInteractableValidationCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
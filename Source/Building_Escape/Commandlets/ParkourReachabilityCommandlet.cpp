@@ -0,0 +1,933 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "ParkourReachabilityCommandlet.h"
+#include "CommandletWorldLoader.h"
+#include "DefaultEscapePawn.h"
+#include "Components/ParkourMovementComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "Engine/LevelBounds.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	//Moves the graph distinguishes between. The order is a part of the binary format, so new moves should only ever be appended
+	enum EReachMove : uint8
+	{
+		ReachMove_Walk,
+		ReachMove_Fall,
+		ReachMove_Jump,
+		ReachMove_CrawlJump,
+		ReachMove_TuckJump,
+		ReachMove_Wallrun,
+		ReachMove_Lunge,
+		ReachMove_ClimbUp,
+		ReachMove_Count
+	};
+
+	const TCHAR* const ReachMoveNames[ReachMove_Count] = { TEXT("Walk"), TEXT("Fall"), TEXT("Jump"), TEXT("CrawlJump"), TEXT("TuckJump"), TEXT("Wallrun"), TEXT("Lunge"), TEXT("ClimbUp") };
+
+	enum EReachNodeFlags : uint8
+	{
+		ReachNode_Ledge = 1 << 0,		//At least one neighbouring column has no floor at a walkable height, so the player can fall or jump off here
+		ReachNode_Spawn = 1 << 1,		//The node closest to a player start
+		ReachNode_Reachable = 1 << 2,	//The node can be reached from any of the spawn nodes
+	};
+
+	//A spot the player can stand on; the location is the floor point under the capsule
+	struct FReachNode
+	{
+		FVector Location;
+		uint8 Flags = 0;
+	};
+
+	struct FReachEdge
+	{
+		uint32 To;
+		uint8 Move;
+		uint16 AirTimeMs;
+	};
+
+	enum EArcOutcome
+	{
+		ArcOutcome_Landed,
+		ArcOutcome_Hung,
+		ArcOutcome_Failed
+	};
+
+	//Result of simulating a single airborne move. Location stores the floor point when landed and the capsule centre when hanging
+	struct FArcResult
+	{
+		EArcOutcome Outcome = ArcOutcome_Failed;
+		FVector Location = FVector::ZeroVector;
+		float Yaw = 0.f;
+		float Time = 0.f;
+		bool bDidWallrun = false;
+	};
+
+	//Decides which parkour rules apply while an arc is simulated; mirrors the state and the timers of the movement component
+	struct FArcRules
+	{
+		bool bAllowHang = true;
+		bool bAllowWallrun = false;
+		//Hanging is impossible until this much time has passed(the no hang timer)
+		float NoHangTime = 0.f;
+		//Capsule centre height when the player left the ground; limits the height gained while wallrunning
+		float JumpOffZ = 0.f;
+		//Time already spent in the air when the arc starts; the wallrun timer is started by the jump, not by the wallrun
+		float TimeSinceJump = 0.f;
+	};
+
+	//Data owned by a single task. Every node is processed by exactly one task, so nothing in here has to be thread safe
+	struct FTaskContext
+	{
+		uint32 FromNode;
+		TArray<FReachEdge>& Edges;
+		int64 QueryCount = 0;
+
+		FTaskContext(uint32 InFromNode, TArray<FReachEdge>& InEdges) : FromNode(InFromNode), Edges(InEdges) {}
+	};
+
+	//Simulation settings that aren't a part of the movement rules
+	const float SimulationTimeStep = 1.f / 15.f;
+	const float MaxAirTime = 3.f;
+	const int32 MaxFloorsPerColumn = 16;
+	const int32 MaxWallContacts = 3;
+	const float WallrunLungeSampleInterval = 0.25f;
+	//Limit used by IsFullfillingWallrunConditions for the velocity going away from the wall
+	const float WallrunMaxSideSpeed = 900.f;
+
+	class FParkourReachabilityAnalyzer
+	{
+	public:
+		FParkourReachabilityAnalyzer(UWorld* InWorld, const FParkourSimulationParameters& InParameters, float InSpacing, int32 InNumDirections);
+
+		bool HasValidBounds() const { return WorldBounds.IsValid != 0; }
+
+		//Traces every column of the sampling grid from top to bottom and stores each floor with enough space for the capsule as a node
+		void SampleNodes();
+		//Simulates all the moves from every node in parallel and stores the resulting edges
+		void BuildEdges();
+		//Flood fills the graph from the nodes closest to the player starts
+		void MarkReachableNodes();
+
+		bool WriteGraph(const FString& Filename) const;
+		FString BuildReport(const FString& MapName, double SamplingSeconds, double SimulationSeconds) const;
+
+	private:
+		UWorld* World;
+		FParkourSimulationParameters Parameters;
+		float Spacing;
+		int32 NumDirections;
+
+		FCollisionQueryParams QueryParams;
+		FCollisionShape CapsuleShape;
+		FBox WorldBounds;
+
+		int32 GridSizeX = 0;
+		int32 GridSizeY = 0;
+
+		TArray<FReachNode> Nodes;
+		//Nodes are sorted by column; ColumnFirstNode[Column] is the index of the first node of the column, ColumnFirstNode[Column + 1] is one past the last
+		TArray<int32> ColumnFirstNode;
+		TArray<TArray<FReachEdge>> EdgesPerNode;
+		int64 TotalQueryCount = 0;
+		int32 SpawnNodeCount = 0;
+
+		FVector GetColumnLocation(int32 Column) const;
+		int32 GetColumnIndex(int32 X, int32 Y) const;
+		//Returns the node a capsule standing at the given floor location belongs to, or INDEX_NONE
+		int32 FindNode(const FVector& FloorLocation) const;
+
+		void FlagLedges();
+		void AddWalkEdges(const FReachNode& Node, FTaskContext& Context) const;
+		void SimulateNode(FTaskContext& Context) const;
+
+		FArcResult SimulateArc(FVector Centre, FVector Velocity, float Yaw, const FArcRules& Rules, FTaskContext& Context) const;
+		//Runs along a wall found at either side of the capsule. Returns false if the wallrun conditions aren't fulfilled
+		bool TryWallrun(FVector& Centre, FVector& Velocity, float Yaw, const FArcRules& Rules, float& Time, FTaskContext& Context) const;
+		bool ProbeDirection(const FVector& Centre, const FRotator& Direction, FHitResult& OutHit, FTaskContext& Context) const;
+		bool TestClimbUp(const FVector& HangLocation, float HangYaw, FVector& OutFloorLocation, FTaskContext& Context) const;
+
+		void EmitResult(EReachMove Move, const FArcResult& Result, int32 HangDepth, FTaskContext& Context) const;
+		void EmitHangEdges(const FArcResult& HangResult, int32 HangDepth, FTaskContext& Context) const;
+		void EmitWallrunLunges(const FVector& Centre, const FVector& Velocity, float Yaw, bool bIsWallOnLeft, float Time, FTaskContext& Context) const;
+		void AddEdge(EReachMove Move, int32 To, float Time, FTaskContext& Context) const;
+	};
+
+	FParkourReachabilityAnalyzer::FParkourReachabilityAnalyzer(UWorld* InWorld, const FParkourSimulationParameters& InParameters, float InSpacing, int32 InNumDirections)
+		: World(InWorld)
+		, Parameters(InParameters)
+		, Spacing(InSpacing)
+		, NumDirections(InNumDirections)
+		, QueryParams(FName(TEXT("ParkourReachability")), false)
+		, WorldBounds(ForceInit)
+	{
+		QueryParams.bFindInitialOverlaps = false;
+		CapsuleShape = FCollisionShape::MakeCapsule(Parameters.CapsuleRadius, Parameters.CapsuleHalfHeight);
+
+		for (ULevel* Level : World->GetLevels())
+		{
+			if (Level && Level->bIsVisible)
+			{
+				WorldBounds += ALevelBounds::CalculateLevelBounds(Level);
+			}
+		}
+
+		if (WorldBounds.IsValid)
+		{
+			GridSizeX = FMath::CeilToInt(WorldBounds.GetSize().X / Spacing) + 1;
+			GridSizeY = FMath::CeilToInt(WorldBounds.GetSize().Y / Spacing) + 1;
+		}
+	}
+
+	FVector FParkourReachabilityAnalyzer::GetColumnLocation(int32 Column) const
+	{
+		return FVector(WorldBounds.Min.X + (Column % GridSizeX) * Spacing, WorldBounds.Min.Y + (Column / GridSizeX) * Spacing, 0);
+	}
+
+	int32 FParkourReachabilityAnalyzer::GetColumnIndex(int32 X, int32 Y) const
+	{
+		if (X < 0 || Y < 0 || X >= GridSizeX || Y >= GridSizeY)
+		{
+			return INDEX_NONE;
+		}
+		return X + Y * GridSizeX;
+	}
+
+	void FParkourReachabilityAnalyzer::SampleNodes()
+	{
+		const int32 NumColumns = GridSizeX * GridSizeY;
+		TArray<TArray<FVector>> ColumnFloors;
+		ColumnFloors.SetNum(NumColumns);
+		TArray<int64> ColumnQueries;
+		ColumnQueries.SetNumZeroed(NumColumns);
+
+		ParallelFor(NumColumns, [&](int32 Column)
+		{
+			const FVector ColumnLocation = GetColumnLocation(Column);
+			FVector TraceStart(ColumnLocation.X, ColumnLocation.Y, WorldBounds.Max.Z + 1.f);
+			const FVector TraceEnd(ColumnLocation.X, ColumnLocation.Y, WorldBounds.Min.Z - 1.f);
+
+			//A floor needs a full capsule of free space above it, so the next floor below a hit can't be closer than the capsule height. That also steps out of the geometry that was just hit
+			const float FloorSeparation = 2 * Parameters.CapsuleHalfHeight;
+
+			for (int32 Floor = 0; Floor < MaxFloorsPerColumn && TraceStart.Z > TraceEnd.Z; Floor++)
+			{
+				FHitResult Hit;
+				ColumnQueries[Column]++;
+				if (!World->LineTraceSingleByChannel(OUT Hit, TraceStart, TraceEnd, ECC_Pawn, QueryParams))
+				{
+					break;
+				}
+
+				if (!Hit.bStartPenetrating && Hit.ImpactNormal.Z >= Parameters.WalkableFloorZ)
+				{
+					ColumnQueries[Column]++;
+					FVector CapsuleCentre = Hit.ImpactPoint + FVector(0, 0, Parameters.CapsuleHalfHeight + 1.f);
+					if (!World->OverlapBlockingTestByChannel(CapsuleCentre, FQuat::Identity, ECC_Pawn, CapsuleShape, QueryParams))
+					{
+						ColumnFloors[Column].Add(Hit.ImpactPoint);
+					}
+				}
+
+				TraceStart.Z = Hit.ImpactPoint.Z - FloorSeparation;
+			}
+		});
+
+		//Flattening the columns into a single array; every column keeps a contiguous range of it
+		ColumnFirstNode.SetNumUninitialized(NumColumns + 1);
+		for (int32 Column = 0; Column < NumColumns; Column++)
+		{
+			ColumnFirstNode[Column] = Nodes.Num();
+			for (const FVector& FloorLocation : ColumnFloors[Column])
+			{
+				FReachNode Node;
+				Node.Location = FloorLocation;
+				Nodes.Add(Node);
+			}
+			TotalQueryCount += ColumnQueries[Column];
+		}
+		ColumnFirstNode[NumColumns] = Nodes.Num();
+
+		FlagLedges();
+	}
+
+	int32 FParkourReachabilityAnalyzer::FindNode(const FVector& FloorLocation) const
+	{
+		const int32 CentreX = FMath::RoundToInt((FloorLocation.X - WorldBounds.Min.X) / Spacing);
+		const int32 CentreY = FMath::RoundToInt((FloorLocation.Y - WorldBounds.Min.Y) / Spacing);
+
+		int32 BestNode = INDEX_NONE;
+		float BestDistanceSquared = FMath::Square(Spacing);
+
+		//The closest column is checked along with its neighbours, as the landing spot can be just past the edge of a sampled floor
+		for (int32 OffsetY = -1; OffsetY <= 1; OffsetY++)
+		{
+			for (int32 OffsetX = -1; OffsetX <= 1; OffsetX++)
+			{
+				int32 Column = GetColumnIndex(CentreX + OffsetX, CentreY + OffsetY);
+				if (Column == INDEX_NONE) { continue; }
+
+				for (int32 NodeIndex = ColumnFirstNode[Column]; NodeIndex < ColumnFirstNode[Column + 1]; NodeIndex++)
+				{
+					const FVector& NodeLocation = Nodes[NodeIndex].Location;
+					if (FMath::Abs(NodeLocation.Z - FloorLocation.Z) > Parameters.MaxStepHeight) { continue; }
+
+					float DistanceSquared = FVector::DistSquared(NodeLocation, FloorLocation);
+					if (DistanceSquared < BestDistanceSquared)
+					{
+						BestDistanceSquared = DistanceSquared;
+						BestNode = NodeIndex;
+					}
+				}
+			}
+		}
+		return BestNode;
+	}
+
+	void FParkourReachabilityAnalyzer::FlagLedges()
+	{
+		for (int32 Column = 0; Column < GridSizeX * GridSizeY; Column++)
+		{
+			const int32 ColumnX = Column % GridSizeX;
+			const int32 ColumnY = Column / GridSizeX;
+
+			for (int32 NodeIndex = ColumnFirstNode[Column]; NodeIndex < ColumnFirstNode[Column + 1]; NodeIndex++)
+			{
+				FReachNode& Node = Nodes[NodeIndex];
+
+				//A node is a ledge if any of the eight neighbouring columns lacks a floor the player could simply walk onto
+				for (int32 OffsetY = -1; OffsetY <= 1 && !(Node.Flags & ReachNode_Ledge); OffsetY++)
+				{
+					for (int32 OffsetX = -1; OffsetX <= 1; OffsetX++)
+					{
+						if (OffsetX == 0 && OffsetY == 0) { continue; }
+
+						bool bHasWalkableNeighbour = false;
+						int32 NeighbourColumn = GetColumnIndex(ColumnX + OffsetX, ColumnY + OffsetY);
+						if (NeighbourColumn != INDEX_NONE)
+						{
+							for (int32 NeighbourIndex = ColumnFirstNode[NeighbourColumn]; NeighbourIndex < ColumnFirstNode[NeighbourColumn + 1]; NeighbourIndex++)
+							{
+								if (FMath::Abs(Nodes[NeighbourIndex].Location.Z - Node.Location.Z) <= Parameters.MaxStepHeight)
+								{
+									bHasWalkableNeighbour = true;
+									break;
+								}
+							}
+						}
+
+						if (!bHasWalkableNeighbour)
+						{
+							Node.Flags |= ReachNode_Ledge;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void FParkourReachabilityAnalyzer::BuildEdges()
+	{
+		EdgesPerNode.SetNum(Nodes.Num());
+		TArray<int64> NodeQueries;
+		NodeQueries.SetNumZeroed(Nodes.Num());
+
+		ParallelFor(Nodes.Num(), [&](int32 NodeIndex)
+		{
+			FTaskContext Context(NodeIndex, EdgesPerNode[NodeIndex]);
+			SimulateNode(Context);
+			NodeQueries[NodeIndex] = Context.QueryCount;
+
+			//Several samples usually lead to the same node with the same move; only the fastest one is kept
+			TArray<FReachEdge>& Edges = EdgesPerNode[NodeIndex];
+			Edges.Sort([](const FReachEdge& A, const FReachEdge& B)
+			{
+				if (A.To != B.To) { return A.To < B.To; }
+				if (A.Move != B.Move) { return A.Move < B.Move; }
+				return A.AirTimeMs < B.AirTimeMs;
+			});
+
+			int32 UniqueCount = 0;
+			for (int32 EdgeIndex = 0; EdgeIndex < Edges.Num(); EdgeIndex++)
+			{
+				if (UniqueCount > 0 && Edges[UniqueCount - 1].To == Edges[EdgeIndex].To && Edges[UniqueCount - 1].Move == Edges[EdgeIndex].Move) { continue; }
+				Edges[UniqueCount++] = Edges[EdgeIndex];
+			}
+			Edges.SetNum(UniqueCount);
+			Edges.Shrink();
+		});
+
+		for (int64 QueryCount : NodeQueries)
+		{
+			TotalQueryCount += QueryCount;
+		}
+	}
+
+	void FParkourReachabilityAnalyzer::AddWalkEdges(const FReachNode& Node, FTaskContext& Context) const
+	{
+		const int32 CentreX = FMath::RoundToInt((Node.Location.X - WorldBounds.Min.X) / Spacing);
+		const int32 CentreY = FMath::RoundToInt((Node.Location.Y - WorldBounds.Min.Y) / Spacing);
+
+		for (int32 OffsetY = -1; OffsetY <= 1; OffsetY++)
+		{
+			for (int32 OffsetX = -1; OffsetX <= 1; OffsetX++)
+			{
+				int32 Column = GetColumnIndex(CentreX + OffsetX, CentreY + OffsetY);
+				if (Column == INDEX_NONE || (OffsetX == 0 && OffsetY == 0)) { continue; }
+
+				for (int32 NeighbourIndex = ColumnFirstNode[Column]; NeighbourIndex < ColumnFirstNode[Column + 1]; NeighbourIndex++)
+				{
+					const FVector& NeighbourLocation = Nodes[NeighbourIndex].Location;
+					if (FMath::Abs(NeighbourLocation.Z - Node.Location.Z) > Parameters.MaxStepHeight) { continue; }
+
+					//Checking for anything in the way at knee and at head height
+					FHitResult Hit;
+					const FVector KneeOffset(0, 0, Parameters.MaxStepHeight + 1.f);
+					const FVector HeadOffset(0, 0, 2 * Parameters.CapsuleHalfHeight - 5.f);
+					Context.QueryCount += 2;
+					if (World->LineTraceSingleByChannel(OUT Hit, Node.Location + KneeOffset, NeighbourLocation + KneeOffset, ECC_Pawn, QueryParams)) { continue; }
+					if (World->LineTraceSingleByChannel(OUT Hit, Node.Location + HeadOffset, NeighbourLocation + HeadOffset, ECC_Pawn, QueryParams)) { continue; }
+
+					float WalkTime = FVector::Dist(Node.Location, NeighbourLocation) / FMath::Max(Parameters.MaxWalkSpeed, 1.f);
+					AddEdge(ReachMove_Walk, NeighbourIndex, WalkTime, Context);
+				}
+			}
+		}
+	}
+
+	void FParkourReachabilityAnalyzer::SimulateNode(FTaskContext& Context) const
+	{
+		const FReachNode& Node = Nodes[Context.FromNode];
+		const FVector Centre = Node.Location + FVector(0, 0, Parameters.CapsuleHalfHeight + 1.f);
+
+		AddWalkEdges(Node, Context);
+
+		//Rules for a standing jump; the wallrun timer starts with it and hanging is tested every tick
+		FArcRules JumpRules;
+		JumpRules.JumpOffZ = Centre.Z;
+
+		//While crouching the parkour state stays at Crawl or TuckJump, neither of which tries to hang or wallrun
+		FArcRules CrouchedRules = JumpRules;
+		CrouchedRules.bAllowHang = false;
+
+		//Crawling is slow, but sliding(only possible above MinSlideSpeed) adds the slide force before the jump
+		const float CrawlJumpSpeed = Parameters.MaxWalkSpeed >= Parameters.MinSlideSpeed ? Parameters.MaxWalkSpeed + Parameters.SlideForce : Parameters.MaxWalkSpeedCrouched;
+
+		for (int32 DirectionIndex = 0; DirectionIndex < NumDirections; DirectionIndex++)
+		{
+			const float Yaw = 360.f * DirectionIndex / NumDirections;
+			const FVector Forward = FRotator(0, Yaw, 0).Vector();
+
+			//Walking off the edge only makes sense where there is an edge
+			if (Node.Flags & ReachNode_Ledge)
+			{
+				EmitResult(ReachMove_Fall, SimulateArc(Centre, Forward * Parameters.MaxWalkSpeed, Yaw, JumpRules, Context), 0, Context);
+			}
+
+			//A jump with the movement input held starts a wallrun as soon as a wall is found; if that happens the jump is simulated a second time without it
+			FArcRules WallrunRules = JumpRules;
+			WallrunRules.bAllowWallrun = true;
+			const FVector JumpVelocity = Forward * Parameters.MaxWalkSpeed + FVector(0, 0, Parameters.JumpZVelocity);
+			FArcResult JumpResult = SimulateArc(Centre, JumpVelocity, Yaw, WallrunRules, Context);
+			if (JumpResult.bDidWallrun)
+			{
+				EmitResult(ReachMove_Wallrun, JumpResult, 0, Context);
+				JumpResult = SimulateArc(Centre, JumpVelocity, Yaw, JumpRules, Context);
+			}
+			EmitResult(ReachMove_Jump, JumpResult, 0, Context);
+
+			//Jumping while crawling doubles the jump velocity
+			const FVector CrawlJumpVelocity = Forward * CrawlJumpSpeed + FVector(0, 0, Parameters.JumpZVelocity * 2);
+			EmitResult(ReachMove_CrawlJump, SimulateArc(Centre, CrawlJumpVelocity, Yaw, CrouchedRules, Context), 0, Context);
+
+			//Crouching mid jump boosts the forward velocity once, as long as the player moves fast enough
+			if (Parameters.MaxWalkSpeed >= Parameters.MinTuckJumpSpeed)
+			{
+				const FVector TuckJumpVelocity = Forward * (Parameters.MaxWalkSpeed + Parameters.TuckJumpForwardForce) + FVector(0, 0, Parameters.JumpZVelocity);
+				EmitResult(ReachMove_TuckJump, SimulateArc(Centre, TuckJumpVelocity, Yaw, CrouchedRules, Context), 0, Context);
+			}
+		}
+	}
+
+	FArcResult FParkourReachabilityAnalyzer::SimulateArc(FVector Centre, FVector Velocity, float Yaw, const FArcRules& Rules, FTaskContext& Context) const
+	{
+		FArcResult Result;
+		const FVector Gravity(0, 0, Parameters.GravityZ);
+		bool bCanWallrun = Rules.bAllowWallrun;
+		int32 WallContacts = 0;
+		float Time = 0.f;
+
+		while (Time < MaxAirTime && Centre.Z > WorldBounds.Min.Z)
+		{
+			//The wallrun timer is started by the jump, so a wall has to be found before it runs out
+			if (bCanWallrun && Rules.TimeSinceJump + Time < Parameters.MaxWallrunTime && TryWallrun(Centre, Velocity, Yaw, Rules, Time, Context))
+			{
+				Result.bDidWallrun = true;
+				bCanWallrun = false;
+				continue;
+			}
+
+			//The component tries to hang every tick of the Jump state once the no hang timer is over
+			if (Rules.bAllowHang && Time >= Rules.NoHangTime)
+			{
+				FVector HangLocation;
+				FRotator HangRotation;
+				Context.QueryCount++;
+				if (UParkourMovementComponent::TestHangPoint(World, Parameters, QueryParams, OUT HangLocation, OUT HangRotation, Centre, FRotator(0, Yaw, 0)))
+				{
+					Result.Outcome = ArcOutcome_Hung;
+					Result.Location = HangLocation;
+					Result.Yaw = HangRotation.Yaw;
+					Result.Time = Time;
+					return Result;
+				}
+			}
+
+			const FVector Delta = Velocity * SimulationTimeStep + 0.5f * Gravity * FMath::Square(SimulationTimeStep);
+			FHitResult Hit;
+			Context.QueryCount++;
+			if (!World->SweepSingleByChannel(OUT Hit, Centre, Centre + Delta, FQuat::Identity, ECC_Pawn, CapsuleShape, QueryParams))
+			{
+				Centre += Delta;
+				Velocity += Gravity * SimulationTimeStep;
+				Time += SimulationTimeStep;
+				continue;
+			}
+
+			if (Hit.bStartPenetrating)
+			{
+				break;
+			}
+
+			Centre = Hit.Location;
+			Velocity += Gravity * SimulationTimeStep * Hit.Time;
+			Time += SimulationTimeStep * Hit.Time;
+
+			if (Hit.ImpactNormal.Z >= Parameters.WalkableFloorZ)
+			{
+				Result.Outcome = ArcOutcome_Landed;
+				Result.Location = Centre - FVector(0, 0, Parameters.CapsuleHalfHeight);
+				Result.Time = Time;
+				return Result;
+			}
+
+			//Walls and ceilings only take away the velocity going into them, just like the character movement does
+			if (++WallContacts > MaxWallContacts)
+			{
+				break;
+			}
+			Velocity = FVector::VectorPlaneProject(Velocity, Hit.ImpactNormal);
+			Centre += Hit.ImpactNormal * 0.1f;
+		}
+
+		Result.Time = Time;
+		return Result;
+	}
+
+	bool FParkourReachabilityAnalyzer::ProbeDirection(const FVector& Centre, const FRotator& Direction, FHitResult& OutHit, FTaskContext& Context) const
+	{
+		//TraceForBlockInDirection ends up using CapsuleHalfHeight + CapsuleRadius as the length for every direction, so the same length is used here
+		const float ProbeLength = Parameters.CapsuleHalfHeight + Parameters.CapsuleRadius;
+		Context.QueryCount++;
+		return World->LineTraceSingleByObjectType(OUT OutHit, Centre, Centre + Direction.RotateVector(FVector(ProbeLength, 0, 0)), FCollisionObjectQueryParams(ECC_WorldStatic), QueryParams);
+	}
+
+	bool FParkourReachabilityAnalyzer::TryWallrun(FVector& Centre, FVector& Velocity, float Yaw, const FArcRules& Rules, float& Time, FTaskContext& Context) const
+	{
+		const FRotator Facing(0, Yaw, 0);
+		const FRotator LeftDirection = Facing + FRotator(0, -90, 0);
+		const FRotator RightDirection = Facing + FRotator(0, 90, 0);
+		const FRotator AheadDirection = Facing;
+		const FRotator DownDirection = Facing + FRotator(-90, 0, 0);
+
+		FHitResult WallHit;
+		bool bIsWallOnLeft = ProbeDirection(Centre, LeftDirection, WallHit, Context);
+		if (!bIsWallOnLeft && !ProbeDirection(Centre, RightDirection, WallHit, Context))
+		{
+			return false;
+		}
+
+		//Same conditions as IsFullfillingWallrunConditions: not moving away from the wall too quickly and moving forward along it
+		FRotator WallRotation = WallHit.ImpactNormal.Rotation() + FRotator(0, bIsWallOnLeft ? -90 : 90, 0);
+		FVector UnrotatedVelocity = WallRotation.UnrotateVector(Velocity);
+		if (UnrotatedVelocity.Y * (bIsWallOnLeft ? 1 : -1) > WallrunMaxSideSpeed || UnrotatedVelocity.X < 1)
+		{
+			return false;
+		}
+
+		const float WallrunEndTime = Parameters.MaxWallrunTime - Rules.TimeSinceJump;
+		float NextLungeTime = Time + WallrunLungeSampleInterval;
+		FHitResult Hit;
+
+		while (Time < WallrunEndTime)
+		{
+			//The velocity is overwritten every tick exactly like in the Wallrun case of TickComponent
+			bool bHeightBoostPossible = FMath::Abs(Rules.JumpOffZ - Centre.Z) < Parameters.WallrunMaxHeightGain && Centre.Z - Rules.JumpOffZ - Parameters.WallrunMaxHeightGain < 0;
+			Velocity = Facing.RotateVector(FVector(Parameters.WallrunForwardSpeed, bIsWallOnLeft ? -Parameters.WallrunSideSpeed : Parameters.WallrunSideSpeed, bHeightBoostPossible ? (Rules.JumpOffZ + Parameters.JumpZVelocity) - Centre.Z : 0));
+
+			Context.QueryCount++;
+			if (World->SweepSingleByChannel(OUT Hit, Centre, Centre + Velocity * SimulationTimeStep, FQuat::Identity, ECC_Pawn, CapsuleShape, QueryParams))
+			{
+				Centre = Hit.bStartPenetrating ? Centre : Hit.Location;
+				Time += SimulationTimeStep * Hit.Time;
+				break;
+			}
+			Centre += Velocity * SimulationTimeStep;
+			Time += SimulationTimeStep;
+
+			//The wallrun ends when the wall ends, when something blocks the way ahead or when the floor gets close
+			if (!ProbeDirection(Centre, bIsWallOnLeft ? LeftDirection : RightDirection, Hit, Context)) { break; }
+			if (ProbeDirection(Centre, AheadDirection, Hit, Context)) { break; }
+			if (ProbeDirection(Centre, DownDirection, Hit, Context)) { break; }
+
+			//Jumping off the wall is possible at any moment, so it is sampled at regular intervals
+			if (Time >= NextLungeTime)
+			{
+				EmitWallrunLunges(Centre, Velocity, Yaw, bIsWallOnLeft, Rules.TimeSinceJump + Time, Context);
+				NextLungeTime += WallrunLungeSampleInterval;
+			}
+		}
+
+		return true;
+	}
+
+	bool FParkourReachabilityAnalyzer::TestClimbUp(const FVector& HangLocation, float HangYaw, FVector& OutFloorLocation, FTaskContext& Context) const
+	{
+		//Same two sweeps as TestForClimbUpLocation: straight up above the ledge, then forward onto it
+		const FVector RaisedLocation = HangLocation + FVector(0, 0, Parameters.AttachHeight + Parameters.CapsuleHalfHeight);
+		const FVector ClimbUpLocation = RaisedLocation + FRotator(0, HangYaw, 0).RotateVector(FVector(2 * Parameters.CapsuleRadius, 0, 1));
+		FHitResult Hit;
+
+		Context.QueryCount += 3;
+		if (World->SweepSingleByChannel(OUT Hit, HangLocation, RaisedLocation, FQuat::Identity, ECC_Pawn, CapsuleShape, QueryParams)) { return false; }
+		if (World->SweepSingleByChannel(OUT Hit, RaisedLocation + FVector(0, 0, 1), ClimbUpLocation, FQuat::Identity, ECC_Pawn, CapsuleShape, QueryParams)) { return false; }
+
+		//The node graph stores floor locations, so the floor under the capsule is looked up
+		const FVector FloorTraceEnd = ClimbUpLocation - FVector(0, 0, Parameters.CapsuleHalfHeight + Parameters.MaxStepHeight);
+		if (!World->LineTraceSingleByChannel(OUT Hit, ClimbUpLocation, FloorTraceEnd, ECC_Pawn, QueryParams)) { return false; }
+
+		OutFloorLocation = Hit.ImpactPoint;
+		return true;
+	}
+
+	void FParkourReachabilityAnalyzer::EmitResult(EReachMove Move, const FArcResult& Result, int32 HangDepth, FTaskContext& Context) const
+	{
+		switch (Result.Outcome) {
+		case ArcOutcome_Landed:
+			AddEdge(Move, FindNode(Result.Location), Result.Time, Context);
+			break;
+		case ArcOutcome_Hung:
+			EmitHangEdges(Result, HangDepth, Context);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void FParkourReachabilityAnalyzer::EmitHangEdges(const FArcResult& HangResult, int32 HangDepth, FTaskContext& Context) const
+	{
+		FVector ClimbUpFloor;
+		if (TestClimbUp(HangResult.Location, HangResult.Yaw, OUT ClimbUpFloor, Context))
+		{
+			AddEdge(ReachMove_ClimbUp, FindNode(ClimbUpFloor), HangResult.Time, Context);
+		}
+
+		//Only the first hang of a sequence is followed by lunges, otherwise every ledge pair would multiply the work
+		if (HangDepth > 0)
+		{
+			return;
+		}
+
+		//Jumping while looking more than 90 degrees away from the wall performs a lunge instead of climbing up
+		const float LungeYawOffsets[] = { 100.f, 135.f, 180.f, 225.f, 260.f };
+		const float LungePitches[] = { Parameters.LungeMinPitch, Parameters.LungeMaxPitch };
+
+		FArcRules LungeRules;
+		LungeRules.NoHangTime = Parameters.NoHangDuration;
+		LungeRules.JumpOffZ = HangResult.Location.Z;
+
+		for (float YawOffset : LungeYawOffsets)
+		{
+			for (float Pitch : LungePitches)
+			{
+				//The vertical velocity of a hanging player is zero, so the lunge uses half of the jump velocity
+				const FRotator LungeRotation(Pitch, HangResult.Yaw + YawOffset, 0);
+				const FVector LungeVelocity = LungeRotation.RotateVector(FVector(Parameters.LungeForwardSpeed, 0, Parameters.JumpZVelocity * 0.5f));
+
+				FArcResult LungeResult = SimulateArc(HangResult.Location, LungeVelocity, LungeRotation.Yaw, LungeRules, Context);
+				LungeResult.Time += HangResult.Time;
+				EmitResult(ReachMove_Lunge, LungeResult, HangDepth + 1, Context);
+			}
+		}
+	}
+
+	void FParkourReachabilityAnalyzer::EmitWallrunLunges(const FVector& Centre, const FVector& Velocity, float Yaw, bool bIsWallOnLeft, float Time, FTaskContext& Context) const
+	{
+		//The player can look anywhere while wallrunning; straight ahead and two angles away from the wall are sampled
+		const float AwayFromWall = bIsWallOnLeft ? 1.f : -1.f;
+		const float LungeYawOffsets[] = { 0.f, 45.f * AwayFromWall, 90.f * AwayFromWall };
+		const float LungePitches[] = { Parameters.LungeMinPitch, Parameters.LungeMaxPitch };
+
+		FArcRules LungeRules;
+		LungeRules.JumpOffZ = Centre.Z;
+		LungeRules.TimeSinceJump = Time;
+
+		for (float YawOffset : LungeYawOffsets)
+		{
+			for (float Pitch : LungePitches)
+			{
+				const FRotator LungeRotation(Pitch, Yaw + YawOffset, 0);
+				const FVector LungeVelocity = LungeRotation.RotateVector(FVector(Parameters.LungeForwardSpeed, 0, FMath::Max(Velocity.Z, Parameters.JumpZVelocity * 0.5f)));
+
+				FArcResult LungeResult = SimulateArc(Centre, LungeVelocity, LungeRotation.Yaw, LungeRules, Context);
+				LungeResult.Time += Time;
+				EmitResult(ReachMove_Lunge, LungeResult, 1, Context);
+			}
+		}
+	}
+
+	void FParkourReachabilityAnalyzer::AddEdge(EReachMove Move, int32 To, float Time, FTaskContext& Context) const
+	{
+		if (To == INDEX_NONE || To == (int32)Context.FromNode)
+		{
+			return;
+		}
+
+		FReachEdge Edge;
+		Edge.To = To;
+		Edge.Move = Move;
+		Edge.AirTimeMs = (uint16)FMath::Clamp(FMath::RoundToInt(Time * 1000.f), 0, (int32)MAX_uint16);
+		Context.Edges.Add(Edge);
+	}
+
+	void FParkourReachabilityAnalyzer::MarkReachableNodes()
+	{
+		TArray<int32> OpenNodes;
+
+		for (TActorIterator<APlayerStart> It(World); It; ++It)
+		{
+			//Player starts float above the floor, so the floor is looked up first
+			FHitResult Hit;
+			const FVector StartLocation = It->GetActorLocation();
+			if (!World->LineTraceSingleByChannel(OUT Hit, StartLocation, StartLocation - FVector(0, 0, 4 * Parameters.CapsuleHalfHeight), ECC_Pawn, QueryParams)) { continue; }
+
+			int32 SpawnNode = FindNode(Hit.ImpactPoint);
+			if (SpawnNode == INDEX_NONE || (Nodes[SpawnNode].Flags & ReachNode_Spawn)) { continue; }
+
+			Nodes[SpawnNode].Flags |= ReachNode_Spawn | ReachNode_Reachable;
+			OpenNodes.Add(SpawnNode);
+			SpawnNodeCount++;
+		}
+
+		while (OpenNodes.Num() > 0)
+		{
+			int32 NodeIndex = OpenNodes.Pop(false);
+			for (const FReachEdge& Edge : EdgesPerNode[NodeIndex])
+			{
+				if (!(Nodes[Edge.To].Flags & ReachNode_Reachable))
+				{
+					Nodes[Edge.To].Flags |= ReachNode_Reachable;
+					OpenNodes.Add(Edge.To);
+				}
+			}
+		}
+	}
+
+	bool FParkourReachabilityAnalyzer::WriteGraph(const FString& Filename) const
+	{
+		TArray<uint8> Buffer;
+		FMemoryWriter Writer(Buffer);
+
+		//Header
+		uint32 Magic = 0x48435250; // "PRCH"
+		uint16 Version = 1;
+		uint16 MoveCount = ReachMove_Count;
+		Writer << Magic << Version << MoveCount;
+
+		//The rules the graph was built with, so consumers can tell if it is out of date
+		FParkourSimulationParameters WrittenParameters = Parameters;
+		Writer << WrittenParameters.GravityZ << WrittenParameters.JumpZVelocity << WrittenParameters.MaxWalkSpeed << WrittenParameters.LungeForwardSpeed;
+		Writer << WrittenParameters.WallrunForwardSpeed << WrittenParameters.WallrunSideSpeed << WrittenParameters.MaxWallrunTime;
+		Writer << WrittenParameters.CapsuleRadius << WrittenParameters.CapsuleHalfHeight;
+
+		//Node locations are quantised to 16 bits per axis relative to the minimum of the world bounds
+		FVector Origin = WorldBounds.Min;
+		float QuantizationStep = FMath::Max(1.f, WorldBounds.GetSize().GetMax() / MAX_uint16);
+		Writer << Origin << QuantizationStep;
+
+		uint32 NodeCount = Nodes.Num();
+		uint32 EdgeCount = 0;
+		for (const TArray<FReachEdge>& Edges : EdgesPerNode)
+		{
+			EdgeCount += Edges.Num();
+		}
+		Writer << NodeCount << EdgeCount;
+
+		for (const FReachNode& Node : Nodes)
+		{
+			FVector Quantized = (Node.Location - Origin) / QuantizationStep;
+			uint16 X = (uint16)FMath::Clamp(FMath::RoundToInt(Quantized.X), 0, (int32)MAX_uint16);
+			uint16 Y = (uint16)FMath::Clamp(FMath::RoundToInt(Quantized.Y), 0, (int32)MAX_uint16);
+			uint16 Z = (uint16)FMath::Clamp(FMath::RoundToInt(Quantized.Z), 0, (int32)MAX_uint16);
+			uint8 Flags = Node.Flags;
+			Writer << X << Y << Z << Flags;
+		}
+
+		//Edges are stored as a compressed sparse row: an offset table followed by the edges of every node in order
+		uint32 EdgeOffset = 0;
+		for (const TArray<FReachEdge>& Edges : EdgesPerNode)
+		{
+			Writer << EdgeOffset;
+			EdgeOffset += Edges.Num();
+		}
+		Writer << EdgeOffset;
+
+		for (const TArray<FReachEdge>& Edges : EdgesPerNode)
+		{
+			for (FReachEdge Edge : Edges)
+			{
+				Writer << Edge.To << Edge.Move << Edge.AirTimeMs;
+			}
+		}
+
+		return FFileHelper::SaveArrayToFile(Buffer, *Filename);
+	}
+
+	FString FParkourReachabilityAnalyzer::BuildReport(const FString& MapName, double SamplingSeconds, double SimulationSeconds) const
+	{
+		int32 LedgeCount = 0;
+		int32 ReachableCount = 0;
+		int32 UnreachableLedgeCount = 0;
+		for (const FReachNode& Node : Nodes)
+		{
+			LedgeCount += (Node.Flags & ReachNode_Ledge) ? 1 : 0;
+			ReachableCount += (Node.Flags & ReachNode_Reachable) ? 1 : 0;
+			UnreachableLedgeCount += ((Node.Flags & ReachNode_Ledge) && !(Node.Flags & ReachNode_Reachable)) ? 1 : 0;
+		}
+
+		int64 EdgeCountPerMove[ReachMove_Count] = {};
+		int64 EdgeCount = 0;
+		for (const TArray<FReachEdge>& Edges : EdgesPerNode)
+		{
+			for (const FReachEdge& Edge : Edges)
+			{
+				EdgeCountPerMove[Edge.Move]++;
+			}
+			EdgeCount += Edges.Num();
+		}
+
+		FString Report;
+		Report += FString::Printf(TEXT("Parkour reachability report for %s\n"), *MapName);
+		Report += FString::Printf(TEXT("Grid: %d x %d columns, %.0f uu spacing, %d directions\n"), GridSizeX, GridSizeY, Spacing, NumDirections);
+		Report += FString::Printf(TEXT("Rules: JumpZVelocity %.0f, lunge %.0f uu/s(pitch %.0f..%.0f), wallrun %.0f/%.0f uu/s for %.1f s\n"),
+			Parameters.JumpZVelocity, Parameters.LungeForwardSpeed, Parameters.LungeMinPitch, Parameters.LungeMaxPitch, Parameters.WallrunForwardSpeed, Parameters.WallrunSideSpeed, Parameters.MaxWallrunTime);
+		Report += FString::Printf(TEXT("Nodes: %d(%d ledges)\n"), Nodes.Num(), LedgeCount);
+		Report += FString::Printf(TEXT("Edges: %lld\n"), EdgeCount);
+		for (int32 Move = 0; Move < ReachMove_Count; Move++)
+		{
+			Report += FString::Printf(TEXT("    %-10s %lld\n"), ReachMoveNames[Move], EdgeCountPerMove[Move]);
+		}
+		if (SpawnNodeCount > 0)
+		{
+			Report += FString::Printf(TEXT("Reachable from %d player start(s): %d of %d nodes, %d ledges unreachable\n"), SpawnNodeCount, ReachableCount, Nodes.Num(), UnreachableLedgeCount);
+		}
+		else
+		{
+			Report += TEXT("No player start found on a sampled floor; reachability from spawn wasn't computed\n");
+		}
+		Report += FString::Printf(TEXT("Scene queries: %lld\n"), TotalQueryCount);
+		Report += FString::Printf(TEXT("Sampling took %.2f s, simulation took %.2f s\n"), SamplingSeconds, SimulationSeconds);
+		return Report;
+	}
+}
+
+UParkourReachabilityCommandlet::UParkourReachabilityCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UParkourReachabilityCommandlet::Main(const FString& Params)
+{
+	FString MapName = TEXT("/Game/Levels/BuildingEscape1");
+	FParse::Value(*Params, TEXT("Map="), MapName);
+
+	FString PawnClassPath = TEXT("/Game/Blueprints/EscapeDefaultPlayerPawn.EscapeDefaultPlayerPawn_C");
+	FParse::Value(*Params, TEXT("Pawn="), PawnClassPath);
+
+	float Spacing = 75.f;
+	FParse::Value(*Params, TEXT("Spacing="), Spacing);
+	Spacing = FMath::Max(Spacing, 10.f);
+
+	int32 NumDirections = 16;
+	FParse::Value(*Params, TEXT("Directions="), NumDirections);
+	NumDirections = FMath::Clamp(NumDirections, 4, 64);
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Reachability") / FPackageName::GetShortName(MapName);
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	UWorld* World = CommandletWorldLoader::LoadWorld(MapName);
+	if (!World)
+	{
+		return 1;
+	}
+
+	//The rules are read from the pawn defaults so any values overriden in the Blueprint are respected
+	UClass* PawnClass = LoadClass<ADefaultEscapePawn>(nullptr, *PawnClassPath);
+	if (!PawnClass)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Pawn class %s couldn't be loaded, native defaults of ADefaultEscapePawn will be used instead."), *PawnClassPath);
+		PawnClass = ADefaultEscapePawn::StaticClass();
+	}
+	ADefaultEscapePawn* PawnDefaults = PawnClass->GetDefaultObject<ADefaultEscapePawn>();
+	float CapsuleRadius, CapsuleHalfHeight;
+	PawnDefaults->GetCapsuleComponent()->GetScaledCapsuleSize(OUT CapsuleRadius, OUT CapsuleHalfHeight);
+	UParkourMovementComponent* MovementDefaults = PawnDefaults->GetParkourMovementComponent();
+	FParkourSimulationParameters Parameters = MovementDefaults->GetSimulationParameters(CapsuleRadius, CapsuleHalfHeight);
+	Parameters.GravityZ = World->GetGravityZ() * MovementDefaults->GravityScale;
+
+	FParkourReachabilityAnalyzer Analyzer(World, Parameters, Spacing, NumDirections);
+	if (!Analyzer.HasValidBounds())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Map %s has no geometry to analyse!"), *MapName);
+		CommandletWorldLoader::ReleaseWorld(World);
+		return 1;
+	}
+
+	double StartTime = FPlatformTime::Seconds();
+	Analyzer.SampleNodes();
+	double SamplingSeconds = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	Analyzer.BuildEdges();
+	Analyzer.MarkReachableNodes();
+	double SimulationSeconds = FPlatformTime::Seconds() - StartTime;
+
+	const FString Report = Analyzer.BuildReport(MapName, SamplingSeconds, SimulationSeconds);
+	bool bSaved = Analyzer.WriteGraph(OutputPath + TEXT(".prg"));
+	bSaved &= FFileHelper::SaveStringToFile(Report, *(OutputPath + TEXT(".txt")));
+
+	UE_LOG(LogTemp, Display, TEXT("%s"), *Report);
+	if (!bSaved)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write the reachability graph to %s"), *OutputPath);
+	}
+
+	CommandletWorldLoader::ReleaseWorld(World);
+	return bSaved ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ParkourReachabilityCommandlet.generated.h"
+
+/**
+ * Samples every standable spot of a map and simulates the parkour moves(jump, crawl jump, tuck jump, wallrun, lunge and climb up) from each of them
+ * with the same rules as UParkourMovementComponent. The resulting reachability graph is written to a compact binary file next to a text summary.
+ *
+ * Usage: UE4Editor-Cmd Building_Escape.uproject -run=ParkourReachability -Map=/Game/Levels/BuildingEscape1
+ *        [-Pawn=/Game/Blueprints/EscapeDefaultPlayerPawn.EscapeDefaultPlayerPawn_C] [-Spacing=75] [-Directions=16] [-Output=<path without extension>]
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UParkourReachabilityCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UParkourReachabilityCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
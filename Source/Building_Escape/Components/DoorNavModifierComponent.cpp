@@ -0,0 +1,45 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "DoorNavModifierComponent.h"
+#include "AI/Navigation/NavigationRelevantData.h"
+#include "AI/NavigationModifier.h"
+#include "NavAreas/NavArea_Null.h"
+
+UDoorNavModifierComponent::UDoorNavModifierComponent()
+{
+	//The owner's root might be the door itself, which isn't relevant for navigation, so the passage is always an element of its own
+	bAttachToOwnersRoot = false;
+	AreaClass = UNavArea_Null::StaticClass();
+}
+
+void UDoorNavModifierComponent::SetPassage(const FBox& LocalBox, const FTransform& Transform)
+{
+	PassageBox = LocalBox;
+	PassageTransform = Transform;
+}
+
+void UDoorNavModifierComponent::SetAreaClass(TSubclassOf<UNavArea> NewAreaClass)
+{
+	if (AreaClass != NewAreaClass)
+	{
+		AreaClass = NewAreaClass;
+		if (IsRegistered())
+		{
+			RefreshNavigationModifiers();
+		}
+	}
+}
+
+void UDoorNavModifierComponent::CalcAndCacheBounds() const
+{
+	Bounds = PassageBox.TransformBy(PassageTransform);
+}
+
+void UDoorNavModifierComponent::GetNavigationData(FNavigationRelevantData& Data) const
+{
+	if (PassageBox.IsValid)
+	{
+		Data.Modifiers.Add(FAreaNavModifier(PassageBox, PassageTransform, AreaClass));
+	}
+}
@@ -0,0 +1,37 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/Navigation/NavRelevantComponent.h"
+#include "DoorNavModifierComponent.generated.h"
+
+class UNavArea;
+
+/**
+ * Marks the passage of a door on the navmesh with an area that is switched when the door opens or closes.
+ * The door geometry itself doesn't affect navigation, so a moving door never makes the navmesh rebuild; only a change of the area does, once per open or close.
+ * The passage is a fixed box around the closed door, set by the door before the component is registered.
+ */
+UCLASS(ClassGroup = (Navigation))
+class BUILDING_ESCAPE_API UDoorNavModifierComponent : public UNavRelevantComponent
+{
+	GENERATED_BODY()
+
+public:
+	UDoorNavModifierComponent();
+
+	//The box is in the space of the transform
+	void SetPassage(const FBox& LocalBox, const FTransform& Transform);
+	//Updates the navmesh around the passage, but only if the area actually changed
+	void SetAreaClass(TSubclassOf<UNavArea> NewAreaClass);
+
+	virtual void CalcAndCacheBounds() const override;
+	virtual void GetNavigationData(FNavigationRelevantData& Data) const override;
+
+private:
+	UPROPERTY()
+	TSubclassOf<UNavArea> AreaClass;
+	FBox PassageBox = FBox(ForceInit);
+	FTransform PassageTransform = FTransform::Identity;
+};
@@ -0,0 +1,17 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "HoldPhysicsHandleComponent.h"
+
+UHoldPhysicsHandleComponent::UHoldPhysicsHandleComponent()
+{
+	//The target is driven from the physics substeps, so the handle must not move it once more from the game tick
+	PrimaryComponentTick.bCanEverTick = false;
+	bInterpolateTarget = false;
+}
+
+void UHoldPhysicsHandleComponent::DriveTarget(const FTransform& Target)
+{
+	SetTargetLocationAndRotation(Target.GetLocation(), Target.Rotator());
+	UpdateHandleTransform(Target);
+}
@@ -0,0 +1,24 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PhysicsEngine/PhysicsHandleComponent.h"
+#include "HoldPhysicsHandleComponent.generated.h"
+
+/**
+ * Physics handle whose target isn't moved by its own tick but by whoever holds it, from a physics substep callback.
+ * The kinematic target is then set right before each substep is simulated, so the held body follows a target that is interpolated within the frame
+ * instead of jumping once per game tick.
+ */
+UCLASS(ClassGroup = (Custom))
+class BUILDING_ESCAPE_API UHoldPhysicsHandleComponent : public UPhysicsHandleComponent
+{
+	GENERATED_BODY()
+
+public:
+	UHoldPhysicsHandleComponent();
+
+	//Moves the kinematic end of the handle right away; meant to be called from a custom physics(substep) callback of the grabbed body
+	void DriveTarget(const FTransform& Target);
+};
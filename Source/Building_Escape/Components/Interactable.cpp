@@ -5,6 +5,16 @@
 #include "Components/StaticMeshComponent.h"
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Logging/MessageLog.h"
+#include "Misc/UObjectToken.h"
+#include "Subsystems/CheckpointSubsystem.h"
+#include "Subsystems/InteractableRegistrySubsystem.h"
+#include "Subsystems/GameplayEventBusSubsystem.h"
+#include "Components/PhysicsPropComponent.h"
+#include "EscapeHUD.h"
 
 // Sets default values for this component's properties
 UInteractable::UInteractable()
@@ -12,8 +22,6 @@ UInteractable::UInteractable()
 	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = true;
-
-	// ...
 }
 
 
@@ -21,36 +29,72 @@ UInteractable::UInteractable()
 void UInteractable::BeginPlay()
 {
 	Super::BeginPlay();
-	//Attempting to find the intended collision body Static Mesh; By design, it should be just above the component in the hierarchy;
-	OwnersStaticMeshComponent = Cast<UStaticMeshComponent>(GetAttachParent());
-	if (!OwnersStaticMeshComponent)
+
+	//The binding is baked when the level is saved, so resolving it is a single lookup; interactables that were never saved(e.g. spawned at runtime) still search for it
+	if (bHasBakedBinding)
 	{
-		OwnersStaticMeshComponent = (UStaticMeshComponent*)(GetOwner()->GetComponentByClass(UStaticMeshComponent::StaticClass()));
-		if (!OwnersStaticMeshComponent)
+		if (bIsBoundToAttachParent)
+		{
+			BoundPrimitive = Cast<UPrimitiveComponent>(GetAttachParent());
+		}
+		else if (BoundPrimitiveName != NAME_None)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("Interactor found no static mesh on actor %s. The actor might not work properly!"), *GetOwner()->GetName());
+			BoundPrimitive = FindObjectFast<UPrimitiveComponent>(GetOwner(), BoundPrimitiveName);
 		}
-		else
+
+		//The component was renamed or the Blueprint changed since the level was saved; the binding is searched for like an unbaked one until the level is saved again
+		if (!BoundPrimitive)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("Interable component on %s isn't attached directly to a static mesh component! First found static mesh on the actor was chosen instead."), *GetOwner()->GetName());
+			bool bIsAttachParent;
+			BoundPrimitive = FindBindingCandidate(OUT bIsAttachParent);
+			UE_LOG(LogTemp, Warning, TEXT("Baked binding of interactable %s on %s(%s) no longer resolves, %s was found instead. Save the level to bake it again."),
+				*GetName(), *GetNameSafe(GetOwner()), bIsBoundToAttachParent ? TEXT("attach parent") : *BoundPrimitiveName.ToString(), *GetNameSafe(BoundPrimitive));
 		}
 	}
+	else
+	{
+		bool bIsAttachParent;
+		BoundPrimitive = FindBindingCandidate(OUT bIsAttachParent);
+	}
 
+	if (!BoundPrimitive)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Interactable %s on %s has no primitive to bind to. The actor might not work properly!"), *GetName(), *GetNameSafe(GetOwner()));
+	}
+	else if (CurrentInteractionType == Hold && BoundPrimitive->IsSimulatingPhysics())
+	{
+		//Holdable props replicate through their physics prop component; the server adds it where the Blueprint didn't
+		UPhysicsPropComponent::FindOrAddTo(GetOwner());
+	}
 
+	bIsInteractableActive = bIsActiveAtStart;
 
-	if (OwnersStaticMeshComponent->GetGenerateOverlapEvents())
+	//Interactors find interactables through the registry, so the owning mesh doesn't need to generate overlap events
+	InteractableRegistry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>();
+	if (InteractableRegistry)
 	{
-		//UE_LOG(LogTemp, Warning, TEXT("%s is already set to generate overlap events!"),*GetOwner()->GetName())
+		InteractableRegistry->RegisterInteractable(this);
 	}
-	else
+
+	if (UGameInstance* GameInstance = GetWorld()->GetGameInstance())
 	{
-		//UE_LOG(LogTemp, Warning, TEXT("%s wasn't set to generate overlap events, setting now!"), *GetOwner()->GetName())
-		OwnersStaticMeshComponent->SetGenerateOverlapEvents(true);
+		DisplayDataSubsystem = GameInstance->GetSubsystem<UInteractionDisplayDataSubsystem>();
+		if (DisplayDataSubsystem)
+		{
+			DisplayDataIndex = DisplayDataSubsystem->FindDisplayDataIndex(this);
+		}
 	}
+}
 
-	bIsInteractableActive = bIsActiveAtStart;
-	// ...
-	
+void UInteractable::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (InteractableRegistry)
+	{
+		InteractableRegistry->UnregisterInteractable(this);
+		InteractableRegistry = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 
@@ -72,30 +116,172 @@ void UInteractable::SetIsFocused(bool bNewIsFocused)
 	if (!bNewIsFocused)
 	{
 		CurrentFocusState = bIsMarked ? MarkedState : InactiveState;
-		FocusStateChanged.Broadcast();
+		OnFocusStateChanged();
 		return;
 	}
 
 	CurrentFocusState = FocusedState;
 	
 
-	FocusStateChanged.Broadcast();
+	OnFocusStateChanged();
+}
+
+void UInteractable::OnFocusStateChanged()
+{
+	//Registered interactables report through the registry's per frame change list; the others can only broadcast right away
+	if (InteractableRegistry)
+	{
+		InteractableRegistry->QueueFocusStateChange(this);
+		return;
+	}
+
+	TEnumAsByte<EFocusState> PreviousState;
+	FlushFocusStateChange(OUT PreviousState);
+}
+
+bool UInteractable::FlushFocusStateChange(TEnumAsByte<EFocusState>& OutPreviousState)
+{
+	//Marking and focusing within the same frame can end in the state that was already broadcast, in which case nothing changed for the listeners
+	if (CurrentFocusState == BroadcastFocusState)
+	{
+		return false;
+	}
+
+	OutPreviousState = BroadcastFocusState;
+	BroadcastFocusState = CurrentFocusState;
+	if (FocusStateChanged.IsBound())
+	{
+		FocusStateChanged.Broadcast();
+	}
+	return true;
 }
 
 void UInteractable::StartInteraction()
 {
-	InteractionStart.Broadcast();
+	//Interactions drive doors and grabbing in Blueprint, so those listeners are reached right away; native ones get it through the event bus
+	if (InteractionStart.IsBound())
+	{
+		InteractionStart.Broadcast();
+	}
+	PostInteractionEvent(true);
 }
 
 void UInteractable::EndInteraction()
 {
-	InteractionEnd.Broadcast();
+	if (InteractionEnd.IsBound())
+	{
+		InteractionEnd.Broadcast();
+	}
+	PostInteractionEvent(false);
+}
+
+void UInteractable::PostInteractionEvent(bool bIsStart)
+{
+	if (UGameplayEventBusSubsystem* EventBus = GetWorld()->GetSubsystem<UGameplayEventBusSubsystem>())
+	{
+		FInteractionEvent Event;
+		Event.Source = this;
+		Event.bIsStart = bIsStart;
+		EventBus->Interaction.Post(Event);
+	}
 }
 
 UPrimitiveComponent * UInteractable::GetOwningPrimitive() const
 {
-	return OwnersStaticMeshComponent;
+	return BoundPrimitive;
+}
+
+UPrimitiveComponent* UInteractable::FindBindingCandidate(bool& bOutIsAttachParent) const
+{
+	//By design the collision body static mesh is just above the component in the hierarchy; otherwise the first static mesh of the actor is used
+	UPrimitiveComponent* Candidate = Cast<UStaticMeshComponent>(GetAttachParent());
+	bOutIsAttachParent = Candidate != nullptr;
+	if (!Candidate && GetOwner())
+	{
+		Candidate = GetOwner()->FindComponentByClass<UStaticMeshComponent>();
+	}
+	return Candidate;
+}
+
+bool UInteractable::BakeBinding()
+{
+	bool bIsAttachParent;
+	const UPrimitiveComponent* Candidate = FindBindingCandidate(OUT bIsAttachParent);
+	const FName CandidateName = Candidate ? Candidate->GetFName() : NAME_None;
+
+	if (bHasBakedBinding && bIsBoundToAttachParent == bIsAttachParent && BoundPrimitiveName == CandidateName)
+	{
+		return false;
+	}
+
+	bHasBakedBinding = true;
+	bIsBoundToAttachParent = bIsAttachParent;
+	BoundPrimitiveName = CandidateName;
+	return true;
+}
+
+bool UInteractable::ValidateBinding(TArray<FString>& OutProblems) const
+{
+	bool bIsAttachParent;
+	const UPrimitiveComponent* Candidate = FindBindingCandidate(OUT bIsAttachParent);
+	if (!Candidate)
+	{
+		OutProblems.Add(TEXT("No static mesh found on the actor, the interactable has no collision body."));
+		return false;
+	}
+
+	if (!bIsAttachParent)
+	{
+		OutProblems.Add(FString::Printf(TEXT("Not attached directly to a static mesh component, %s was bound instead."), *Candidate->GetName()));
+	}
+
+	const ECollisionEnabled::Type CollisionEnabled = Candidate->GetCollisionEnabled();
+	if (CollisionEnabled != ECollisionEnabled::QueryOnly && CollisionEnabled != ECollisionEnabled::QueryAndPhysics)
+	{
+		OutProblems.Add(FString::Printf(TEXT("%s has no query collision, it can't block or be found by line of sight traces."), *Candidate->GetName()));
+	}
+
+	//Held interactables are carried by a physics handle
+	if (CurrentInteractionType == Hold)
+	{
+		if (Candidate->Mobility != EComponentMobility::Movable)
+		{
+			OutProblems.Add(FString::Printf(TEXT("%s is a Hold interactable but isn't movable."), *Candidate->GetName()));
+		}
+		if (!Candidate->BodyInstance.bSimulatePhysics || CollisionEnabled != ECollisionEnabled::QueryAndPhysics)
+		{
+			OutProblems.Add(FString::Printf(TEXT("%s is a Hold interactable but doesn't simulate physics with query and physics collision."), *Candidate->GetName()));
+		}
+	}
+	return true;
+}
+
+void UInteractable::PreSave(const ITargetPlatform* TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
+
+	//Templates have no owner or hierarchy to resolve the binding from; their instances are baked when the level is saved or cooked
+	if (!IsTemplate() && GetOwner())
+	{
+		BakeBinding();
+	}
+}
+
+#if WITH_EDITOR
+void UInteractable::CheckForErrors()
+{
+	Super::CheckForErrors();
+
+	TArray<FString> Problems;
+	ValidateBinding(OUT Problems);
+	for (const FString& Problem : Problems)
+	{
+		FMessageLog(TEXT("MapCheck")).Warning()
+			->AddToken(FUObjectToken::Create(GetOwner()))
+			->AddToken(FTextToken::Create(FText::FromString(FString::Printf(TEXT("%s: %s"), *GetName(), *Problem))));
+	}
 }
+#endif
 
 void UInteractable::MarkInteractable()
 {
@@ -103,7 +289,7 @@ void UInteractable::MarkInteractable()
 	{
 		bIsMarked = true;
 		CurrentFocusState = MarkedState;
-		FocusStateChanged.Broadcast();
+		OnFocusStateChanged();
 	}
 }
 
@@ -113,7 +299,7 @@ void UInteractable::UnmarkInteractable()
 	{
 		bIsMarked = false;
 		CurrentFocusState = InactiveState;
-		FocusStateChanged.Broadcast();
+		OnFocusStateChanged();
 	}
 }
 
@@ -122,6 +308,17 @@ TEnumAsByte<EInteractionType> UInteractable::GetInteractionType() const
 	return CurrentInteractionType;
 }
 
+const FInteractionDisplayData& UInteractable::GetDisplayData() const
+{
+	static const FInteractionDisplayData EmptyDisplayData;
+	return DisplayDataSubsystem ? DisplayDataSubsystem->GetDisplayDataAt(DisplayDataIndex) : EmptyDisplayData;
+}
+
+FInteractionDisplayData UInteractable::GetDisplayDataCopy() const
+{
+	return GetDisplayData();
+}
+
 TEnumAsByte <EFocusState> UInteractable::GetFocusState() const
 {
 	return CurrentFocusState;
@@ -129,6 +326,19 @@ TEnumAsByte <EFocusState> UInteractable::GetFocusState() const
 
 void UInteractable::ToggleActivity(bool bNewIsActive)
 {
+	//Changed by an interaction a client predicts; the previous state is kept in case the server rejects it
+	const FInteractionWindow* Window = InteractableRegistry ? InteractableRegistry->GetInteractionWindow() : nullptr;
+	if (Window && Window->RollbackState)
+	{
+		UCheckpointSubsystem::CaptureRecord(*Window->RollbackState, this, FCheckpoint::RecordType_Interactable);
+	}
+
+	//Interactors only evaluate again when something changed, so they are told through the registry
+	if (bIsInteractableActive != bNewIsActive && InteractableRegistry)
+	{
+		InteractableRegistry->NotifyInteractableChanged(this);
+	}
+
 	bIsInteractableActive = bNewIsActive;
 	if (!bIsInteractableActive)
 	{
@@ -136,8 +346,37 @@ void UInteractable::ToggleActivity(bool bNewIsActive)
 	}
 }
 
+void UInteractable::SerializeCheckpoint(FArchive& Ar)
+{
+	uint8 bIsActive = bIsInteractableActive ? 1 : 0;
+	Ar << bIsActive;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	//Focus and marks belong to the interactors; the registry is told even if the activity didn't change, so they evaluate again and set them from the restored world
+	ToggleActivity(bIsActive != 0);
+	if (InteractableRegistry)
+	{
+		InteractableRegistry->NotifyInteractableChanged(this);
+	}
+}
+
 bool UInteractable::GetIfInteractableIsActive()
 {
 	return bIsInteractableActive;
 }
 
+bool UInteractable::ShouldShowIndicatorWidget() const
+{
+	const APlayerController* PlayerController = GetWorld() ? GetWorld()->GetFirstPlayerController() : nullptr;
+	return !(PlayerController && PlayerController->GetHUD() && PlayerController->GetHUD()->IsA<AEscapeHUD>());
+}
+
+const TArray<FPreloadAssetEntry>& UInteractable::GetPreloadAssets() const
+{
+	return PreloadAssets;
+}
+
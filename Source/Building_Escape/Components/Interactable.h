@@ -5,11 +5,15 @@
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
 #include "InteractionSystemLibrary.h"
+#include "AssetPreloadManager.h"
+#include "Subsystems/InteractionDisplayDataSubsystem.h"
 #include "Interactable.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FInteractableDelegate);
 
-UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent), Blueprintable)
+class UInteractableRegistrySubsystem;
+
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent), Blueprintable, Config = Game)
 class BUILDING_ESCAPE_API UInteractable : public USceneComponent
 {
 	GENERATED_BODY()
@@ -21,6 +25,7 @@ public:
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
@@ -31,17 +36,35 @@ public:
 	FInteractableDelegate InteractionStart;
 	UPROPERTY(BlueprintAssignable)
 	FInteractableDelegate InteractionEnd;
+	//Broadcast at most once per frame, at its end, and only if the focus state differs from the one last broadcast
 	UPROPERTY(BlueprintAssignable)
 	FInteractableDelegate FocusStateChanged;
+	//Called by the registry at the end of the frame; broadcasts FocusStateChanged and returns true if the state differs from the one last broadcast
+	bool FlushFocusStateChange(TEnumAsByte<EFocusState>& OutPreviousState);
 	UPROPERTY(EditAnywhere, Category = "Interaction", DisplayName = "Interaction Type")
 	TEnumAsByte<EInteractionType> CurrentInteractionType = Use;
 	UFUNCTION(BlueprintPure, Category = "Interaction", DisplayName = "Get Focus State")
 	TEnumAsByte <EFocusState> GetFocusState() const;
 	UFUNCTION(BlueprintPure, Category = "Interaction", DisplayName = "Get Interaction Type")
 	TEnumAsByte<EInteractionType> GetInteractionType() const;
+	//Name and icon shown for the interaction; the row is resolved once at BeginPlay, so this is only an array access
+	const FInteractionDisplayData& GetDisplayData() const;
+	UFUNCTION(BlueprintPure, Category = "Interaction", DisplayName = "Get Interaction Display Data")
+	FInteractionDisplayData GetDisplayDataCopy() const;
 
 	UPrimitiveComponent * GetOwningPrimitive() const;
 
+	//Resolves the collision body the interactable belongs to and stores it, so BeginPlay doesn't have to search for it; returns true if the stored binding changed.
+	//Done on every save(and so on cook) and by the interactable validation commandlet
+	bool BakeBinding();
+	//Appends a line for each problem with the binding or the collision setup of the bound primitive; returns false if there is nothing to bind to
+	bool ValidateBinding(TArray<FString>& OutProblems) const;
+
+	virtual void PreSave(const class ITargetPlatform* TargetPlatform) override;
+#if WITH_EDITOR
+	virtual void CheckForErrors() override;
+#endif
+
 	void StartInteraction();
 	void EndInteraction();
 	void MarkInteractable();
@@ -53,11 +76,38 @@ public:
 	void ToggleActivity(bool bNewIsActive);
 	UFUNCTION(BlueprintCallable, DisplayName = "IS interactable active")
 	bool GetIfInteractableIsActive();
+	//The Indicator widget of Interactable_Base predates AEscapeHUD, which draws every indicator itself; the Blueprint only creates the widget while this returns true
+	UFUNCTION(BlueprintPure, Category = "Interaction", DisplayName = "Should Show Indicator Widget")
+	bool ShouldShowIndicatorWidget() const;
+
+	//Writes or reads the activity for the checkpoint subsystem; the interactors evaluate their focus and marks again after a load
+	void SerializeCheckpoint(FArchive& Ar);
+
+	//Widgets and data the interactable uses once it is focused; preloaded by the game mode so the first focus doesn't hitch.
+	//The defaults are read from the [/Script/Building_Escape.Interactable] section of DefaultGame.ini
+	UPROPERTY(Config, EditAnywhere, Category = "Preloading")
+	TArray<FPreloadAssetEntry> PreloadAssets;
+	const TArray<FPreloadAssetEntry>& GetPreloadAssets() const;
 
 
 private:
 	TEnumAsByte <EFocusState> CurrentFocusState = InactiveState;
-	UStaticMeshComponent* OwnersStaticMeshComponent;
+	TEnumAsByte <EFocusState> BroadcastFocusState = InactiveState;
+	UInteractableRegistrySubsystem* InteractableRegistry = nullptr;
+	UInteractionDisplayDataSubsystem* DisplayDataSubsystem = nullptr;
+	int32 DisplayDataIndex = INDEX_NONE;
+	void OnFocusStateChanged();
+	void PostInteractionEvent(bool bIsStart);
+	UPrimitiveComponent* BoundPrimitive = nullptr;
+	UPrimitiveComponent* FindBindingCandidate(bool& bOutIsAttachParent) const;
+
+	//Baked binding; the primitive is either the attach parent or a component of the owner with this name
+	UPROPERTY(VisibleAnywhere, Category = "Interaction|Binding")
+	bool bHasBakedBinding = false;
+	UPROPERTY(VisibleAnywhere, Category = "Interaction|Binding")
+	bool bIsBoundToAttachParent = false;
+	UPROPERTY(VisibleAnywhere, Category = "Interaction|Binding")
+	FName BoundPrimitiveName;
 	bool bIsMarked = false;
 	bool bIsInteractableActive = true;
 };
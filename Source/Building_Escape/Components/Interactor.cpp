@@ -2,6 +2,8 @@
 
 
 //#include "GameFramework/PlayerController.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/Pawn.h"
 #include "Interactor.h"
 #include "CoreMinimal.h"
 #include "DrawDebugHelpers.h"
@@ -9,11 +11,35 @@
 #include "GenericPlatform/GenericPlatformMath.h"
 #include "GameFramework/PlayerController.h"
 #include "Interactable.h"
-#include "Components/BoxComponent.h"
+#include "Engine/LocalPlayer.h"
+#include "ConvexVolume.h"
+#include "SceneManagement.h"
+#include "SceneView.h"
 #include "PhysicsEngine/PhysicsHandleComponent.h"
 #include "PhysicsEngine/PhysicsConstraintComponent.h"
+#include "Components/HoldPhysicsHandleComponent.h"
+#include "Subsystems/PhysicsPropSleepSubsystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Subsystems/InteractableRegistrySubsystem.h"
 
 
+bool FInteractionRequest::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	UObject* InteractableObject = Interactable;
+	bOutSuccess = Map->SerializeObject(Ar, UInteractable::StaticClass(), InteractableObject);
+
+	uint8 IdAndStart = (PredictionId & 0x7F) | (bIsStart ? 0x80 : 0);
+	Ar << IdAndStart;
+	Ar << ClientTime;
+
+	if (Ar.IsLoading())
+	{
+		Interactable = Cast<UInteractable>(InteractableObject);
+		PredictionId = IdAndStart & 0x7F;
+		bIsStart = (IdAndStart & 0x80) != 0;
+	}
+	return true;
+}
 
 // Sets default values for this component's properties
 UInteractor::UInteractor()
@@ -21,15 +47,10 @@ UInteractor::UInteractor()
 	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = true;
-
-	//Creating the collision box so it lays flat on it's side. Setting up its visibility and collision parameters
-	CollisionMesh = CreateDefaultSubobject<UBoxComponent>(FName("Collision Mesh"));
-	CollisionMesh->AddLocalRotation(FRotator(90.f, 0, 0));
-	CollisionMesh->SetVisibility(true); CollisionMesh->SetHiddenInGame(true);
-	CollisionMesh->SetCollisionProfileName("Trigger"); CollisionMesh->UpdateCollisionProfile();
-	CollisionMesh->SetGenerateOverlapEvents(true);
-
-	// ...
+	//The hold targets are sampled before physics starts, so the substep callbacks never read them while they're being written
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+	//Needed for the owning client to send the state of the props it holds
+	SetIsReplicatedByDefault(true);
 }
 
 // Called when the game starts
@@ -43,22 +64,48 @@ void UInteractor::BeginPlay()
 	//Calculating internal, real values of distance varioables based on the designer-friendly variables
 
 	RangeSquared = FMath::Pow(Range, 2);
-	MarkRangeSquared = FMath::Pow(MarkRange, 2);
+	//The marking range extends the grab range, so the squared value covers both
+	MarkRangeSquared = FMath::Pow(Range + MarkRange, 2);
 	ScreenRangeSquared = FMath::Pow(ScreenRange, 2);
+	LineOfSightRetraceDistanceSquared = FMath::Pow(LineOfSightRetraceDistance, 2);
+
+	//The delegate and the query parameters are the same for every line of sight trace, so they are only set up once
+	TraceScheduler = GetWorld()->GetSubsystem<UTraceSchedulerSubsystem>();
+	LineOfSightDelegate.BindUObject(this, &UInteractor::OnLineOfSightTraceDone);
+	LineOfSightQueryParams = FCollisionQueryParams(FName(TEXT("InteractorLineOfSight")), false, GetOwner());
+
+	//Candidates are found through the world's interactable registry instead of a trigger box, so no overlap events are needed on either side
+	InteractableRegistry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>();
 
-	//Attaching the collision box to the actor that owns this component. Setting its size and offseting it so it is attached fully in front of the actor.
-	CollisionMesh->AttachToComponent(this->GetAttachParent(), FAttachmentTransformRules::KeepRelativeTransform);
-	CollisionMesh->SetBoxExtent(FVector(40, 80, (Range + MarkRange)/2));
-	CollisionMesh->AddLocalOffset(FVector(0, 0, -(Range + MarkRange)/2));
+	PhysicsHandle = NewObject<UHoldPhysicsHandleComponent>(GetOwner(), TEXT("HoldPhysicsHandle"));
+	PhysicsHandle->RegisterComponent();
+	HoldPhysicsDelegate.BindUObject(this, &UInteractor::OnHoldSubstep);
 
-	//Binding member functions to the collision box's overlap delegates
-	CollisionMesh->OnComponentBeginOverlap.AddDynamic(this, &UInteractor::OnOverlapBegin);
-	CollisionMesh->OnComponentEndOverlap.AddDynamic(this, &UInteractor::OnEndOverlap);
-	
 	//Binding input functions to delegates.
 	BindInputs();
-	// ...
-	
+}
+
+void UInteractor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	EndHold();
+	HoldPhysicsDelegate.Unbind();
+	PendingInteractions.Reset();
+
+	//Everything this interactor marked or focused goes back to the inactive state
+	if (InteractableRegistry)
+	{
+		SetFocusedInteractable(FInteractableHandle());
+		EvaluationCounter++;
+		UnmarkDroppedInteractables();
+		MarkedHandles.Reset();
+	}
+	LineOfSightDelegate.Unbind();
+	if (TraceScheduler)
+	{
+		TraceScheduler->CancelRequests(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void UInteractor::BindInputs()
@@ -90,201 +137,816 @@ void UInteractor::TickComponent(float DeltaTime, ELevelTick TickType, FActorComp
 		OUT ViewpointLocation,
 		OUT ViewpointRotation
 		);
-	EvaluateInteractables(OverlappedInteractables, ViewpointLocation);
-	//}
+
+	if (IsHolding())
+	{
+		UpdateHold(DeltaTime, ViewpointLocation, ViewpointRotation);
+	}
+
+	//Only the interactables within the marking range that are inside the view frustum are evaluated further
+	if (!InteractableRegistry)
+	{
+		return;
+	}
+
+	//Only changes within the marking range count; interactables moving anywhere else don't trigger an evaluation
+	const uint32 Revision = InteractableRegistry->GetRevision(ViewpointLocation, Range + MarkRange);
+	bool bIncludeFarMarks = false;
+	if (!ShouldEvaluate(ViewpointLocation, ViewpointRotation, Revision, OUT bIncludeFarMarks))
+	{
+		return;
+	}
+
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	LastEvaluatedLocation = ViewpointLocation;
+	LastEvaluatedRotation = ViewpointRotation;
+	LastEvaluatedRevision = Revision;
+	LastEvaluationTime = CurrentTime;
+	bHasEvaluated = true;
+	bLineOfSightChanged = false;
+	if (bIncludeFarMarks)
+	{
+		LastFullEvaluationTime = CurrentTime;
+	}
+	bFarMarksPending = !bIncludeFarMarks;
+
+	//The view is described once for the whole tick. Without a projection(no local player) nothing can be focused, but marking still works
+	FInteractionFocusView FocusView;
+	FocusView.ViewLocation = ViewpointLocation;
+	FocusView.MarkRangeSquared = MarkRangeSquared;
+	FocusView.ScreenRangeSquared = ScreenRangeSquared;
+
+	FSceneViewProjectionData ProjectionData;
+	FConvexVolume ViewFrustum;
+	const bool bHasProjection = GetViewProjection(OUT ProjectionData);
+	if (bHasProjection)
+	{
+		const FIntRect ViewRect = ProjectionData.GetConstrainedViewRect();
+		UpdateViewportScale(ViewRect.Width());
+
+		FocusView.ViewProjectionMatrix = ProjectionData.ComputeViewProjectionMatrix();
+		FocusView.ViewWidth = ViewRect.Width();
+		FocusView.ViewHeight = ViewRect.Height();
+		FocusView.ScreenScale = CachedViewportScale;
+		FocusView.FocusRangeSquared = RangeSquared;
+		GetViewFrustumBounds(OUT ViewFrustum, FocusView.ViewProjectionMatrix, false);
+	}
+
+	CandidateHandles.Reset();
+	InteractableRegistry->QueryInteractables(ViewpointLocation, bIncludeFarMarks ? Range + MarkRange : Range, bHasProjection ? &ViewFrustum : nullptr, OUT CandidateHandles);
+	EvaluateInteractables(CandidateHandles, FocusView, bIncludeFarMarks);
+}
+
+bool UInteractor::ShouldEvaluate(const FVector& ViewpointLocation, const FRotator& ViewpointRotation, uint32 Revision, bool& bOutIncludeFarMarks) const
+{
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	bOutIncludeFarMarks = !bHasEvaluated || CurrentTime - LastFullEvaluationTime >= FarMarkInterval;
+
+	const bool bHasChanged = !bHasEvaluated
+		|| bLineOfSightChanged
+		|| Revision != LastEvaluatedRevision
+		|| CurrentTime - LastEvaluationTime >= MaxEvaluationStaleness
+		|| FVector::DistSquared(ViewpointLocation, LastEvaluatedLocation) > FMath::Square(EvaluationMoveThreshold)
+		|| !ViewpointRotation.Equals(LastEvaluatedRotation, EvaluationAngleThreshold);
+
+	//Far marks skipped by an earlier evaluation are caught up with once their interval is up, even if nothing changed since
+	return bHasChanged || (bFarMarksPending && bOutIncludeFarMarks);
+}
+
+bool UInteractor::GetViewProjection(FSceneViewProjectionData& OutProjectionData) const
+{
+	//The frustum is only known for local players, whose view is actually rendered
+	ULocalPlayer* LocalPlayer = OwningPlayerController ? OwningPlayerController->GetLocalPlayer() : nullptr;
+	if (!LocalPlayer || !LocalPlayer->ViewportClient || !LocalPlayer->ViewportClient->Viewport)
+	{
+		return false;
+	}
+
+	return LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, eSSP_FULL, OUT OutProjectionData);
 }
 
 void UInteractor::InitiateInteraction()
 {
-	if (FocusedInteractable)
+	UInteractable* FocusedInteractable = GetFocusedInteractable();
+	if (!FocusedInteractable || IsHolding())
 	{
-		FocusedInteractable->StartInteraction();
+		return;
+	}
+
+	//Hold interactables that can't be grabbed(no simulating body) still get the interaction, so Blueprint can handle them
+	if (FocusedInteractable->GetInteractionType() == Hold)
+	{
+		FVector ViewpointLocation;
+		FRotator ViewpointRotation;
+		OwningPlayerController->GetPlayerViewPoint(OUT ViewpointLocation, OUT ViewpointRotation);
+		BeginHold(FocusedHandle, FocusedInteractable, ViewpointLocation, ViewpointRotation);
 	}
 
-	//UE_LOG(LogTemp, Error, TEXT("PICKED UP"));
+	if (GetNetMode() == NM_Client)
+	{
+		PredictInteraction(FocusedInteractable);
+	}
+	else
+	{
+		FocusedInteractable->StartInteraction();
+	}
 }
 
 void UInteractor::TerminateInteraction()
 {
-	if (FocusedInteractable)
+	//A held interactable is released even if the focus moved on to another one in the meantime
+	if (IsHolding())
+	{
+		EndHold();
+		return;
+	}
+
+	if (UInteractable* FocusedInteractable = GetFocusedInteractable())
 	{
-		FocusedInteractable->EndInteraction();
+		EndInteractionWith(FocusedInteractable);
 	}
 }
 
-float UInteractor::GetDistanceToViewportCentre(FVector EvaluatedLocation)
+void UInteractor::EndInteractionWith(UInteractable* Interactable)
 {
-	//Converting the given world position to screen position
-	
-	FVector2D ActorScreenLocation;
-	OwningPlayerController->ProjectWorldLocationToScreen(EvaluatedLocation, OUT ActorScreenLocation, false);
+	Interactable->EndInteraction();
+	if (GetNetMode() == NM_Client)
+	{
+		FInteractionRequest Request;
+		Request.Interactable = Interactable;
+		Request.ClientTime = GetServerTime();
+		Request.bIsStart = false;
+		ServerInteract(Request);
+	}
+}
+
+void UInteractor::PredictInteraction(UInteractable* Interactable)
+{
+	FPendingInteraction& Pending = PendingInteractions.AddDefaulted_GetRef();
+	Pending.PredictionId = NextPredictionId;
+	Pending.Interactable = Interactable;
+	NextPredictionId = (NextPredictionId + 1) & 0x7F;
+
+	FInteractionRequest Request;
+	Request.Interactable = Interactable;
+	Request.ClientTime = GetServerTime();
+	Request.PredictionId = Pending.PredictionId;
+
+	//Whatever the interaction changes(e.g. from Blueprint) records its state into the pending interaction before it changes
+	FInteractionWindow Window;
+	Window.RollbackState = &Pending.RollbackState;
+	Window.MotionStartTime = Request.ClientTime;
+	InteractableRegistry->SetInteractionWindow(&Window);
+	Interactable->StartInteraction();
+	InteractableRegistry->SetInteractionWindow(nullptr);
+
+	ServerInteract(Request);
+}
 
-	//Getting the size of the players viewport and finding it's middle
-	int32 ViewportSizeX, ViewportSizeY;
-	OwningPlayerController->GetViewportSize(OUT ViewportSizeX, ViewportSizeY);
-	FVector2D ViewportSize(ViewportSizeX, ViewportSizeY);
-	FVector2D MiddleOfViewport(FVector2D(ViewportSize.X / 2, ViewportSize.Y / 2));
-	
-	//Checking if  the viewport size changed since this function was last performed; if it did, a new value will be calculated for the CachedViewportScale member variable.
-	UpdateViewportScale(ViewportSizeX);
+int32 UInteractor::FindPendingInteraction(uint8 PredictionId) const
+{
+	return PendingInteractions.IndexOfByPredicate([PredictionId](const FPendingInteraction& Pending) { return Pending.PredictionId == PredictionId; });
+}
 
-	//Measuring the distance between the middle of the screen and the given screen position
-	//The resulting vector magnitude is scaled by the Cached Viewport Scale variable to make the distance consistent regardless of the screen resolution
-	return CachedViewportScale * (ActorScreenLocation - MiddleOfViewport).SizeSquared();
+float UInteractor::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
 }
 
-void UInteractor::SetFocusedInteractable(UInteractable* InteractableToFocus)
+bool UInteractor::IsInteractionValid(UInteractable* Interactable, float ClientTime) const
 {
-	//If an interactable is already focused but it isn't the one that was passed into this function, it is informed that it is losing it's focus
-	if (bIsAnInteractableFocused && (FocusedInteractable != InteractableToFocus))
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	AController* OwnerController = Pawn ? Pawn->GetController() : nullptr;
+	if (!Interactable || !OwnerController || Interactable->GetWorld() != GetWorld() || !Interactable->GetIfInteractableIsActive())
 	{
-		FocusedInteractable->SetIsFocused(false);
+		return false;
 	}
-	
-	//The member variable that defines which interactable is currently focus is set to the value that was just passed in, even if it was null
-	FocusedInteractable = InteractableToFocus;
 
-	//If the value passed in wasn't null, the interactable it pointed to is informed of its focused status and the distance.
-	//The bool that tells if an interactable is currently focused is set to false if a null pointer was passed in and to true if a valid pointer was passed in.
-	if (FocusedInteractable)
+	//The pawn kept moving while the request travelled, so the range grows by how far it could have got in that time
+	FVector ViewpointLocation;
+	FRotator ViewpointRotation;
+	OwnerController->GetPlayerViewPoint(OUT ViewpointLocation, OUT ViewpointRotation);
+	const float Latency = FMath::Clamp(GetServerTime() - ClientTime, 0.f, MaxPredictionRewind);
+	const float AllowedRange = Range + PredictionRangeTolerance + Pawn->GetVelocity().Size() * Latency;
+	const FVector TargetLocation = Interactable->GetComponentLocation();
+	if (FVector::DistSquared(ViewpointLocation, TargetLocation) > FMath::Square(AllowedRange))
 	{
-		FocusedInteractable->SetIsFocused(true);
-		bIsAnInteractableFocused = true;
+		return false;
 	}
-	else
+
+	//Traced with the same rules as the client's line of sight; the interactable's own actor doesn't block it
+	FHitResult Hit;
+	if (!GetWorld()->LineTraceSingleByObjectType(OUT Hit, ViewpointLocation, TargetLocation, FCollisionObjectQueryParams(ECollisionChannel::ECC_WorldStatic), LineOfSightQueryParams))
 	{
-		bIsAnInteractableFocused = false;
+		return true;
 	}
-	
+	return Hit.GetActor() == Interactable->GetOwner();
 }
 
-void UInteractor::EvaluateInteractables(TArray<UInteractable*>InteractablePool, FVector& ViewpointLocation)
+bool UInteractor::ServerInteract_Validate(const FInteractionRequest& Request)
 {
-	//Declare and initialise the variable that temporary stores the interactable component that will be focused
-	UInteractable* FocusCandidate = nullptr;
+	return !FMath::IsNaN(Request.ClientTime);
+}
 
-	//Declare an array for interactables that are are both in range and traceable
-	TArray<UInteractable*> InteractablesToMark;
+void UInteractor::ServerInteract_Implementation(const FInteractionRequest& Request)
+{
+	UInteractable* Interactable = Request.Interactable;
+	if (!Request.bIsStart)
+	{
+		//The end of a rejected interaction is ignored
+		if (Interactable && Interactable == ServerInteractable)
+		{
+			ServerInteractable = nullptr;
+			Interactable->EndInteraction();
+		}
+		return;
+	}
 
-	//Declre a float that will store the currently smallest(in terms of 2D screen space) distance to valid interactable for the duration of the evaluation process
-	float CandidateScreenDistance = LowestScreenDistance;
-	
-	//Iterate through all of the interactables passed into the function
-	for (UInteractable* IteratedInteractable :InteractablePool)
+	if (!IsInteractionValid(Interactable, Request.ClientTime))
 	{
-		//Skipping inactive interactables altogether
-		if (!IteratedInteractable->GetIfInteractableIsActive()) {continue;}
-		
-		//A trace is performed from between the given viewpoint location and the currently iterated interactable. If it can't be traced it isn't evaluated further.
-		bool bCanBeTraced = CheckIfInteractrableCanBeTraced(IteratedInteractable, ViewpointLocation);
-		if (bCanBeTraced)
+		ClientRejectInteraction(Request.PredictionId);
+		return;
+	}
+
+	const float ServerTime = GetServerTime();
+	FInteractionWindow Window;
+	Window.MotionStartTime = FMath::Clamp(Request.ClientTime, ServerTime - MaxPredictionRewind, ServerTime);
+	if (InteractableRegistry)
+	{
+		InteractableRegistry->SetInteractionWindow(&Window);
+	}
+	Interactable->StartInteraction();
+	if (InteractableRegistry)
+	{
+		InteractableRegistry->SetInteractionWindow(nullptr);
+	}
+	ServerInteractable = Interactable;
+	ClientConfirmInteraction(Request.PredictionId);
+}
+
+void UInteractor::ClientConfirmInteraction_Implementation(uint8 PredictionId)
+{
+	const int32 Index = FindPendingInteraction(PredictionId);
+	if (Index != INDEX_NONE)
+	{
+		PendingInteractions.RemoveAt(Index);
+	}
+}
+
+void UInteractor::ClientRejectInteraction_Implementation(uint8 PredictionId)
+{
+	const int32 Index = FindPendingInteraction(PredictionId);
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	//A rejected hold is dropped; the server ignores the end it sends
+	UInteractable* RejectedInteractable = PendingInteractions[Index].Interactable.Get();
+	if (IsHolding() && RejectedInteractable && InteractableRegistry->Resolve(HeldHandle) == RejectedInteractable)
+	{
+		EndHold();
+	}
+
+	if (UCheckpointSubsystem* CheckpointSubsystem = GetWorld()->GetSubsystem<UCheckpointSubsystem>())
+	{
+		CheckpointSubsystem->RestoreRecords(PendingInteractions[Index].RollbackState);
+	}
+	UE_LOG(LogTemp, Log, TEXT("Interaction with %s was rejected by the server and rolled back."), *GetNameSafe(RejectedInteractable));
+	PendingInteractions.RemoveAt(Index);
+}
+
+bool UInteractor::BeginHold(const FInteractableHandle& Handle, UInteractable* Interactable, const FVector& ViewpointLocation, const FRotator& ViewpointRotation)
+{
+	//Props taken out of the simulation because nobody was near are brought back before anything checks them
+	UPrimitiveComponent* Primitive = Interactable->GetOwningPrimitive();
+	if (UPhysicsPropSleepSubsystem* SleepSubsystem = GetWorld()->GetSubsystem<UPhysicsPropSleepSubsystem>())
+	{
+		SleepSubsystem->WakeBody(Primitive);
+	}
+
+	//Clients keep replicated props kinematic until they hold them, so those count as grabbable too
+	UPhysicsPropComponent* Prop = Primitive ? Primitive->GetOwner()->FindComponentByClass<UPhysicsPropComponent>() : nullptr;
+	if (!PhysicsHandle || !Primitive || (!Primitive->IsSimulatingPhysics() && !(Prop && Prop->GetBody() == Primitive)))
+	{
+		return false;
+	}
+
+	HeldProp = Prop;
+	if (HeldProp)
+	{
+		HeldProp->BeginLocalHold();
+		if (GetNetMode() == NM_Client)
+		{
+			ServerSetHeldProp(HeldProp, true, HeldProp->CaptureState());
+			LastHeldPropSendTime = GetWorld()->GetTimeSeconds();
+		}
+		else
 		{
-			//If the interactable passed the tracing test, it is added to the array of interactables that will be marked
-			InteractablesToMark.AddUnique(IteratedInteractable);
+			HeldProp->SetHolder(this);
+		}
+	}
 
-			//If distance between the given location and the interactable fits inside the desired Range, it is evaluated further as a candidate for focusing
-			if ((ViewpointLocation - IteratedInteractable->GetComponentLocation()).SizeSquared() <= RangeSquared)
-			{
-				//Checking how far is the evaluated component from the centre of the players' screen
-				float ScreenDistance = GetDistanceToViewportCentre(IteratedInteractable->GetComponentLocation());
-
-				//If the object is within the predefined range, and closer to the centre than other actors tested so far, it is set as the current best candidate for getting focus
-				if (ScreenDistance <= ScreenRangeSquared && (!FocusCandidate || !FocusedInteractable ||
-					ScreenDistance < CandidateScreenDistance))
-				{
-					//The iterated interactable is set as a candidate for focusing and the 2D distance to it is set as current best.
-					//Note that these variables might be overriden several times during a single evaluation
-					CandidateScreenDistance = ScreenDistance;
-					FocusCandidate = IteratedInteractable;
-				}
-			}
+	//The object is held where it was grabbed, relative to the view; only the yaw of the view turns it, so looking up and down doesn't roll it around
+	const FVector GrabLocation = Primitive->GetComponentLocation();
+	const FQuat ViewYaw = FRotator(0.f, ViewpointRotation.Yaw, 0.f).Quaternion();
+	HoldDistance = FMath::Clamp(FVector::Dist(ViewpointLocation, GrabLocation), MinHoldDistance, FMath::Max(Range, MinHoldDistance));
+	HoldRelativeRotation = ViewYaw.Inverse() * Primitive->GetComponentQuat();
+	PhysicsHandle->GrabComponentAtLocationWithRotation(Primitive, NAME_None, GrabLocation, Primitive->GetComponentRotation());
 
+	if (FBodyInstance* BodyInstance = Primitive->GetBodyInstance())
+	{
+		bHeldBodyUsedCCD = BodyInstance->bUseCCD;
+		if (bUseCCDWhileHeld && !bHeldBodyUsedCCD)
+		{
+			BodyInstance->SetUseCCD(true);
 		}
+	}
 
+	bIsHolding = true;
+	HeldHandle = Handle;
+	HeldPrimitive = Primitive;
+	HoldCurrentTarget = GetHoldTarget(ViewpointLocation, ViewpointRotation);
+	HoldPreviousTarget = HoldCurrentTarget;
+	HoldFrameDeltaTime = 0.f;
+	HoldSubstepTime = 0.f;
+	return true;
+}
+
+void UInteractor::ReleaseHold()
+{
+	if (IsHolding())
+	{
+		EndHold();
+	}
+	else if (GetNetMode() != NM_Client)
+	{
+		ClientReleaseHold();
 	}
+}
 
-	//The marked interactables are updated; the interactables that are stored as marked inside the appropriate member variable but won't be passed in into the function below will be unmarked
-	RefreshMarkedInteractables(InteractablesToMark);
+void UInteractor::ClientReleaseHold_Implementation()
+{
+	EndHold();
+}
 
-	//If a viable candidate was chosen inside the for loop, it will be set as the new focused object. If there wasn't, the focused object is set to none
-	if (FocusCandidate)
+void UInteractor::EndHold()
+{
+	if (!IsHolding())
 	{
-		SetFocusedInteractable(FocusCandidate);
-		LowestScreenDistance = CandidateScreenDistance;
+		return;
 	}
-	else
+
+	if (PhysicsHandle)
+	{
+		PhysicsHandle->ReleaseComponent();
+	}
+	FBodyInstance* BodyInstance = HeldPrimitive.IsValid() ? HeldPrimitive->GetBodyInstance() : nullptr;
+	if (BodyInstance && bUseCCDWhileHeld && !bHeldBodyUsedCCD)
 	{
-		SetFocusedInteractable(nullptr);
+		BodyInstance->SetUseCCD(false);
 	}
+	bIsHolding = false;
+	HeldPrimitive = nullptr;
 
+	//The final state carries the velocity the prop was thrown with
+	if (HeldProp)
+	{
+		const FPhysicsPropState FinalState = HeldProp->CaptureState();
+		HeldProp->EndLocalHold();
+		if (GetNetMode() == NM_Client)
+		{
+			ServerSetHeldProp(HeldProp, false, FinalState);
+		}
+		else
+		{
+			HeldProp->SetHolder(nullptr);
+		}
+		HeldProp = nullptr;
+	}
+
+	//The interactable is told even if it's no longer focused
+	if (UInteractable* HeldInteractable = InteractableRegistry ? InteractableRegistry->Resolve(HeldHandle) : nullptr)
+	{
+		EndInteractionWith(HeldInteractable);
+	}
+	HeldHandle = FInteractableHandle();
 }
 
-void UInteractor::RefreshMarkedInteractables(TArray<UInteractable*>& InteractablesToMark)
+void UInteractor::UpdateHold(float DeltaTime, const FVector& ViewpointLocation, const FRotator& ViewpointRotation)
 {
+	UInteractable* HeldInteractable = InteractableRegistry ? InteractableRegistry->Resolve(HeldHandle) : nullptr;
+	if (!HeldInteractable || !HeldPrimitive.IsValid() || !HeldInteractable->GetIfInteractableIsActive() || !HeldPrimitive->IsSimulatingPhysics())
+	{
+		EndHold();
+		return;
+	}
 
-	//An internal copy of the member variable is made to prevent modyfing the array while it is being iterated on or modified
-	TArray<UInteractable*> PreviouslyMarkedInteractables = MarkedInteractables;
-	
-	//Each element that was previously marked but wasn't passed in to this function is unmarked and removec from the member variable
-	for (UInteractable* IteratedInteractable : PreviouslyMarkedInteractables)
+	//The held interactable keeps being traced with high priority whether it's focused or not; once the hysteresis settled on a lost line of sight it's dropped
+	FSlotState& SlotState = GetSlotState(HeldHandle);
+	RequestLineOfSightIfNeeded(HeldHandle, SlotState, ViewpointLocation, HeldInteractable->GetComponentLocation());
+	const bool bLostLineOfSight = SlotState.bHasLineOfSightResult && !SlotState.bIsInLineOfSight;
+	const bool bLostRange = FVector::DistSquared(ViewpointLocation, HeldPrimitive->GetComponentLocation()) > FMath::Square(Range + HoldBreakDistance);
+	const bool bIsStuck = FVector::DistSquared(HoldCurrentTarget.GetLocation(), HeldPrimitive->GetComponentLocation()) > FMath::Square(HoldBreakDistance);
+	if (bLostLineOfSight || bLostRange || bIsStuck)
 	{
-		if (!InteractablesToMark.IsValidIndex(0) || !InteractablesToMark.Contains(IteratedInteractable))
+		EndHold();
+		return;
+	}
+
+	//The substeps of the coming physics step move the target from the last sample to this one
+	HoldPreviousTarget = HoldCurrentTarget;
+	HoldCurrentTarget = GetHoldTarget(ViewpointLocation, ViewpointRotation);
+	HoldFrameDeltaTime = DeltaTime;
+	HoldSubstepTime = 0.f;
+
+	//Custom physics only runs for the step it was added for, so it's added again every tick
+	if (FBodyInstance* BodyInstance = HeldPrimitive->GetBodyInstance())
+	{
+		BodyInstance->AddCustomPhysics(HoldPhysicsDelegate);
+	}
+
+	if (HeldProp && GetNetMode() == NM_Client && GetWorld()->GetTimeSeconds() - LastHeldPropSendTime >= HeldPropSendInterval)
+	{
+		ServerUpdateHeldProp(HeldProp, HeldProp->CaptureState());
+		LastHeldPropSendTime = GetWorld()->GetTimeSeconds();
+	}
+}
+
+bool UInteractor::ServerSetHeldProp_Validate(UPhysicsPropComponent* Prop, bool bIsHeld, const FPhysicsPropState& State)
+{
+	return !State.Location.ContainsNaN() && !State.LinearVelocity.ContainsNaN();
+}
+
+void UInteractor::ServerSetHeldProp_Implementation(UPhysicsPropComponent* Prop, bool bIsHeld, const FPhysicsPropState& State)
+{
+	//Another player already holding the prop keeps it
+	if (!Prop || (Prop->GetHolder() && Prop->GetHolder() != this) || (!bIsHeld && !Prop->GetHolder()))
+	{
+		return;
+	}
+
+	//The hold is only taken over if the player could have grabbed the prop from where the server sees them; otherwise the client is told to drop it
+	if (bIsHeld && !Prop->GetHolder())
+	{
+		UInteractable* PropInteractable = FindPropInteractable(Prop);
+		if (!PropInteractable || PropInteractable->GetInteractionType() != Hold || !IsInteractionValid(PropInteractable, State.ServerTime))
 		{
-			IteratedInteractable->UnmarkInteractable();
-			MarkedInteractables.Remove(IteratedInteractable);
+			ClientReleaseHold();
+			return;
 		}
+		ServerHeldPropUpdateTime = GetWorld()->GetTimeSeconds();
 	}
 
-	//The interactables in the array that was passed in are all set to marked and added to the appropriate member variable(if they weren't already in it
-	for (UInteractable* IteratedInteractable : InteractablesToMark)
+	FPhysicsPropState ConstrainedState = State;
+	const bool bIsInReach = ConstrainHeldPropState(Prop, ConstrainedState);
+	Prop->SetHolder(bIsHeld && bIsInReach ? this : nullptr);
+	if (bIsInReach)
+	{
+		Prop->ApplyHolderState(ConstrainedState);
+	}
+	else if (bIsHeld)
 	{
-		IteratedInteractable->MarkInteractable();
-		MarkedInteractables.AddUnique(IteratedInteractable);
+		ClientReleaseHold();
 	}
 }
 
-bool UInteractor::CheckIfInteractrableCanBeTraced(UInteractable* EvaluatedInteractable, FVector& ViewpointLocation) const
+bool UInteractor::ServerUpdateHeldProp_Validate(UPhysicsPropComponent* Prop, const FPhysicsPropState& State)
 {
-	//Declaring variables needed for the trace
-	FVector LineTraceEnd = EvaluatedInteractable->GetComponentLocation();
-	FCollisionQueryParams TraceParams(FName(TEXT("")), false, GetOwner());
-	FHitResult HitResult;
-	
-	//Performing the trace
-	GetWorld()->LineTraceSingleByObjectType
-	(
-		OUT HitResult,
-		ViewpointLocation,
-		LineTraceEnd,
-		FCollisionObjectQueryParams(ECollisionChannel::ECC_WorldStatic),
-		TraceParams
-	);
+	return !State.Location.ContainsNaN() && !State.LinearVelocity.ContainsNaN();
+}
+
+void UInteractor::ServerUpdateHeldProp_Implementation(UPhysicsPropComponent* Prop, const FPhysicsPropState& State)
+{
+	if (!Prop || Prop->GetHolder() != this)
+	{
+		return;
+	}
 
-	//Returning true if trace didn't hit anything or if it hit the actor that owns the interactable that was passed it
-	return (!HitResult.bBlockingHit || (HitResult.GetActor() && HitResult.GetActor() == EvaluatedInteractable->GetOwner()));
+	//A state out of the player's reach ends the hold on both machines
+	FPhysicsPropState ConstrainedState = State;
+	if (!ConstrainHeldPropState(Prop, ConstrainedState))
+	{
+		Prop->SetHolder(nullptr);
+		ClientReleaseHold();
+		return;
+	}
+	Prop->ApplyHolderState(ConstrainedState);
 }
 
-void UInteractor::OnOverlapBegin(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+UInteractable* UInteractor::FindPropInteractable(UPhysicsPropComponent* Prop) const
 {
-	//If the actor that entered the collision box has an interactable component, the component is added to the appropriate member variable array
-	UInteractable* NewInteractable = OtherActor->FindComponentByClass<UInteractable>();
-	if (OtherActor && NewInteractable)
+	TArray<UInteractable*> Interactables;
+	Prop->GetOwner()->GetComponents<UInteractable>(OUT Interactables);
+	for (UInteractable* Interactable : Interactables)
 	{
-		OverlappedInteractables.AddUnique(NewInteractable);
+		if (Interactable->GetOwningPrimitive() == Prop->GetBody())
+		{
+			return Interactable;
+		}
 	}
-	return;
+	return nullptr;
 }
 
-void UInteractor::OnEndOverlap(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+bool UInteractor::ConstrainHeldPropState(UPhysicsPropComponent* Prop, FPhysicsPropState& InOutState)
 {
-	//If the actor that left the collision box has an interactable component, the component is removed from the appropriate member variable array
-	UInteractable* ExInteractable = OtherActor->FindComponentByClass<UInteractable>();
-	if (OtherActor && ExInteractable)
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	AController* OwnerController = Pawn ? Pawn->GetController() : nullptr;
+	UPrimitiveComponent* Body = Prop->GetBody();
+	if (!OwnerController || !Body)
 	{
-		ExInteractable->UnmarkInteractable();
-		OverlappedInteractables.Remove(ExInteractable);
+		return false;
+	}
+
+	//Held props are never further than the hold distance plus the break distance from the viewpoint, widened by how far the pawn could have moved since the state was sent
+	FVector ViewpointLocation;
+	FRotator ViewpointRotation;
+	OwnerController->GetPlayerViewPoint(OUT ViewpointLocation, OUT ViewpointRotation);
+	const float Reach = FMath::Max(Range, MinHoldDistance) + HoldBreakDistance + PredictionRangeTolerance + Pawn->GetVelocity().Size() * MaxPredictionRewind;
+	if (FVector::DistSquared(ViewpointLocation, InOutState.Location) > FMath::Square(Reach))
+	{
+		return false;
+	}
+
+	//The prop can't move faster than a held body is allowed to between two accepted states
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	const float MaxStep = MaxHeldLinearSpeed * (CurrentTime - ServerHeldPropUpdateTime) + PredictionRangeTolerance;
+	const FVector CurrentLocation = Body->GetComponentLocation();
+	InOutState.Location = CurrentLocation + (InOutState.Location - CurrentLocation).GetClampedToMaxSize(MaxStep);
+	InOutState.LinearVelocity = InOutState.LinearVelocity.GetClampedToMaxSize(MaxHeldLinearSpeed);
+	InOutState.AngularVelocity = InOutState.AngularVelocity.GetClampedToMaxSize(MaxHeldAngularSpeed);
+	ServerHeldPropUpdateTime = CurrentTime;
+	return true;
+}
+
+FTransform UInteractor::GetHoldTarget(const FVector& ViewpointLocation, const FRotator& ViewpointRotation) const
+{
+	const FQuat ViewYaw = FRotator(0.f, ViewpointRotation.Yaw, 0.f).Quaternion();
+	return FTransform(ViewYaw * HoldRelativeRotation, ViewpointLocation + ViewpointRotation.Vector() * HoldDistance);
+}
+
+void UInteractor::OnHoldSubstep(float DeltaTime, FBodyInstance* BodyInstance)
+{
+	if (!PhysicsHandle || !BodyInstance)
+	{
+		return;
+	}
+
+	HoldSubstepTime += DeltaTime;
+	const float Alpha = HoldFrameDeltaTime > 0.f ? FMath::Clamp(HoldSubstepTime / HoldFrameDeltaTime, 0.f, 1.f) : 1.f;
+	FTransform Target;
+	Target.Blend(HoldPreviousTarget, HoldCurrentTarget, Alpha);
+	PhysicsHandle->DriveTarget(Target);
+
+	//The velocities are clamped before the substep is simulated; the handle can pull hard when the target moves fast
+	const FVector LinearVelocity = BodyInstance->GetUnrealWorldVelocity_AssumesLocked();
+	if (LinearVelocity.SizeSquared() > FMath::Square(MaxHeldLinearSpeed))
+	{
+		BodyInstance->SetLinearVelocity(LinearVelocity.GetClampedToMaxSize(MaxHeldLinearSpeed), false);
+	}
+	const float MaxAngularSpeed = FMath::DegreesToRadians(MaxHeldAngularSpeed);
+	const FVector AngularVelocity = BodyInstance->GetUnrealWorldAngularVelocityInRadians_AssumesLocked();
+	if (AngularVelocity.SizeSquared() > FMath::Square(MaxAngularSpeed))
+	{
+		BodyInstance->SetAngularVelocityInRadians(AngularVelocity.GetClampedToMaxSize(MaxAngularSpeed), false);
+	}
+}
+
+UInteractable* UInteractor::GetFocusedInteractable() const
+{
+	return InteractableRegistry ? InteractableRegistry->Resolve(FocusedHandle) : nullptr;
+}
+
+void UInteractor::SetFocusedInteractable(FInteractableHandle HandleToFocus)
+{
+	//Nothing changes if the same interactable stays focused, so nothing is sent to it either
+	if (HandleToFocus == FocusedHandle)
+	{
+		return;
+	}
+
+	//If an interactable is already focused but it isn't the one that was passed into this function, it is informed that it is losing it's focus(unless it already left the world)
+	if (UInteractable* PreviouslyFocusedInteractable = GetFocusedInteractable())
+	{
+		PreviouslyFocusedInteractable->SetIsFocused(false);
+	}
+
+	//The member variable that defines which interactable is currently focus is set to the value that was just passed in, even if it was empty
+	FocusedHandle = HandleToFocus;
+
+	//If the handle passed in wasn't empty, the interactable it points to is informed of its focused status.
+	//The bool that tells if an interactable is currently focused is set to false if an empty handle was passed in and to true if a valid one was passed in.
+	if (UInteractable* FocusedInteractable = GetFocusedInteractable())
+	{
+		FocusedInteractable->SetIsFocused(true);
+		bIsAnInteractableFocused = true;
+	}
+	else
+	{
+		FocusedHandle = FInteractableHandle();
+		bIsAnInteractableFocused = false;
+	}
+}
+
+void UInteractor::EvaluateInteractables(const TArray<FInteractableHandle>& InteractablePool, const FInteractionFocusView& FocusView, bool bIncludeFarMarks)
+{
+	//Every evaluation gets a new number that stamps the slots it marks
+	EvaluationCounter++;
+	if (SlotStates.Num() < InteractableRegistry->GetSlotCount())
+	{
+		SlotStates.SetNum(InteractableRegistry->GetSlotCount());
+	}
+	NextMarkedHandles.Reset();
+	FocusScorer.Reset();
+	ScoredHandles.Reset();
+	ScoredMarkIndices.Reset();
+
+	//Iterate through all of the interactables passed into the function
+	for (const FInteractableHandle& IteratedHandle : InteractablePool)
+	{
+		//Skipping inactive interactables altogether
+		UInteractable* IteratedInteractable = InteractableRegistry->Resolve(IteratedHandle);
+		if (!IteratedInteractable || !IteratedInteractable->GetIfInteractableIsActive()) {continue;}
+
+		//The line of sight between the given viewpoint location and the currently iterated interactable is requested if it needs tracing, and the last known result is used for now.
+		//If it can't be traced it isn't evaluated further.
+		FSlotState& SlotState = GetSlotState(IteratedHandle);
+		RequestLineOfSightIfNeeded(IteratedHandle, SlotState, FocusView.ViewLocation, IteratedInteractable->GetComponentLocation());
+		if (!SlotState.bIsInLineOfSight) {continue;}
+
+		//The interactable passed the tracing test, so it's handed to the scorer
+		FocusScorer.AddCandidate(IteratedInteractable->GetComponentLocation());
+		ScoredHandles.Add(IteratedHandle);
+	}
+
+	//All the candidates are projected in one go; the closest one to the centre of the screen within range is the focus candidate
+	const int32 FocusIndex = FocusScorer.Score(FocusView, OUT ScoredMarkIndices);
+
+	//Scored interactables within the marking range belong to the marked set; they are only told so if they weren't in the set already
+	for (int32 MarkIndex : ScoredMarkIndices)
+	{
+		const FInteractableHandle& MarkedHandle = ScoredHandles[MarkIndex];
+		const bool bWasMarked = WasMarkedByPreviousEvaluation(MarkedHandle);
+		SlotStates[MarkedHandle.Slot].MarkedEvaluation = EvaluationCounter;
+		NextMarkedHandles.Add(MarkedHandle);
+		if (!bWasMarked)
+		{
+			if (UInteractable* MarkedInteractable = InteractableRegistry->Resolve(MarkedHandle))
+			{
+				MarkedInteractable->MarkInteractable();
+			}
+		}
+	}
+
+	//The far marks weren't queried this time, so they stay as the last full evaluation left them
+	if (!bIncludeFarMarks)
+	{
+		KeepFarMarks(FocusView.ViewLocation);
+	}
+
+	//Everything marked by the previous evaluation that wasn't stamped by this one is unmarked, then the new set replaces the old one
+	UnmarkDroppedInteractables();
+	Swap(MarkedHandles, NextMarkedHandles);
+
+	//If a viable candidate was found, it will be set as the new focused object. If there wasn't, the focused object is set to none
+	SetFocusedInteractable(FocusIndex != INDEX_NONE ? ScoredHandles[FocusIndex] : FInteractableHandle());
+}
+
+void UInteractor::KeepFarMarks(const FVector& ViewpointLocation)
+{
+	for (const FInteractableHandle& MarkedHandle : MarkedHandles)
+	{
+		FSlotState& SlotState = SlotStates[MarkedHandle.Slot];
+		if (SlotState.Generation != MarkedHandle.Generation || SlotState.MarkedEvaluation == EvaluationCounter) { continue; }
+
+		//Interactables within the grab range were part of the query, so if they weren't stamped they really dropped out
+		UInteractable* MarkedInteractable = InteractableRegistry->Resolve(MarkedHandle);
+		if (!MarkedInteractable || !MarkedInteractable->GetIfInteractableIsActive()) { continue; }
+		if (FVector::DistSquared(ViewpointLocation, MarkedInteractable->GetComponentLocation()) <= RangeSquared) { continue; }
+
+		SlotState.MarkedEvaluation = EvaluationCounter;
+		NextMarkedHandles.Add(MarkedHandle);
+	}
+}
+
+bool UInteractor::WasMarkedByPreviousEvaluation(const FInteractableHandle& Handle) const
+{
+	//Slots that were never marked keep an evaluation of 0, which must not be taken for the first evaluation's predecessor
+	const FSlotState& SlotState = SlotStates[Handle.Slot];
+	return SlotState.Generation == Handle.Generation && SlotState.MarkedEvaluation != 0 && SlotState.MarkedEvaluation == EvaluationCounter - 1;
+}
+
+void UInteractor::UnmarkDroppedInteractables()
+{
+	for (const FInteractableHandle& MarkedHandle : MarkedHandles)
+	{
+		const FSlotState& SlotState = SlotStates[MarkedHandle.Slot];
+		if (SlotState.Generation == MarkedHandle.Generation && SlotState.MarkedEvaluation == EvaluationCounter) { continue; }
+
+		//Interactables that left the world in the meantime resolve to nothing and need no message
+		if (UInteractable* DroppedInteractable = InteractableRegistry->Resolve(MarkedHandle))
+		{
+			DroppedInteractable->UnmarkInteractable();
+		}
+	}
+}
+
+UInteractor::FSlotState& UInteractor::GetSlotState(const FInteractableHandle& Handle)
+{
+	//A slot reused by another interactable starts over, including its line of sight; a trace still in flight for the previous one is ignored once it arrives
+	FSlotState& SlotState = SlotStates[Handle.Slot];
+	if (SlotState.Generation != Handle.Generation)
+	{
+		SlotState = FSlotState();
+		SlotState.Generation = Handle.Generation;
+	}
+	return SlotState;
+}
+
+void UInteractor::RequestLineOfSightIfNeeded(const FInteractableHandle& Handle, FSlotState& SlotState, const FVector& ViewpointLocation, const FVector& TargetLocation)
+{
+	//Only one trace per slot is in flight at a time
+	if (!TraceScheduler || SlotState.PendingRequest != 0)
+	{
+		return;
+	}
+
+	//Slots whose last result disagreed with their state keep being traced until the hysteresis settles them; the others only when something moved or the result got old
+	const bool bNeedsTrace = !SlotState.bHasLineOfSightResult
+		|| SlotState.ContradictingResults > 0
+		|| GetWorld()->GetTimeSeconds() - SlotState.TracedTime > LineOfSightMaxAge
+		|| FVector::DistSquared(ViewpointLocation, SlotState.TracedStart) > LineOfSightRetraceDistanceSquared
+		|| FVector::DistSquared(TargetLocation, SlotState.TracedEnd) > LineOfSightRetraceDistanceSquared;
+	if (!bNeedsTrace)
+	{
+		return;
+	}
+
+	SlotState.TracedStart = ViewpointLocation;
+	SlotState.TracedEnd = TargetLocation;
+	SlotState.TracedTime = GetWorld()->GetTimeSeconds();
+
+	//The focused and the held interactable must not lose their state late, while far marks can wait the longest
+	FScheduledTraceRequest Request;
+	Request.Start = ViewpointLocation;
+	Request.End = TargetLocation;
+	Request.ObjectQueryParams = FCollisionObjectQueryParams(ECollisionChannel::ECC_WorldStatic);
+	Request.QueryParams = LineOfSightQueryParams;
+	Request.Priority = (Handle == FocusedHandle || Handle == HeldHandle) ? TracePriority_High : (FVector::DistSquared(ViewpointLocation, TargetLocation) <= RangeSquared ? TracePriority_Normal : TracePriority_Low);
+	Request.Requester = this;
+	Request.UserData = (uint32)Handle.Slot;
+	Request.Delegate = LineOfSightDelegate;
+	SlotState.PendingRequest = TraceScheduler->SubmitTrace(Request);
+}
+
+void UInteractor::OnLineOfSightTraceDone(const FScheduledTraceResult& Result)
+{
+	//Results for slots that were reset or reused since the request are dropped
+	const int32 Slot = (int32)Result.UserData;
+	if (!SlotStates.IsValidIndex(Slot) || SlotStates[Slot].PendingRequest != Result.RequestId)
+	{
+		return;
+	}
+
+	FSlotState& SlotState = SlotStates[Slot];
+	SlotState.PendingRequest = 0;
+
+	FInteractableHandle Handle;
+	Handle.Slot = Slot;
+	Handle.Generation = SlotState.Generation;
+	UInteractable* TracedInteractable = InteractableRegistry ? InteractableRegistry->Resolve(Handle) : nullptr;
+	if (!TracedInteractable)
+	{
+		return;
+	}
+
+	//The interactable is in line of sight if the trace didn't hit anything or if it hit the actor that owns the interactable
+	const bool bIsInLineOfSight = !Result.bHasBlockingHit || (Result.HitResult.GetActor() && Result.HitResult.GetActor() == TracedInteractable->GetOwner());
+
+	//Anything but a result confirming the current state needs another evaluation, either to use the new state or to trace again
+	bLineOfSightChanged |= !SlotState.bHasLineOfSightResult || bIsInLineOfSight != SlotState.bIsInLineOfSight;
+
+	//The first result is taken as it is; after that the state only flips once enough results in a row disagree with it
+	if (!SlotState.bHasLineOfSightResult)
+	{
+		SlotState.bHasLineOfSightResult = true;
+		SlotState.bIsInLineOfSight = bIsInLineOfSight;
+		SlotState.ContradictingResults = 0;
+	}
+	else if (bIsInLineOfSight != SlotState.bIsInLineOfSight)
+	{
+		SlotState.ContradictingResults++;
+		if (SlotState.ContradictingResults >= LineOfSightHysteresis)
+		{
+			SlotState.bIsInLineOfSight = bIsInLineOfSight;
+			SlotState.ContradictingResults = 0;
+		}
+	}
+	else
+	{
+		SlotState.ContradictingResults = 0;
 	}
-	return;
 }
 
 void UInteractor::UpdateViewportScale(int32 CurrentViewportX)
@@ -4,11 +4,51 @@
 
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "Subsystems/InteractableRegistrySubsystem.h"
+#include "Subsystems/TraceSchedulerSubsystem.h"
+#include "InteractionFocusScorer.h"
+#include "Components/PhysicsPropComponent.h"
+#include "Subsystems/CheckpointSubsystem.h"
 #include "Interactor.generated.h"
 
 class UInteractable;
-class UBoxComponent;
+struct FConvexVolume;
+struct FSceneViewProjectionData;
 class UPhysicsConstraintComponent;
+class UHoldPhysicsHandleComponent;
+
+//An interaction as a client sends it to the server. The interactable goes as its network GUID, the prediction id and the start flag share a single byte
+USTRUCT()
+struct FInteractionRequest
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UInteractable* Interactable = nullptr;
+
+	//The client's estimate of the server world time it applied the interaction at
+	UPROPERTY()
+	float ClientTime = 0.f;
+
+	//Only 7 bits are sent; the ids wrap around long before a client could be waiting for that many answers
+	UPROPERTY()
+	uint8 PredictionId = 0;
+
+	UPROPERTY()
+	bool bIsStart = true;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FInteractionRequest> : public TStructOpsTypeTraitsBase2<FInteractionRequest>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent), Blueprintable)
 class BUILDING_ESCAPE_API UInteractor : public USceneComponent
@@ -22,46 +62,163 @@ public:
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	//Drops whatever the player holds, e.g. before a checkpoint moves the props. On the server a remote player is told to drop it on their machine
+	void ReleaseHold();
+
 private:
 
 	APlayerController * OwningPlayerController = nullptr;
 	UInputComponent* InputComponent = nullptr;
-	UBoxComponent* CollisionMesh = nullptr;
-	UInteractable* FocusedInteractable = nullptr;
-	float LowestScreenDistance;
+	UInteractableRegistrySubsystem* InteractableRegistry = nullptr;
+	FInteractableHandle FocusedHandle;
+	UInteractable* GetFocusedInteractable() const;
 	bool bIsAnInteractableFocused = false;
 
 	void BindInputs();
 
-	//Functions automatically bound to the collision dispatchers of the main testing collider.
-	UFUNCTION()
-	void OnOverlapBegin(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+	//Candidates are the interactables the registry returns for the marking range and the view frustum; the array is reused between ticks
+	TArray<FInteractableHandle> CandidateHandles;
+	//The projection of the local player's view is taken once per tick; both the frustum and the focus scoring are derived from it
+	bool GetViewProjection(FSceneViewProjectionData& OutProjectionData) const;
 
-	UFUNCTION()
-	void OnEndOverlap(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+	//Evaluations only run when something they depend on changed: the viewpoint, the registry revision around the viewpoint or a line of sight result, or when the last one got too old.
+	//Looking at a wall without moving costs nothing but the viewpoint comparison and the revision lookup. Far marks are refreshed at a lower rate than the focus
+	bool ShouldEvaluate(const FVector& ViewpointLocation, const FRotator& ViewpointRotation, uint32 Revision, bool& bOutIncludeFarMarks) const;
+	FVector LastEvaluatedLocation = FVector::ZeroVector;
+	FRotator LastEvaluatedRotation = FRotator::ZeroRotator;
+	uint32 LastEvaluatedRevision = 0;
+	float LastEvaluationTime = 0.f;
+	float LastFullEvaluationTime = 0.f;
+	bool bHasEvaluated = false;
+	//Set when an evaluation skipped the far marks, so they are refreshed once their interval is up even if nothing else changes
+	bool bFarMarksPending = false;
+	//Set by line of sight results that changed a slot or still need confirming
+	bool bLineOfSightChanged = false;
 
-	//Each time a new Interactable enters the testing collider, it is added to the OverlappedInteractables array
-	TArray<UInteractable*> OverlappedInteractables;
-	
-	//Objects in the array are evaluated each tick
-	void EvaluateInteractables(TArray<UInteractable*>InteractablePool, FVector& ViewpointLocation);
-	//The following tests are applied to each object inside the array inside the EvaluateInteractables function
-	float GetDistanceToViewportCentre(FVector EvaluatedLocation);
-	bool CheckIfInteractrableCanBeTraced(UInteractable* EvaluatedInteractable, FVector& ViewpointLocation) const;
-	//The interactable that passes all the test is focused
-	void SetFocusedInteractable(UInteractable* InteractableToFocus);
-	//All the others that are in range and traceable are marked
-	TArray<UInteractable*> MarkedInteractables;
-	void RefreshMarkedInteractables(TArray<UInteractable*>& NewMarkedInteractables);
+	//Objects in the array are evaluated when ShouldEvaluate allows it; without the far marks only the grab range is queried and the far marks are kept as they are
+	void EvaluateInteractables(const TArray<FInteractableHandle>& InteractablePool, const FInteractionFocusView& FocusView, bool bIncludeFarMarks);
+	void KeepFarMarks(const FVector& ViewpointLocation);
+	//Interactables in line of sight are handed to the scorer, which projects them all at once and returns the focus candidate and the ones to mark.
+	//ScoredHandles holds the handle for each scorer index; both are reused between ticks
+	FInteractionFocusScorer FocusScorer;
+	TArray<FInteractableHandle> ScoredHandles;
+	TArray<int32> ScoredMarkIndices;
+	//The interactable that passes all the test is focused; nothing is sent to the interactables if the focus didn't change
+	void SetFocusedInteractable(FInteractableHandle HandleToFocus);
+
+	//All the others that are in range and traceable are marked. Every registry slot remembers the generation it was marked for and the evaluation that marked it last,
+	//so an interactable was marked before exactly when its slot was stamped by the previous evaluation. That turns both set differences into single linear passes.
+	//The slot also keeps the line of sight state of the interactable, which is reset whenever the slot is found holding another generation
+	struct FSlotState
+	{
+		uint32 Generation = 0;
+		uint32 MarkedEvaluation = 0;
+
+		//Id of the trace request in flight for this slot(0 if there is none); its result is only accepted if the id still matches when it arrives
+		uint32 PendingRequest = 0;
+		FVector TracedStart = FVector::ZeroVector;
+		FVector TracedEnd = FVector::ZeroVector;
+		float TracedTime = 0.f;
+		bool bHasLineOfSightResult = false;
+		bool bIsInLineOfSight = false;
+		//Number of results in a row that disagreed with bIsInLineOfSight
+		int32 ContradictingResults = 0;
+	};
+	TArray<FSlotState> SlotStates;
+	uint32 EvaluationCounter = 0;
+	FSlotState& GetSlotState(const FInteractableHandle& Handle);
+
+	//Line of sight is traced asynchronously through the world's trace scheduler, which shares the frame budget with the other systems; results are consumed on a later tick.
+	//The focused interactable is traced with high priority and far marks with low priority. A slot is only traced again once the viewpoint or the interactable moved,
+	//or its last result got too old to be trusted
+	UTraceSchedulerSubsystem* TraceScheduler = nullptr;
+	FScheduledTraceDelegate LineOfSightDelegate;
+	FCollisionQueryParams LineOfSightQueryParams;
+	void RequestLineOfSightIfNeeded(const FInteractableHandle& Handle, FSlotState& SlotState, const FVector& ViewpointLocation, const FVector& TargetLocation);
+	void OnLineOfSightTraceDone(const FScheduledTraceResult& Result);
+	//The next marked set is built in the second array and the two are swapped afterwards, so neither is ever reallocated once it's big enough
+	TArray<FInteractableHandle> MarkedHandles;
+	TArray<FInteractableHandle> NextMarkedHandles;
+	bool WasMarkedByPreviousEvaluation(const FInteractableHandle& Handle) const;
+	void UnmarkDroppedInteractables();
 	
 	//These functions are triggered by player inputs and call functions on the focused objects if there is one
 	void InitiateInteraction();
 	void TerminateInteraction();
+	//Ends are never predicted; a client tells the server, which only ends the interaction it confirmed
+	void EndInteractionWith(UInteractable* Interactable);
+
+	//Clients apply their interactions right away and ask the server to confirm them. Doors and interactables the interaction changes record their previous state
+	//into the pending interaction, so a rejected one can be rolled back; a confirmed one needs no correction, as the server starts the same door motions at the predicted time
+	struct FPendingInteraction
+	{
+		uint8 PredictionId = 0;
+		TWeakObjectPtr<UInteractable> Interactable;
+		FCheckpoint RollbackState;
+	};
+	TArray<FPendingInteraction> PendingInteractions;
+	uint8 NextPredictionId = 0;
+	void PredictInteraction(UInteractable* Interactable);
+	int32 FindPendingInteraction(uint8 PredictionId) const;
+	float GetServerTime() const;
+
+	//Server; the interactable whose start it confirmed last and which hasn't ended yet
+	UPROPERTY()
+	UInteractable* ServerInteractable = nullptr;
+	//The server checks the range and a single line of sight trace against its own state, widened by how far the pawn could have moved while the request travelled
+	bool IsInteractionValid(UInteractable* Interactable, float ClientTime) const;
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerInteract(const FInteractionRequest& Request);
+	UFUNCTION(Client, Reliable)
+	void ClientConfirmInteraction(uint8 PredictionId);
+	UFUNCTION(Client, Reliable)
+	void ClientRejectInteraction(uint8 PredictionId);
+
+	//Hold interactables are grabbed by a physics handle. The game tick only samples where the held object should be; the handle's target is moved
+	//from the custom physics callback of the held body, once per substep, along the way between the last two samples.
+	//Holding ends when the object gets stuck too far from its target, leaves the grab range or loses the line of sight
+	UPROPERTY()
+	UHoldPhysicsHandleComponent* PhysicsHandle = nullptr;
+	FInteractableHandle HeldHandle;
+	//The held body can be destroyed while it's held, so it's only referenced weakly
+	TWeakObjectPtr<UPrimitiveComponent> HeldPrimitive;
+	bool bIsHolding = false;
+	FCalculateCustomPhysics HoldPhysicsDelegate;
+	float HoldDistance = 0.f;
+	FQuat HoldRelativeRotation = FQuat::Identity;
+	FTransform HoldPreviousTarget;
+	FTransform HoldCurrentTarget;
+	float HoldFrameDeltaTime = 0.f;
+	float HoldSubstepTime = 0.f;
+	bool bHeldBodyUsedCCD = false;
+	bool IsHolding() const { return bIsHolding; }
+	bool BeginHold(const FInteractableHandle& Handle, UInteractable* Interactable, const FVector& ViewpointLocation, const FRotator& ViewpointRotation);
+	void EndHold();
+	void UpdateHold(float DeltaTime, const FVector& ViewpointLocation, const FRotator& ViewpointRotation);
+	FTransform GetHoldTarget(const FVector& ViewpointLocation, const FRotator& ViewpointRotation) const;
+	void OnHoldSubstep(float DeltaTime, FBodyInstance* BodyInstance);
+
+	//Held props with a physics prop component are simulated by the holder; a client holder sends its states to the server at a fixed rate
+	UPROPERTY()
+	UPhysicsPropComponent* HeldProp = nullptr;
+	float LastHeldPropSendTime = 0.f;
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetHeldProp(UPhysicsPropComponent* Prop, bool bIsHeld, const FPhysicsPropState& State);
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void ServerUpdateHeldProp(UPhysicsPropComponent* Prop, const FPhysicsPropState& State);
+	UFUNCTION(Client, Reliable)
+	void ClientReleaseHold();
+	//Server; the prop has to be grabbable by this player when the hold starts, and every state it's sent is kept within the player's reach and the held speed limits.
+	//Returns false if the state is out of reach
+	UInteractable* FindPropInteractable(UPhysicsPropComponent* Prop) const;
+	bool ConstrainHeldPropState(UPhysicsPropComponent* Prop, FPhysicsPropState& InOutState);
+	float ServerHeldPropUpdateTime = 0.f;
 
 	// Calculating ViewportScale involves exponentiation, so a cached value will be used as long as the current X dimension is equal to CachedViewportX to avoid performance issues
 	void UpdateViewportScale(int32 CurrentViewportX);
@@ -81,4 +238,65 @@ private:
 	float ScreenRange = 290;
 	float ScreenRangeSquared = 0;
 
+	//Distance the viewpoint or the interactable have to move before the line of sight between them is traced again
+	UPROPERTY(EditAnywhere, DisplayName = "Line of sight retrace distance", Category = "Grabber parameters")
+	float LineOfSightRetraceDistance = 5.f;
+	float LineOfSightRetraceDistanceSquared = 0;
+
+	//Results older than this are traced again even if nothing moved, so doors and props moving in between are noticed
+	UPROPERTY(EditAnywhere, DisplayName = "Line of sight max age", Category = "Grabber parameters")
+	float LineOfSightMaxAge = 0.2f;
+
+	//How many results in a row have to disagree with the current line of sight state before it flips; keeps the focus from flickering on edges of occluders
+	UPROPERTY(EditAnywhere, DisplayName = "Line of sight hysteresis", Category = "Grabber parameters", meta = (ClampMin = 1))
+	int32 LineOfSightHysteresis = 2;
+
+	//The viewpoint has to move further than this to trigger an evaluation
+	UPROPERTY(EditAnywhere, DisplayName = "Evaluation move threshold", Category = "Grabber parameters")
+	float EvaluationMoveThreshold = 2.f;
+
+	//The viewpoint has to turn by more than this, in degrees, to trigger an evaluation
+	UPROPERTY(EditAnywhere, DisplayName = "Evaluation angle threshold", Category = "Grabber parameters")
+	float EvaluationAngleThreshold = 0.5f;
+
+	//Seconds after which an evaluation runs even if nothing changed, so changes nothing reports(like occluders moving in between) are picked up
+	UPROPERTY(EditAnywhere, DisplayName = "Max evaluation staleness", Category = "Grabber parameters")
+	float MaxEvaluationStaleness = 0.5f;
+
+	//Seconds between the evaluations of the interactables beyond the grab range, which can only be marked
+	UPROPERTY(EditAnywhere, DisplayName = "Far mark interval", Category = "Grabber parameters")
+	float FarMarkInterval = 0.2f;
+
+	//Held objects are kept between these distances from the viewpoint
+	UPROPERTY(EditAnywhere, DisplayName = "Min hold distance", Category = "Hold parameters")
+	float MinHoldDistance = 80.f;
+
+	//The object is dropped when it's stuck further than this from where it's held
+	UPROPERTY(EditAnywhere, DisplayName = "Hold break distance", Category = "Hold parameters")
+	float HoldBreakDistance = 60.f;
+
+	//The held body is never faster than these, so it can't be flung through walls or into the player
+	UPROPERTY(EditAnywhere, DisplayName = "Max held linear speed", Category = "Hold parameters")
+	float MaxHeldLinearSpeed = 800.f;
+
+	//In degrees per second
+	UPROPERTY(EditAnywhere, DisplayName = "Max held angular speed", Category = "Hold parameters")
+	float MaxHeldAngularSpeed = 540.f;
+
+	//Seconds between the states a client sends for the prop it holds
+	UPROPERTY(EditAnywhere, DisplayName = "Held prop send interval", Category = "Hold parameters")
+	float HeldPropSendInterval = 1.f / 30.f;
+
+	//Continuous collision detection is only turned on for the held body while it's held
+	UPROPERTY(EditAnywhere, DisplayName = "Use CCD while held", Category = "Hold parameters")
+	bool bUseCCDWhileHeld = true;
+
+	//Doors a confirmed interaction starts on the server begin moving at the time the client predicted them at, but never further back than this
+	UPROPERTY(EditAnywhere, DisplayName = "Max prediction rewind", Category = "Prediction parameters")
+	float MaxPredictionRewind = 0.25f;
+
+	//Added to the grab range when the server checks a predicted interaction
+	UPROPERTY(EditAnywhere, DisplayName = "Prediction range tolerance", Category = "Prediction parameters")
+	float PredictionRangeTolerance = 20.f;
+
 };
@@ -5,23 +5,26 @@
 #include "MassTreshold.h"
 #include "GameFramework/Actor.h"
 #include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "WorldCollision.h"
+#include "Subsystems/CellStreamingSubsystem.h"
+#include "Subsystems/GameplayEventBusSubsystem.h"
+#include "Subsystems/PhysicsPropSleepSubsystem.h"
 
 // Sets default values for this component's properties
 UMassTreshold::UMassTreshold()
 {
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
+	//Overlap and body events drive the plate; it only ticks, at the poll interval, while something is on it
 	PrimaryComponentTick.bCanEverTick = true;
-
-	// ...
+	PrimaryComponentTick.bStartWithTickEnabled = false;
 }
 
-// Called every frame
 void UMassTreshold::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	// ...
+	//Simulation toggles and weld changes of bodies without wake events report nothing, so the plate reconciles now and then while it holds any
+	ReconcileMass();
 }
 
 // Called when the game starts
@@ -36,41 +39,239 @@ void UMassTreshold::BeginPlay()
 	}
 	
 	ParentComponent = (UPrimitiveComponent*)GetAttachParent();
+	SetComponentTickInterval(LedgerPollInterval);
 	
 	ParentComponent->OnComponentBeginOverlap.AddDynamic(this, &UMassTreshold::OnOverlapBegin);
 	ParentComponent->OnComponentEndOverlap.AddDynamic(this, &UMassTreshold::OnEndOverlap);
 
-	// ...
-	
+	//A plate that streams in under bodies that are already resting on it gets no begin overlap events for them
+	RecalculateMass();
+
+	if (UCellStreamingSubsystem* CellStreaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>())
+	{
+		CellStreaming->RegisterMassTreshold(this);
+	}
+}
+
+void UMassTreshold::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UCellStreamingSubsystem* CellStreaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>())
+	{
+		CellStreaming->UnregisterMassTreshold(this);
+	}
+
+	for (const TPair<TWeakObjectPtr<UPrimitiveComponent>, int32>& Entry : Ledger)
+	{
+		if (UPrimitiveComponent* Component = Entry.Key.Get())
+		{
+			Component->OnComponentPhysicsStateChanged.RemoveDynamic(this, &UMassTreshold::OnBodyPhysicsStateChanged);
+			Component->OnComponentWake.RemoveDynamic(this, &UMassTreshold::OnBodyWakeOrSleep);
+			Component->OnComponentSleep.RemoveDynamic(this, &UMassTreshold::OnBodyWakeOrSleep);
+		}
+	}
+	Ledger.Empty();
+	CountedBodies.Empty();
+
+	Super::EndPlay(EndPlayReason);
 }
 
 
 
 void UMassTreshold::OnOverlapBegin(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
-	if(OtherComp->IsSimulatingPhysics())
+	if (!OtherComp)
 	{
-	TotalMass += OtherComp->GetMass();
-	CheckMass();
+		return;
+	}
+
+	AddToLedger(OtherComp);
+	ReconcileMass();
+
+	//Everything that ever weighed on a plate is a puzzle prop the sleep manager can take out of the simulation while nobody is around
+	if (OtherComp->IsSimulatingPhysics())
+	{
+		if (UPhysicsPropSleepSubsystem* SleepSubsystem = GetWorld()->GetSubsystem<UPhysicsPropSleepSubsystem>())
+		{
+			SleepSubsystem->RegisterBody(OtherComp);
+		}
 	}
 }
 
 void UMassTreshold::OnEndOverlap(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
 {
-	if (OtherComp->IsSimulatingPhysics())
+	if (!OtherComp)
 	{
-	TotalMass -= OtherComp->GetMass();
+		return;
+	}
+
+	RemoveFromLedger(OtherComp, false);
+	ReconcileMass();
+}
+
+void UMassTreshold::AddToLedger(UPrimitiveComponent* Component)
+{
+	int32& OverlapCount = Ledger.FindOrAdd(Component);
+	OverlapCount++;
+	if (OverlapCount == 1)
+	{
+		Component->OnComponentPhysicsStateChanged.AddUniqueDynamic(this, &UMassTreshold::OnBodyPhysicsStateChanged);
+		Component->OnComponentWake.AddUniqueDynamic(this, &UMassTreshold::OnBodyWakeOrSleep);
+		Component->OnComponentSleep.AddUniqueDynamic(this, &UMassTreshold::OnBodyWakeOrSleep);
+	}
+}
+
+void UMassTreshold::RemoveFromLedger(UPrimitiveComponent* Component, bool bRemoveAllOverlaps)
+{
+	int32* OverlapCount = Ledger.Find(Component);
+	if (!OverlapCount)
+	{
+		return;
+	}
+
+	(*OverlapCount)--;
+	if (*OverlapCount <= 0 || bRemoveAllOverlaps)
+	{
+		Ledger.Remove(Component);
+		Component->OnComponentPhysicsStateChanged.RemoveDynamic(this, &UMassTreshold::OnBodyPhysicsStateChanged);
+		Component->OnComponentWake.RemoveDynamic(this, &UMassTreshold::OnBodyWakeOrSleep);
+		Component->OnComponentSleep.RemoveDynamic(this, &UMassTreshold::OnBodyWakeOrSleep);
+	}
+}
+
+void UMassTreshold::OnBodyPhysicsStateChanged(UPrimitiveComponent* ChangedComponent, EComponentPhysicsStateChange StateChange)
+{
+	ReconcileMass();
+}
+
+void UMassTreshold::OnBodyWakeOrSleep(UPrimitiveComponent* Component, FName BoneName)
+{
+	ReconcileMass();
+}
+
+void UMassTreshold::RecalculateMass()
+{
+	if (!ParentComponent)
+	{
+		return;
+	}
+
+	TArray<UPrimitiveComponent*> PreviousComponents;
+	for (const TPair<TWeakObjectPtr<UPrimitiveComponent>, int32>& Entry : Ledger)
+	{
+		if (Entry.Key.IsValid())
+		{
+			PreviousComponents.Add(Entry.Key.Get());
+		}
+	}
+	for (UPrimitiveComponent* PreviousComponent : PreviousComponents)
+	{
+		RemoveFromLedger(PreviousComponent, true);
+	}
+	Ledger.Reset();
+
+	//The cached overlaps of the parent can't be trusted here: static plates that stream in don't get their overlaps updated, and components of a removed level can still be listed.
+	//The physics scene is asked instead; it reports one result per overlapping body, the same way the overlap events fill the ledger
+	TArray<FOverlapResult> Overlaps;
+	FComponentQueryParams QueryParams(SCENE_QUERY_STAT(MassTresholdRecalculate), GetOwner());
+	GetWorld()->ComponentOverlapMulti(OUT Overlaps, ParentComponent, ParentComponent->GetComponentLocation(), ParentComponent->GetComponentQuat(), QueryParams, FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllDynamicObjects));
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		UPrimitiveComponent* OverlappingComponent = Overlap.GetComponent();
+		if (OverlappingComponent && OverlappingComponent->IsRegistered() && !OverlappingComponent->IsPendingKill())
+		{
+			AddToLedger(OverlappingComponent);
+		}
+	}
+	ReconcileMass();
+}
+
+void UMassTreshold::ReconcileMass()
+{
+	//Only simulating bodies weigh on the plate. Welded components report the mass of their whole weld, so each weld is counted once through its root
+	CountedBodies.Reset();
+	float Mass = 0;
+	for (auto It = Ledger.CreateIterator(); It; ++It)
+	{
+		const UPrimitiveComponent* Component = It.Key().Get();
+		if (!Component || Component->IsPendingKill())
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		if (!Component->IsRegistered() || !Component->IsSimulatingPhysics()) { continue; }
+
+		const FBodyInstance* RootBody = Component->GetBodyInstance(NAME_None, true);
+		const UPrimitiveComponent* CountedBody = RootBody && RootBody->OwnerComponent.IsValid() ? RootBody->OwnerComponent.Get() : Component;
+		bool bIsAlreadyCounted = false;
+		CountedBodies.Add(CountedBody, &bIsAlreadyCounted);
+		if (!bIsAlreadyCounted)
+		{
+			Mass += CountedBody->GetMass();
+		}
+	}
+
+	TotalMass = Mass;
 	CheckMass();
+
+	const bool bShouldPoll = Ledger.Num() > 0;
+	if (IsComponentTickEnabled() != bShouldPoll)
+	{
+		SetComponentTickEnabled(bShouldPoll);
 	}
 }
 
+void UMassTreshold::SerializeCheckpoint(FArchive& Ar)
+{
+	float CapturedMass = TotalMass;
+	uint8 bWasAboveTreshold = bIsAboveTreshold ? 1 : 0;
+	Ar << CapturedMass;
+	Ar << bWasAboveTreshold;
+
+	if (!Ar.IsLoading() || !ParentComponent)
+	{
+		return;
+	}
+
+	//Props are restored before the plates, so the overlaps are already where they were at the capture
+	RecalculateMass();
+	if (!FMath::IsNearlyEqual(TotalMass, CapturedMass, 0.01f) || bIsAboveTreshold != (bWasAboveTreshold != 0))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Mass treshold on %s weighs %f after restoring a checkpoint captured with %f; a body on it isn't covered by the checkpoint."), *GetOwner()->GetName(), TotalMass, CapturedMass);
+	}
+}
+
+bool UMassTreshold::IsCountingBody(const UPrimitiveComponent* Body) const
+{
+	if (!Body)
+	{
+		return false;
+	}
+
+	const FBodyInstance* RootBody = Body->GetBodyInstance(NAME_None, true);
+	const UPrimitiveComponent* CountedBody = RootBody && RootBody->OwnerComponent.IsValid() ? RootBody->OwnerComponent.Get() : Body;
+	return CountedBodies.Contains(CountedBody);
+}
+
 void UMassTreshold::CheckMass()
 {
 	bool bCurrentResult = TotalMass >= WeightTreshold;
 	if (bIsAboveTreshold != bCurrentResult)
 	{
 		bIsAboveTreshold = bCurrentResult;
-		ResultChanged.Broadcast(bIsAboveTreshold);
+
+		//Bodies bouncing on the plate can cross the treshold several times per frame; the bus only reports where the frame ended
+		FMassTresholdEvent Event;
+		Event.Source = this;
+		Event.bWasAboveTreshold = !bIsAboveTreshold;
+		Event.bIsAboveTreshold = bIsAboveTreshold;
+		if (UGameplayEventBusSubsystem* EventBus = GetWorld()->GetSubsystem<UGameplayEventBusSubsystem>())
+		{
+			EventBus->MassTreshold.Post(Event);
+		}
+		else if (Event.HasBlueprintListeners())
+		{
+			Event.BroadcastToBlueprint();
+		}
 	}
 }
 
@@ -15,6 +15,9 @@ class BUILDING_ESCAPE_API UMassTreshold : public USceneComponent
 {
 	GENERATED_BODY()
 
+	//Bridges the events of the gameplay event bus to ResultChanged
+	friend struct FMassTresholdEvent;
+
 
 public:	
 	// Sets default values for this component's properties
@@ -23,24 +26,57 @@ public:
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
-	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	//Rebuilds the ledger from a physics scene query of the parent's shape; used when overlap events could have been missed(e.g. while cells stream)
+	void RecalculateMass();
+
+	//Recomputes the mass from the ledger; for changes no event reports, like a mass override set from Blueprint
+	UFUNCTION(BlueprintCallable, Category = "Mass Treshold")
+	void ReconcileMass();
+
+	//True if the body is on the plate and its mass is counted
+	bool IsCountingBody(const UPrimitiveComponent* Body) const;
+
+	bool IsAboveTreshold() const { return bIsAboveTreshold; }
+
+	//Writes or reads the plate for the checkpoint subsystem. The ledger itself isn't stored; it's rebuilt from the overlaps of the restored props, and the stored mass only verifies it
+	void SerializeCheckpoint(FArchive& Ar);
 
 private:
 	UPrimitiveComponent* ParentComponent = nullptr;
 	float TotalMass = 0;
 	bool bIsAboveTreshold = false;
 
+	//Every component overlapping the plate, with the number of its overlaps(one per overlapping body of multi-body components).
+	//The mass isn't accumulated; it's summed from scratch over the bodies in the ledger whenever one of them changes, so nothing can drift
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, int32> Ledger;
+	//Bodies whose mass was counted by the last reconciliation; welded components are represented by the root of their weld, so a compound only counts once
+	TSet<TWeakObjectPtr<const UPrimitiveComponent>> CountedBodies;
+
+	void AddToLedger(UPrimitiveComponent* Component);
+	void RemoveFromLedger(UPrimitiveComponent* Component, bool bRemoveAllOverlaps);
 	void CheckMass();
 
+	//Recreated physics states(welds, collision and body setup changes) and the wake and sleep events of bodies that generate them reconcile the plate right away;
+	//everything else(like simulation toggles of bodies without wake events) is picked up by the poll that runs while the ledger isn't empty
+	UFUNCTION()
+	void OnBodyPhysicsStateChanged(UPrimitiveComponent* ChangedComponent, EComponentPhysicsStateChange StateChange);
+	UFUNCTION()
+	void OnBodyWakeOrSleep(UPrimitiveComponent* Component, FName BoneName);
+
 	UFUNCTION()
 	void OnOverlapBegin(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
 	
 	UPROPERTY(EditAnywhere, DisplayName = "Treshold")
 	float WeightTreshold;
+
+	//Seconds between the reconciliations of a plate that has anything on it
+	UPROPERTY(EditAnywhere, DisplayName = "Ledger poll interval")
+	float LedgerPollInterval = 0.25f;
 	
 	UFUNCTION()
 	void OnEndOverlap(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
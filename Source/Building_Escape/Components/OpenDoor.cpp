@@ -3,18 +3,63 @@
 #include "OpenDoor.h"
 #include "GameFramework/Actor.h"
 #include "Engine/World.h"
+#include "TimerManager.h"
+#include "Curves/CurveFloat.h"
+#include "Net/UnrealNetwork.h"
+#include "Components/DoorNavModifierComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "NavAreas/NavArea_Default.h"
+#include "NavAreas/NavArea_Null.h"
+#include "Subsystems/CellStreamingSubsystem.h"
+#include "Subsystems/CheckpointSubsystem.h"
+#include "Subsystems/InteractableRegistrySubsystem.h"
+#include "Subsystems/DoorAnimationSubsystem.h"
 //#include "Kismet/GameplayStatics.h"
 
 // Sets default values for this component's properties
 UOpenDoor::UOpenDoor()
 {
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
-	PrimaryComponentTick.bCanEverTick = true;
+	//Doors are moved by the door animation subsystem while they are in motion, and cost nothing otherwise
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+	OpenNavArea = UNavArea_Default::StaticClass();
+	ClosedNavArea = UNavArea_Null::StaticClass();
+}
+
+bool FDoorMotionState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint8 bIsOpenBit = bIsOpen ? 1 : 0;
+	Ar.SerializeBits(&bIsOpenBit, 1);
+	Ar << StartServerTime;
+	uint16 CompressedYaw = FRotator::CompressAxisToShort(StartYaw);
+	Ar << CompressedYaw;
 
-	// ...
+	if (Ar.IsLoading())
+	{
+		bIsOpen = bIsOpenBit != 0;
+		StartYaw = FRotator::DecompressAxisFromShort(CompressedYaw);
+	}
+	bOutSuccess = true;
+	return true;
 }
 
+void UOpenDoor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UOpenDoor, MotionState);
+}
+
+void UOpenDoor::OnRegister()
+{
+	Super::OnRegister();
+
+	//Moving geometry would dirty the navmesh tiles around the door every frame; done on register, so the navmesh built in the editor leaves the door out as well
+	if (UPrimitiveComponent* DoorPrimitive = Cast<UPrimitiveComponent>(GetAttachParent()))
+	{
+		DoorPrimitive->SetCanEverAffectNavigation(false);
+	}
+}
 
 // Called when the game starts
 void UOpenDoor::BeginPlay()
@@ -22,55 +67,274 @@ void UOpenDoor::BeginPlay()
 	Super::BeginPlay();
 	bDelayActive = false;
 	InitialYaw = GetAttachParent()->GetComponentRotation().Yaw;
-	
-	
+
+	//The door replicates its motion state only, never its transform
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		GetOwner()->SetReplicates(true);
+		MotionState.StartYaw = FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(InitialYaw));
+	}
+	else if (MotionState.StartServerTime > 0.f)
+	{
+		//A state replicated before play began; the door is moved to where it is on the server right away
+		WakeAnimation();
+	}
+
+	if (bIsStreamingHint)
+	{
+		if (UCellStreamingSubsystem* CellStreaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>())
+		{
+			CellStreaming->RegisterDoorHint(this);
+		}
+	}
+
+	CreateNavModifier();
 }
- 
 
-// Called every frame
-void UOpenDoor::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+void UOpenDoor::CreateNavModifier()
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
-	
-	
-	if (bDelayActive && abs(GetWorld()->GetTimeSeconds() - DelayStartTime) > MinimumTimeBeingOpen)
+	//Only machines with a navigation system(the server, usually) need the passage
+	UPrimitiveComponent* DoorPrimitive = Cast<UPrimitiveComponent>(GetAttachParent());
+	if (!DoorPrimitive || !GetWorld()->GetNavigationSystem())
 	{
-		bDelayActive = false;
-		UpdateTargetRotation();
+		return;
 	}
-	
-	InterpolateRotation(DeltaTime);
 
-	// ...
+	//The door is closed at this point, so its bounds are the passage it blocks
+	FBox PassageBox = DoorPrimitive->CalcBounds(FTransform::Identity).GetBox();
+	PassageBox = PassageBox.ExpandBy(NavPassagePadding);
+
+	NavModifier = NewObject<UDoorNavModifierComponent>(GetOwner(), MakeUniqueObjectName(GetOwner(), UDoorNavModifierComponent::StaticClass(), TEXT("DoorNavModifier")));
+	NavModifier->SetPassage(PassageBox, DoorPrimitive->GetComponentTransform());
+	UpdateNavArea();
+	NavModifier->RegisterComponent();
 }
 
-void UOpenDoor::InterpolateRotation(float& DeltaTime)
+void UOpenDoor::UpdateNavArea()
 {
+	if (NavModifier)
+	{
+		NavModifier->SetAreaClass(MotionState.bIsOpen ? OpenNavArea : ClosedNavArea);
+	}
+}
 
-	FRotator CurrentRotation = GetAttachParent()->GetComponentRotation();
-	float NewYaw = FMath::FInterpTo(CurrentRotation.Yaw, TargetYaw, DeltaTime, bShouldBeOpened ? OpeningVelocity : ClosingVelocity);
-	GetAttachParent()->SetWorldRotation(FRotator(CurrentRotation.Pitch, NewYaw, CurrentRotation.Roll), false, nullptr, ETeleportType::TeleportPhysics);
-	CurrentRotation = GetAttachParent()->GetComponentRotation();
+void UOpenDoor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UCellStreamingSubsystem* CellStreaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>())
+	{
+		CellStreaming->UnregisterDoorHint(this);
+	}
+	if (UDoorAnimationSubsystem* DoorAnimation = GetWorld()->GetSubsystem<UDoorAnimationSubsystem>())
+	{
+		DoorAnimation->RemoveDoor(this);
+	}
+	GetWorld()->GetTimerManager().ClearTimer(MinimumOpenTimer);
 
+	Super::EndPlay(EndPlayReason);
 }
 
 void UOpenDoor::ToggleShouldBeOpened(bool bNewShouldBeOpened)
 {
-	bShouldBeOpened = bNewShouldBeOpened;
-	UpdateTargetRotation();
+	//Clients follow the replicated motion state; on them the call(e.g. from Blueprint running on every machine) only serves as a streaming hint,
+	//unless it comes from an interaction the client predicts, in which case the door moves right away and keeps its previous state for a rollback
+	const FInteractionWindow* Window = GetInteractionWindow();
+	const bool bIsPredicted = Window && Window->RollbackState;
+	if (GetOwnerRole() == ROLE_Authority || bIsPredicted)
+	{
+		if (bIsPredicted)
+		{
+			UCheckpointSubsystem::CaptureRecord(*Window->RollbackState, this, FCheckpoint::RecordType_Door);
+		}
+		bShouldBeOpened = bNewShouldBeOpened;
+		UpdateTargetRotation();
+	}
+
+	if (bNewShouldBeOpened)
+	{
+		AddOpeningStreamingHint();
+	}
+}
+
+void UOpenDoor::AddOpeningStreamingHint()
+{
+	//A door that starts opening is the strongest hint there is; the cells behind it are requested immediately in case the approach wasn't noticed in time
+	if (bIsStreamingHint)
+	{
+		if (UCellStreamingSubsystem* CellStreaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>())
+		{
+			//The hint lasts for as long as the door is kept open, and then as long as any other hint
+			CellStreaming->AddStreamingHint(GetComponentLocation(), StreamingHintRadius, MinimumTimeBeingOpen + CellStreaming->GetHintDuration());
+		}
+	}
+}
+
+float UOpenDoor::GetStreamingHintRadius() const
+{
+	return StreamingHintRadius;
+}
+
+const FDoorMotionState& UOpenDoor::GetMotionState() const
+{
+	return MotionState;
+}
+
+float UOpenDoor::GetTargetYaw() const
+{
+	return MotionState.bIsOpen ? InitialYaw + MaxYaw : InitialYaw;
+}
+
+float UOpenDoor::GetInterpSpeed() const
+{
+	return MotionState.bIsOpen ? OpeningVelocity : ClosingVelocity;
+}
+
+UCurveFloat* UOpenDoor::GetMotionCurve() const
+{
+	return MotionState.bIsOpen ? OpeningCurve : ClosingCurve;
+}
+
+bool UOpenDoor::ShouldDeferOverlaps() const
+{
+	return bDeferOverlapsWhileClear;
+}
+
+float UOpenDoor::EvaluateMotionAlpha(const UCurveFloat* Curve, float InterpSpeed, float Elapsed)
+{
+	Elapsed = FMath::Max(Elapsed, 0.f);
+	if (Curve)
+	{
+		return Curve->GetFloatValue(Elapsed);
+	}
+	if (InterpSpeed <= 0.f)
+	{
+		return 1.f;
+	}
+	return 1.f - FMath::Exp(-InterpSpeed * Elapsed);
+}
+
+float UOpenDoor::EvaluateYaw(float ServerTime) const
+{
+	//The start yaw is unwound towards the target so a door near +-180 degrees doesn't turn the long way round
+	const float TargetYaw = GetTargetYaw();
+	const float StartYaw = TargetYaw + FRotator::NormalizeAxis(MotionState.StartYaw - TargetYaw);
+	const float Alpha = EvaluateMotionAlpha(GetMotionCurve(), GetInterpSpeed(), ServerTime - MotionState.StartServerTime);
+	return FMath::Lerp(StartYaw, TargetYaw, Alpha);
 }
 
 void UOpenDoor::UpdateTargetRotation()
 {
-	if (bShouldBeOpened || bDelayActive)
+	//Once opened the door stays open for at least MinimumTimeBeingOpen; a close request within that time is carried out when the timer ends
+	if (bShouldBeOpened)
+	{
+		bDelayActive = MinimumTimeBeingOpen > 0.f;
+		if (bDelayActive)
+		{
+			GetWorld()->GetTimerManager().SetTimer(MinimumOpenTimer, this, &UOpenDoor::OnMinimumOpenTimeElapsed, MinimumTimeBeingOpen, false);
+		}
+		SetMotionTarget(true);
+	}
+	else if (!bDelayActive)
+	{
+		SetMotionTarget(false);
+	}
+}
+
+void UOpenDoor::SetMotionTarget(bool bNewIsOpen)
+{
+	if (MotionState.bIsOpen == bNewIsOpen)
+	{
+		return;
+	}
+
+	//The new motion starts from wherever the current one got to; within an interaction that's where it got to when the player interacted
+	UDoorAnimationSubsystem* DoorAnimation = GetWorld()->GetSubsystem<UDoorAnimationSubsystem>();
+	const FInteractionWindow* Window = GetInteractionWindow();
+	const float ServerTime = Window ? Window->MotionStartTime : (DoorAnimation ? DoorAnimation->GetServerTime() : GetWorld()->GetTimeSeconds());
+	const float CurrentYaw = EvaluateYaw(ServerTime);
+
+	MotionState.bIsOpen = bNewIsOpen;
+	MotionState.StartServerTime = ServerTime;
+	MotionState.StartYaw = FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(CurrentYaw));
+	WakeAnimation();
+	UpdateNavArea();
+}
+
+void UOpenDoor::OnRep_MotionState()
+{
+	if (!HasBegunPlay())
+	{
+		return;
+	}
+
+	WakeAnimation();
+	UpdateNavArea();
+	if (MotionState.bIsOpen)
+	{
+		AddOpeningStreamingHint();
+	}
+}
+
+const FInteractionWindow* UOpenDoor::GetInteractionWindow() const
+{
+	const UInteractableRegistrySubsystem* InteractableRegistry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>();
+	return InteractableRegistry ? InteractableRegistry->GetInteractionWindow() : nullptr;
+}
+
+void UOpenDoor::WakeAnimation()
+{
+	if (UDoorAnimationSubsystem* DoorAnimation = GetWorld()->GetSubsystem<UDoorAnimationSubsystem>())
 	{
-		TargetYaw = InitialYaw + MaxYaw;
-		DelayStartTime = GetWorld()->GetTimeSeconds();
-		bDelayActive = true;
+		DoorAnimation->WakeDoor(this);
 	}
-	else
+}
+
+void UOpenDoor::OnMinimumOpenTimeElapsed()
+{
+	bDelayActive = false;
+	if (!bShouldBeOpened)
 	{
+		UpdateTargetRotation();
+	}
+}
+
+void UOpenDoor::SerializeCheckpoint(FArchive& Ar)
+{
+	//Times are stored relative to the capture, so a restored motion and minimum open time continue from where they were instead of having run on in the meantime
+	FTimerManager& TimerManager = GetWorld()->GetTimerManager();
+	UDoorAnimationSubsystem* DoorAnimation = GetWorld()->GetSubsystem<UDoorAnimationSubsystem>();
+	const float ServerTime = DoorAnimation ? DoorAnimation->GetServerTime() : GetWorld()->GetTimeSeconds();
+
+	uint8 Flags = (bShouldBeOpened ? 1 : 0) | (bDelayActive ? 2 : 0) | (MotionState.bIsOpen ? 4 : 0);
+	float DelayRemaining = bDelayActive ? FMath::Max(TimerManager.GetTimerRemaining(MinimumOpenTimer), 0.f) : 0.f;
+	float MotionElapsed = ServerTime - MotionState.StartServerTime;
+	Ar << Flags;
+	Ar << DelayRemaining;
+	Ar << MotionElapsed;
+	Ar << MotionState.StartYaw;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	bShouldBeOpened = (Flags & 1) != 0;
+	bDelayActive = (Flags & 2) != 0;
+	MotionState.bIsOpen = (Flags & 4) != 0;
+	MotionState.StartServerTime = ServerTime - MotionElapsed;
 
-		TargetYaw = InitialYaw;
+	TimerManager.ClearTimer(MinimumOpenTimer);
+	if (bDelayActive)
+	{
+		TimerManager.SetTimer(MinimumOpenTimer, this, &UOpenDoor::OnMinimumOpenTimeElapsed, FMath::Max(DelayRemaining, KINDA_SMALL_NUMBER), false);
 	}
-}
\ No newline at end of file
+
+	//The door is teleported to its captured pose first, so the animation doesn't sweep the restored props out of the way on its first frame
+	if (USceneComponent* DoorParent = GetAttachParent())
+	{
+		FRotator Rotation = DoorParent->GetComponentRotation();
+		Rotation.Yaw = EvaluateYaw(ServerTime);
+		DoorParent->SetWorldRotation(Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+	WakeAnimation();
+	UpdateNavArea();
+}
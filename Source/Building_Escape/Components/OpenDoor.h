@@ -7,6 +7,40 @@
 #include "Engine/TriggerVolume.h"
 #include "OpenDoor.generated.h"
 
+class UCurveFloat;
+class UNavArea;
+class UDoorNavModifierComponent;
+struct FInteractionWindow;
+
+//What the door is moving towards and since when. The pose at any time follows from this alone, so it's all that is replicated and late joiners start out with the exact pose.
+//The start yaw is quantized to 16 bits on the server as well, so both sides evaluate the same motion
+USTRUCT()
+struct FDoorMotionState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	bool bIsOpen = false;
+
+	//Server world time the motion started at
+	UPROPERTY()
+	float StartServerTime = 0.f;
+
+	//Yaw the door was at when the motion started
+	UPROPERTY()
+	float StartYaw = 0.f;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FDoorMotionState> : public TStructOpsTypeTraitsBase2<FDoorMotionState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class BUILDING_ESCAPE_API UOpenDoor : public USceneComponent
@@ -18,33 +52,92 @@ public:
 	UOpenDoor();
 
 protected:
+	virtual void OnRegister() override;
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
-	// Called every frame
-	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	float GetStreamingHintRadius() const;
+
+	//Read by the door animation subsystem whenever the door is woken
+	const FDoorMotionState& GetMotionState() const;
+	float GetTargetYaw() const;
+	float GetInterpSpeed() const;
+	//Null if the door eases towards its target with its velocity instead
+	UCurveFloat* GetMotionCurve() const;
+	bool ShouldDeferOverlaps() const;
+
+	//How far, from 0 to 1, a motion that started Elapsed seconds ago got; the curve maps seconds to that fraction, without one the door eases in exponentially like FInterpTo
+	static float EvaluateMotionAlpha(const UCurveFloat* Curve, float InterpSpeed, float Elapsed);
+	//Yaw of the door at the given server time
+	float EvaluateYaw(float ServerTime) const;
+
+	UFUNCTION(BlueprintCallable)
+	void ToggleShouldBeOpened(bool bNewShouldBeOpened);
+
+	//Writes or reads the state of the door for the checkpoint subsystem; a loaded door is put at the pose it had when captured and continues its motion from there. Server only
+	void SerializeCheckpoint(FArchive& Ar);
 
 private:
-	void InterpolateRotation(float& DeltaTime);
 	bool bShouldBeOpened = false;
-	float TargetYaw;
 	float InitialYaw;
 	bool bDelayActive;
-	float DelayStartTime = 0.f;
+	FTimerHandle MinimumOpenTimer;
+
+	//Only changed on the server; clients follow it
+	UPROPERTY(ReplicatedUsing = OnRep_MotionState)
+	FDoorMotionState MotionState;
+	UFUNCTION()
+	void OnRep_MotionState();
+	void SetMotionTarget(bool bNewIsOpen);
+	void WakeAnimation();
+	void AddOpeningStreamingHint();
+	const FInteractionWindow* GetInteractionWindow() const;
+
+	UPROPERTY()
+	UDoorNavModifierComponent* NavModifier = nullptr;
+	void CreateNavModifier();
+	void UpdateNavArea();
 
 	void UpdateTargetRotation();
-	UFUNCTION(BlueprintCallable)
-	void ToggleShouldBeOpened(bool bNewShouldBeOpened);
+	void OnMinimumOpenTimeElapsed();
 	UPROPERTY(EditAnywhere, Category = "Range")
 	float MaxYaw = 90.f;
 	UPROPERTY(EditAnywhere, Category = "Speed")
 	float OpeningVelocity = 1.f;
 	UPROPERTY(EditAnywhere, Category = "Speed")
 	float ClosingVelocity = 1.f;
+	//Maps the seconds since the door started opening to how far open it is, from 0 to 1; replaces OpeningVelocity when set
+	UPROPERTY(EditAnywhere, Category = "Speed")
+	UCurveFloat* OpeningCurve = nullptr;
+	//Maps the seconds since the door started closing to how far closed it is, from 0 to 1; replaces ClosingVelocity when set
+	UPROPERTY(EditAnywhere, Category = "Speed")
+	UCurveFloat* ClosingCurve = nullptr;
 	UPROPERTY(EditAnywhere, Category = "Speed")
 	float MinimumTimeBeingOpen = 1.f;
 
+	//Skips the overlap updates of the moving door while no pawn or physics body is near it; turn off for doors whose overlap events something relies on
+	UPROPERTY(EditAnywhere, Category = "Collision")
+	bool bDeferOverlapsWhileClear = true;
+
+	//The door itself never affects the navmesh; its passage is marked with these areas instead, switched when it starts opening or closing
+	UPROPERTY(EditAnywhere, Category = "Navigation")
+	TSubclassOf<UNavArea> OpenNavArea;
+	UPROPERTY(EditAnywhere, Category = "Navigation")
+	TSubclassOf<UNavArea> ClosedNavArea;
+	//Added to the bounds of the closed door on every side, so the passage covers at least a voxel of the navmesh
+	UPROPERTY(EditAnywhere, Category = "Navigation")
+	float NavPassagePadding = 20.f;
+
+	//Streaming cells within this distance from the door are preloaded when a player approaches it, so the room behind it is ready once it opens
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+	bool bIsStreamingHint = true;
+	UPROPERTY(EditAnywhere, Category = "Streaming", meta = (EditCondition = "bIsStreamingHint"))
+	float StreamingHintRadius = 800.f;
+
 
 		
 };
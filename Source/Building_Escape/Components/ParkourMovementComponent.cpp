@@ -9,7 +9,14 @@
 #include "Components/CapsuleComponent.h"
 #include "Components/BoxComponent.h"
 #include "GameFramework/Character.h"
+#include "GameFramework/PlayerController.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "PhysicsEngine/PhysicsSettings.h"
+#include "Subsystems/TraceSchedulerSubsystem.h"
+#include "Subsystems/GameplayEventBusSubsystem.h"
+
+//Upper bound of the scene queries a single TestHangPoint call runs; reported to the trace scheduler
+static const int32 HangPointTestTraceCount = 6;
 
 // Sets default values
 UParkourMovementComponent::UParkourMovementComponent()
@@ -21,27 +28,28 @@ UParkourMovementComponent::UParkourMovementComponent()
 	bCrouchMaintainsBaseLocation = false;
 	bUseSeparateBrakingFriction = false;
 	GroundFriction = 8.f;
-	
 
+	HandSize = FVector(5, 15, 1);
+	// Vertical distance from player pivot at which the test is performed
+	GrabHeight = 65;
+	// forward distance from player pivot at which the test is performed
+	GrabbingReach = 100;
+	// Vertical distance between player pivot and the edge that the player is hanging on
+	AttachHeight = 65.0;
+	// Gap between the capsule and the wall the player is hanging on
+	AttachWallGap = 6;
 }
 
 // Called when the game starts or when spawned
 void UParkourMovementComponent::BeginPlay()
 {
 	Super::BeginPlay();
-	MaxWallrunTime = 2;
 	SetComponentTickEnabled(true);
 	((UCapsuleComponent*)(GetOwner()->GetRootComponent()))->GetScaledCapsuleSize(OUT CapsuleRadius, OUT CapsuleHalfHeight);
 
-	HandSize = FVector(5, 15, 1);
-	// Vertical distance from player pivot at which the test is performed
-	GrabHeight = 65;
-	// forward distance from player pivot at which the test is performed
-	GrabbingReach = 100;
-	// Vertical distance between player pivot and the edge that the player is hanging on
-	AttachHeight = 65.0;
 	// Forward distance between the player pivot and the wall the player is hanging on
-	AttachDistance = CapsuleRadius + 6;
+	AttachDistance = CapsuleRadius + AttachWallGap;
+	RefreshSimulationParameters();
 
 	TraceDirectionOffsets.Add(TraceDirection_Ahead, FRotator(0, 0, 0));
 	TraceDirectionOffsets.Add(TraceDirection_Behind, FRotator(0, 180, 0));
@@ -49,6 +57,9 @@ void UParkourMovementComponent::BeginPlay()
 	TraceDirectionOffsets.Add(TraceDirection_Right, FRotator(0, 90, 0));
 	TraceDirectionOffsets.Add(TraceDirection_Up, FRotator(90, 0, 0));
 	TraceDirectionOffsets.Add(TraceDirection_Down, FRotator(-90, 0, 0));
+
+	TraceScheduler = GetWorld()->GetSubsystem<UTraceSchedulerSubsystem>();
+	EventBus = GetWorld()->GetSubsystem<UGameplayEventBusSubsystem>();
 }
 
 void UParkourMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -79,8 +90,8 @@ void UParkourMovementComponent::TickComponent(float DeltaTime, ELevelTick TickTy
 		}
 		else
 		{
-			bool bHeightBoostPossible = abs(JumpOffPoint.Z - LastUpdateLocation.Z) < 300 && LastUpdateLocation.Z - JumpOffPoint.Z - 300 < 0;
-			Velocity = GetOwner()->GetActorRotation().RotateVector(FVector(1200, DirectionTraceHitResults.Contains(TraceDirection_Left) ? -200 : 200, bHeightBoostPossible ? (JumpOffPoint.Z + JumpZVelocity) - LastUpdateLocation.Z : 0));
+			bool bHeightBoostPossible = abs(JumpOffPoint.Z - LastUpdateLocation.Z) < WallrunMaxHeightGain && LastUpdateLocation.Z - JumpOffPoint.Z - WallrunMaxHeightGain < 0;
+			Velocity = GetOwner()->GetActorRotation().RotateVector(FVector(WallrunForwardSpeed, DirectionTraceHitResults.Contains(TraceDirection_Left) ? -WallrunSideSpeed : WallrunSideSpeed, bHeightBoostPossible ? (JumpOffPoint.Z + JumpZVelocity) - LastUpdateLocation.Z : 0));
 			UpdateBlockedDirections();
 		}
 		break;
@@ -127,12 +138,14 @@ void UParkourMovementComponent::AttemptUnCrouch()
 void UParkourMovementComponent::Crouch(bool bClientSimulation)
 {
 	Super::Crouch(bClientSimulation);
+	RefreshSimulationParameters();
 	ResetToBasicParkourState();
 }
 
 void UParkourMovementComponent::UnCrouch(bool bClientSimulation)
 {
 	Super::UnCrouch(bClientSimulation);
+	RefreshSimulationParameters();
 	ResetToBasicParkourState();
 }
 
@@ -162,6 +175,66 @@ void UParkourMovementComponent::ResetToBasicParkourState()
 	}
 }
 
+void UParkourMovementComponent::SerializeCheckpoint(FArchive& Ar)
+{
+	AController* OwnerController = CharacterOwner ? CharacterOwner->GetController() : nullptr;
+	FVector Location = UpdatedComponent ? UpdatedComponent->GetComponentLocation() : FVector::ZeroVector;
+	FRotator Rotation = UpdatedComponent ? UpdatedComponent->GetComponentRotation() : FRotator::ZeroRotator;
+	FRotator ControlRotation = OwnerController ? OwnerController->GetControlRotation() : Rotation;
+	uint8 Mode = MovementMode;
+	uint8 Flags = (IsCrouching() ? 1 : 0) | (bCanAirBoost ? 2 : 0);
+	FVector CapturedJumpOffPoint = JumpOffPoint;
+	Ar << Location;
+	Ar << Rotation;
+	Ar << ControlRotation;
+	Ar << Velocity;
+	Ar << Mode;
+	Ar << Flags;
+	Ar << CapturedJumpOffPoint;
+
+	if (!Ar.IsLoading() || !CharacterOwner)
+	{
+		return;
+	}
+
+	//Leaving the hang restores collision, input and gravity, which the hang may have changed
+	if (CurrentHangingState != HangingState_NotHanging)
+	{
+		ChangeHangingState(HangingState_NotHanging);
+	}
+	GetWorld()->GetTimerManager().ClearTimer(SlideTimerHandle);
+	GetWorld()->GetTimerManager().ClearTimer(WallrunTimerHandle);
+
+	const FVector RestoredVelocity = Velocity;
+	CharacterOwner->TeleportTo(Location, Rotation, false, true);
+	if (APlayerController* PlayerController = Cast<APlayerController>(OwnerController))
+	{
+		//Goes through an RPC, so it reaches the view of remote players as well
+		PlayerController->ClientSetRotation(ControlRotation);
+	}
+	else if (OwnerController)
+	{
+		OwnerController->SetControlRotation(ControlRotation);
+	}
+
+	//Hanging and wallrunning use flying; the pawn falls from where it was instead
+	const EMovementMode RestoredMode = (EMovementMode)Mode;
+	SetMovementMode(RestoredMode == MOVE_Walking || RestoredMode == MOVE_NavWalking ? RestoredMode : MOVE_Falling);
+	bWantsToCrouch = (Flags & 1) != 0;
+	if (bWantsToCrouch)
+	{
+		Crouch();
+	}
+	else
+	{
+		UnCrouch();
+	}
+	Velocity = RestoredVelocity;
+	bCanAirBoost = (Flags & 2) != 0;
+	ResetToBasicParkourState();
+	JumpOffPoint = CapturedJumpOffPoint;
+}
+
 void UParkourMovementComponent::UpdateEdgeStatuses()
 {
 	//The loop executes exactly two times (index 0 for left side, index 1 for right side)
@@ -210,16 +283,28 @@ void UParkourMovementComponent::UpdateEdgeStatuses()
 
 bool UParkourMovementComponent::IsValidHangPoint(OUT FVector& OutHangLocation, OUT FRotator& OutHangRotation, FVector InOriginLocation, FRotator InOriginRotation) const
 {
-	//Declaring variables needed for tracubg
-	FVector AttachTraceStart = InOriginLocation + InOriginRotation.RotateVector(FVector(-CapsuleRadius, 0, GrabHeight - HandSize.Z - 3));
-	FVector AttachTraceEnd = AttachTraceStart + InOriginRotation.RotateVector(FVector(GrabbingReach + 1 + CapsuleRadius, 0,0));
 	FCollisionQueryParams TraceParams(FName(TEXT("")), false, GetOwner());
 	TraceParams.bFindInitialOverlaps = false;
 	TraceParams.AddIgnoredActor(GetOwner());
+
+	//Hang validation decides what happens this frame, so it can't be deferred; it only takes its share of the frame's budget
+	if (TraceScheduler)
+	{
+		TraceScheduler->RecordImmediateTraces(TracePriority_Critical, HangPointTestTraceCount);
+	}
+
+	return TestHangPoint(GetWorld(), SimulationParameters, TraceParams, OUT OutHangLocation, OUT OutHangRotation, InOriginLocation, InOriginRotation);
+}
+
+bool UParkourMovementComponent::TestHangPoint(const UWorld* World, const FParkourSimulationParameters& Parameters, const FCollisionQueryParams& TraceParams, OUT FVector& OutHangLocation, OUT FRotator& OutHangRotation, FVector InOriginLocation, FRotator InOriginRotation)
+{
+	//Declaring variables needed for tracubg
+	FVector AttachTraceStart = InOriginLocation + InOriginRotation.RotateVector(FVector(-Parameters.CapsuleRadius, 0, Parameters.GrabHeight - Parameters.HandSize.Z - 3));
+	FVector AttachTraceEnd = AttachTraceStart + InOriginRotation.RotateVector(FVector(Parameters.GrabbingReach + 1 + Parameters.CapsuleRadius, 0,0));
 	FHitResult LineTraceHitResult;
 
 	//Performing a trace that seeks for a surface that could support a hanging player
-	bool bDidAttachTraceSucceed = GetWorld()->LineTraceSingleByChannel
+	bool bDidAttachTraceSucceed = World->LineTraceSingleByChannel
 	(
 		OUT LineTraceHitResult,
 		AttachTraceStart,
@@ -234,7 +319,7 @@ bool UParkourMovementComponent::IsValidHangPoint(OUT FVector& OutHangLocation, O
 		return false;
 	};
 
-	if (LineTraceHitResult.GetComponent()->IsSimulatingPhysics())
+	if (LineTraceHitResult.GetComponent() && LineTraceHitResult.GetComponent()->IsSimulatingPhysics())
 	{
 		//Component simulates physics - not suitable for attachment
 		return false;
@@ -242,23 +327,23 @@ bool UParkourMovementComponent::IsValidHangPoint(OUT FVector& OutHangLocation, O
 
 	//Calculating hang location and rotation based on hit location and hit normal
 	FRotator AdjustedRotation = (UKismetMathLibrary::FindLookAtRotation(FVector(0, 0, 0), LineTraceHitResult.ImpactNormal)) + FRotator(0,180,0);
-	FVector AdjustedLocation = LineTraceHitResult.ImpactPoint + AdjustedRotation.RotateVector(FVector(-1 * AttachDistance, 0, 0));
+	FVector AdjustedLocation = LineTraceHitResult.ImpactPoint + AdjustedRotation.RotateVector(FVector(-1 * Parameters.AttachDistance, 0, 0));
 	
 
 	//Preparing variables for the incoming sweep
-	FVector HandSpaceTraceStart = FVector(AdjustedLocation.X, AdjustedLocation.Y, AdjustedLocation.Z + GrabHeight + HandSize.Z/2);
-	FVector HandSpaceTraceEnd = HandSpaceTraceStart + AdjustedRotation.RotateVector(FVector(AttachDistance + HandSize.X, 0, 0));
+	FVector HandSpaceTraceStart = FVector(AdjustedLocation.X, AdjustedLocation.Y, AdjustedLocation.Z + Parameters.GrabHeight + Parameters.HandSize.Z/2);
+	FVector HandSpaceTraceEnd = HandSpaceTraceStart + AdjustedRotation.RotateVector(FVector(Parameters.AttachDistance + Parameters.HandSize.X, 0, 0));
 	FHitResult SweepResult;
 	
 	//Sweeping to tell if there is enough space for the players hands
-	GetWorld()->SweepSingleByChannel
+	World->SweepSingleByChannel
 	(
 		OUT SweepResult,
 		HandSpaceTraceStart,
 		HandSpaceTraceEnd,
 		AdjustedRotation.Quaternion(),
 		ECollisionChannel::ECC_Visibility,
-		FCollisionShape::MakeBox(FVector(HandSize.X, HandSize.Y, HandSize.Z)),
+		FCollisionShape::MakeBox(FVector(Parameters.HandSize.X, Parameters.HandSize.Y, Parameters.HandSize.Z)),
 		TraceParams
 	);
 
@@ -269,9 +354,9 @@ bool UParkourMovementComponent::IsValidHangPoint(OUT FVector& OutHangLocation, O
 	}
 
 	//Tracing straight down to know how hight the should the player be atattached
-	FVector HeightTraceStart = FVector(LineTraceHitResult.ImpactPoint.X, LineTraceHitResult.ImpactPoint.Y, LineTraceHitResult.ImpactPoint.Z + GrabHeight + 1) + AdjustedRotation.RotateVector(FVector(HandSize.X, 0, 0));
-	FVector HeightTraceEnd = HeightTraceStart - FVector(0, 0, GrabHeight + 1);
-	GetWorld()->LineTraceSingleByChannel
+	FVector HeightTraceStart = FVector(LineTraceHitResult.ImpactPoint.X, LineTraceHitResult.ImpactPoint.Y, LineTraceHitResult.ImpactPoint.Z + Parameters.GrabHeight + 1) + AdjustedRotation.RotateVector(FVector(Parameters.HandSize.X, 0, 0));
+	FVector HeightTraceEnd = HeightTraceStart - FVector(0, 0, Parameters.GrabHeight + 1);
+	World->LineTraceSingleByChannel
 	(
 		OUT LineTraceHitResult,
 		HeightTraceStart,
@@ -287,25 +372,25 @@ bool UParkourMovementComponent::IsValidHangPoint(OUT FVector& OutHangLocation, O
 	}
 	
 	//Correcting the Z value of AdjustedLocation using the impact point, offset by AttachHeight
-	AdjustedLocation = FVector(AdjustedLocation.X, AdjustedLocation.Y, LineTraceHitResult.ImpactPoint.Z - AttachHeight);
+	AdjustedLocation = FVector(AdjustedLocation.X, AdjustedLocation.Y, LineTraceHitResult.ImpactPoint.Z - Parameters.AttachHeight);
 
 	//Tracing across the dimensions of a theoretical capsule - works better that sweeping with a capsule shape
 	//Trace across X dimension
-	GetWorld()->LineTraceSingleByChannel
+	World->LineTraceSingleByChannel
 	(
 		OUT LineTraceHitResult,
-		AdjustedLocation + AdjustedRotation.RotateVector(FVector(-CapsuleRadius, 0, 0)),
-		AdjustedLocation + AdjustedRotation.RotateVector(FVector(CapsuleRadius, 0, 0)),
+		AdjustedLocation + AdjustedRotation.RotateVector(FVector(-Parameters.CapsuleRadius, 0, 0)),
+		AdjustedLocation + AdjustedRotation.RotateVector(FVector(Parameters.CapsuleRadius, 0, 0)),
 		ECollisionChannel::ECC_Visibility,
 		TraceParams
 	);
 	
 	//Trace across Y dimension
-	GetWorld()->LineTraceSingleByChannel
+	World->LineTraceSingleByChannel
 	(
 		OUT LineTraceHitResult,
-		AdjustedLocation + AdjustedRotation.RotateVector(FVector(0, -CapsuleRadius,0)),
-		AdjustedLocation + AdjustedRotation.RotateVector(FVector(0, CapsuleRadius, 0)),
+		AdjustedLocation + AdjustedRotation.RotateVector(FVector(0, -Parameters.CapsuleRadius,0)),
+		AdjustedLocation + AdjustedRotation.RotateVector(FVector(0, Parameters.CapsuleRadius, 0)),
 		ECollisionChannel::ECC_Visibility,
 		TraceParams
 	);
@@ -318,11 +403,11 @@ bool UParkourMovementComponent::IsValidHangPoint(OUT FVector& OutHangLocation, O
 	}
 
 	//Trace across Z dimension
-	GetWorld()->LineTraceSingleByChannel
+	World->LineTraceSingleByChannel
 	(	
 		OUT LineTraceHitResult,
-		AdjustedLocation + AdjustedRotation.RotateVector(FVector(0, 0, CapsuleHalfHeight)),
-		AdjustedLocation + AdjustedRotation.RotateVector(FVector(CapsuleRadius, 0, -CapsuleHalfHeight)),
+		AdjustedLocation + AdjustedRotation.RotateVector(FVector(0, 0, Parameters.CapsuleHalfHeight)),
+		AdjustedLocation + AdjustedRotation.RotateVector(FVector(Parameters.CapsuleRadius, 0, -Parameters.CapsuleHalfHeight)),
 		ECollisionChannel::ECC_Visibility,
 		TraceParams
 	);
@@ -406,7 +491,7 @@ void UParkourMovementComponent::ChangeHangingState(TEnumAsByte<EHangingState> Ne
 	//The delegate is triggered only if the state changed between HangingState_NotHanging and any other state
 	if ((CurrentHangingState == HangingState_NotHanging) != bIsNewStateHangingState_NotHanging)
 	{
-		HangingStateChanged.Broadcast(!bIsNewStateHangingState_NotHanging);
+		PostHangingStateChanged(!bIsNewStateHangingState_NotHanging);
 	}
 	
 	FVector TargetLocation;
@@ -614,7 +699,42 @@ void UParkourMovementComponent::SetParkourState(TEnumAsByte<EParkourMovementStat
 		break;
 	}
 
-	ParkourMovementStateChangedDelegate.Broadcast(NewState, CurrentMovementState);
+	PostParkourStateChanged(PrevState, NewState);
+}
+
+void UParkourMovementComponent::PostParkourStateChanged(TEnumAsByte<EParkourMovementState> PrevState, TEnumAsByte<EParkourMovementState> NewState)
+{
+	FParkourStateEvent Event;
+	Event.Source = this;
+	Event.PreviousState = PrevState;
+	Event.NewState = NewState;
+
+	//Without a bus(e.g. outside of a game world) the Blueprint delegate is reached directly
+	if (EventBus)
+	{
+		EventBus->ParkourState.Post(Event);
+	}
+	else if (Event.HasBlueprintListeners())
+	{
+		Event.BroadcastToBlueprint();
+	}
+}
+
+void UParkourMovementComponent::PostHangingStateChanged(bool bIsHanging)
+{
+	FHangingStateEvent Event;
+	Event.Source = this;
+	Event.bWasHanging = !bIsHanging;
+	Event.bIsHanging = bIsHanging;
+
+	if (EventBus)
+	{
+		EventBus->HangingState.Post(Event);
+	}
+	else if (Event.HasBlueprintListeners())
+	{
+		Event.BroadcastToBlueprint();
+	}
 }
 
 TEnumAsByte<EParkourMovementState> UParkourMovementComponent::GetMovementState()
@@ -625,7 +745,7 @@ TEnumAsByte<EParkourMovementState> UParkourMovementComponent::GetMovementState()
 void UParkourMovementComponent::StartNoHangTimer()
 {
 	GetWorld()->GetTimerManager().ClearTimer(NoHangTimerHandle);
-	GetWorld()->GetTimerManager().SetTimer(NoHangTimerHandle, this, &UParkourMovementComponent::EndNoHangTimer, 0.50f, false);
+	GetWorld()->GetTimerManager().SetTimer(NoHangTimerHandle, this, &UParkourMovementComponent::EndNoHangTimer, NoHangDuration, false);
 }
 
 void UParkourMovementComponent::EndNoHangTimer()
@@ -658,49 +778,96 @@ void UParkourMovementComponent::EndNoWallrunTimer()
 	//Empty by design
 }
 
-bool UParkourMovementComponent::TraceForBlockInDirection(TEnumAsByte<ETraceDirection> TraceDirection)
+FVector UParkourMovementComponent::GetDirectionTraceEnd(TEnumAsByte<ETraceDirection> TraceDirection) const
 {
 	FRotator TraceRotationOffset = TraceDirectionOffsets.FindRef(TraceDirection);
 	float TraceLength = (TraceDirection == TraceDirection_Up || TraceDirection_Down ? CapsuleHalfHeight + CapsuleRadius : CapsuleRadius * 7);
-	FVector TraceStart = GetOwner()->GetActorLocation();
+	return GetOwner()->GetActorLocation() + (GetOwner()->GetActorRotation() + TraceRotationOffset).RotateVector(FVector(TraceLength, 0, 0));
+}
+
+bool UParkourMovementComponent::TraceForBlockInDirection(TEnumAsByte<ETraceDirection> TraceDirection)
+{
 	FCollisionQueryParams TraceParams(FName(TEXT("")), false, GetOwner());
 	FHitResult OutputHitResult;
 	
 	GetWorld()->LineTraceSingleByObjectType(
 		OUT OutputHitResult,
-		TraceStart,
-		TraceStart + (GetOwner()->GetActorRotation() + TraceRotationOffset).RotateVector(FVector(TraceLength, 0, 0)),
+		GetOwner()->GetActorLocation(),
+		GetDirectionTraceEnd(TraceDirection),
 		ECollisionChannel::ECC_WorldStatic,
 		TraceParams
 	);
 
-	DirectionTraceHitResults.Add(TraceDirection, OutputHitResult);
+	ApplyDirectionTraceResult(TraceDirection, OutputHitResult);
 
 	return OutputHitResult.bBlockingHit;
-	
+}
 
+void UParkourMovementComponent::ApplyDirectionTraceResult(TEnumAsByte<ETraceDirection> TraceDirection, const FHitResult& HitResult)
+{
+	if (HitResult.bBlockingHit)
+	{
+		DirectionTraceHitResults.Add(TraceDirection, HitResult);
+		OnDirectionOverlap(TraceDirection);
+	}
+	else if (DirectionTraceHitResults.Contains(TraceDirection))
+	{
+		DirectionTraceHitResults.Remove(TraceDirection);
+		OnDirectionOverlapEnd(TraceDirection);
+	}
 }
 
 void UParkourMovementComponent::UpdateBlockedDirections()
 {
+	if (CurrentMovementState == ParkourState_Walk && TraceScheduler)
+	{
+		RequestBlockedDirections();
+		return;
+	}
+
+	if (TraceScheduler)
+	{
+		TraceScheduler->RecordImmediateTraces(TracePriority_High, ETraceDirection::MAX);
+	}
+
 	for (int DirectionIndex = 0; DirectionIndex < ETraceDirection::MAX; DirectionIndex++)
 	{
-		TEnumAsByte<ETraceDirection> TraceDirection = ETraceDirection(DirectionIndex);
-		if (TraceForBlockInDirection(TraceDirection))
-		{
-			OnDirectionOverlap(TraceDirection);
-		}
-		else
-		{
-			if (DirectionTraceHitResults.Contains(TraceDirection))
-			{
-				DirectionTraceHitResults.Remove(TraceDirection);
-				OnDirectionOverlapEnd(TraceDirection);
-			}
-		}
+		TraceForBlockInDirection(ETraceDirection(DirectionIndex));
+	}
+}
+
+void UParkourMovementComponent::RequestBlockedDirections()
+{
+	for (int DirectionIndex = 0; DirectionIndex < ETraceDirection::MAX; DirectionIndex++)
+	{
+		//The previous probe in this direction is still waiting for the budget
+		if (PendingDirectionRequests[DirectionIndex] != 0) { continue; }
+
+		FScheduledTraceRequest Request;
+		Request.Start = GetOwner()->GetActorLocation();
+		Request.End = GetDirectionTraceEnd(ETraceDirection(DirectionIndex));
+		Request.ObjectQueryParams = FCollisionObjectQueryParams(ECollisionChannel::ECC_WorldStatic);
+		Request.QueryParams = FCollisionQueryParams(FName(TEXT("")), false, GetOwner());
+		Request.Priority = TracePriority_Low;
+		Request.Requester = this;
+		Request.UserData = (uint32)DirectionIndex;
+		Request.Delegate.BindUObject(this, &UParkourMovementComponent::OnDirectionTraceDone);
+		PendingDirectionRequests[DirectionIndex] = TraceScheduler->SubmitTrace(Request);
 	}
 }
 
+void UParkourMovementComponent::OnDirectionTraceDone(const FScheduledTraceResult& Result)
+{
+	const int32 DirectionIndex = (int32)Result.UserData;
+	if (DirectionIndex >= ETraceDirection::MAX || PendingDirectionRequests[DirectionIndex] != Result.RequestId) { return; }
+	PendingDirectionRequests[DirectionIndex] = 0;
+
+	//Once the player left the walk state the immediate traces are in charge, so a late result would only overwrite a newer one
+	if (CurrentMovementState != ParkourState_Walk) { return; }
+
+	ApplyDirectionTraceResult(ETraceDirection(DirectionIndex), Result.HitResult);
+}
+
 void UParkourMovementComponent::OnDirectionOverlap(TEnumAsByte<ETraceDirection> TraceDirection)
 {
 	switch (TraceDirection) {
@@ -745,6 +912,10 @@ void UParkourMovementComponent::OnDirectionOverlapEnd(TEnumAsByte<ETraceDirectio
 
 void UParkourMovementComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+	if (TraceScheduler)
+	{
+		TraceScheduler->CancelRequests(this);
+	}
 	Super::EndPlay(EndPlayReason);
 	GetWorld()->GetTimerManager().ClearAllTimersForObject(this);
 }
@@ -799,9 +970,67 @@ bool UParkourMovementComponent::CanAttemptJump() const
 void UParkourMovementComponent::Lunge()
 {
 	FRotator CurrentRotation = PawnOwner->GetControlRotation();
-	FRotator ClampedRotation = FRotator(FMath::Clamp(CurrentRotation.Pitch, -30.f, 5.f), CurrentRotation.Yaw, CurrentRotation.Roll);
-	Velocity = ClampedRotation.RotateVector(FVector(1000.0, 0, FMath::Max(Velocity.Z, (JumpZVelocity * 0.5f))));
+	FRotator ClampedRotation = FRotator(FMath::Clamp(CurrentRotation.Pitch, LungeMinPitch, LungeMaxPitch), CurrentRotation.Yaw, CurrentRotation.Roll);
+	Velocity = ClampedRotation.RotateVector(FVector(LungeForwardSpeed, 0, FMath::Max(Velocity.Z, (JumpZVelocity * 0.5f))));
+}
+
+FParkourSimulationParameters UParkourMovementComponent::GetSimulationParameters(float InCapsuleRadius, float InCapsuleHalfHeight) const
+{
+	FParkourSimulationParameters Parameters;
+	//Class default objects have no world to ask for the gravity, so the project default is used for them
+	Parameters.GravityZ = GetWorld() ? GetGravityZ() : UPhysicsSettings::Get()->DefaultGravityZ * GravityScale;
+	Parameters.JumpZVelocity = JumpZVelocity;
+	Parameters.MaxWalkSpeed = MaxWalkSpeed;
+	Parameters.MaxWalkSpeedCrouched = MaxWalkSpeedCrouched;
+	Parameters.MaxStepHeight = MaxStepHeight;
+	Parameters.WalkableFloorZ = GetWalkableFloorZ();
+	Parameters.MinSlideSpeed = MinSlideSpeed;
+	Parameters.SlideForce = SlideForce;
+	Parameters.MinTuckJumpSpeed = MinTuckJumpSpeed;
+	Parameters.TuckJumpForwardForce = TuckJumpForwardForce;
+	Parameters.LungeForwardSpeed = LungeForwardSpeed;
+	Parameters.LungeMinPitch = LungeMinPitch;
+	Parameters.LungeMaxPitch = LungeMaxPitch;
+	Parameters.WallrunForwardSpeed = WallrunForwardSpeed;
+	Parameters.WallrunSideSpeed = WallrunSideSpeed;
+	Parameters.WallrunMaxHeightGain = WallrunMaxHeightGain;
+	Parameters.MaxWallrunTime = MaxWallrunTime;
+	Parameters.NoHangDuration = NoHangDuration;
+	Parameters.HandSize = HandSize;
+	Parameters.GrabHeight = GrabHeight;
+	Parameters.GrabbingReach = GrabbingReach;
+	Parameters.AttachHeight = AttachHeight;
+	Parameters.CapsuleRadius = InCapsuleRadius;
+	Parameters.CapsuleHalfHeight = InCapsuleHalfHeight;
+
+	//A live component knows the real size of its owner's capsule
+	if (CharacterOwner && CharacterOwner->GetCapsuleComponent())
+	{
+		CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleSize(OUT Parameters.CapsuleRadius, OUT Parameters.CapsuleHalfHeight);
+	}
+	Parameters.AttachDistance = Parameters.CapsuleRadius + AttachWallGap;
+	return Parameters;
+}
+
+void UParkourMovementComponent::RefreshSimulationParameters()
+{
+	SimulationParameters = GetSimulationParameters(CapsuleRadius, CapsuleHalfHeight);
+}
+
+void UParkourMovementComponent::PhysicsVolumeChanged(APhysicsVolume* NewVolume)
+{
+	Super::PhysicsVolumeChanged(NewVolume);
+	//The gravity of the parameters comes from the physics volume
+	RefreshSimulationParameters();
+}
+
+#if WITH_EDITOR
+void UParkourMovementComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	RefreshSimulationParameters();
 }
+#endif
 
 bool UParkourMovementComponent::IsFullfillingWallrunConditions()
 {
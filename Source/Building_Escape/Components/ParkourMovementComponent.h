@@ -11,6 +11,9 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FGrabStateChangedDelegate, bool, bNe
 
 class UBoxComponent;
 class UCapsuleComponent;
+class UTraceSchedulerSubsystem;
+class UGameplayEventBusSubsystem;
+struct FScheduledTraceResult;
 
 //Enumarator that signifies the current state of hanging; used only internally
 enum EHangingState
@@ -43,6 +46,36 @@ enum EParkourMovementState
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FParkourMovementStateChangedSignature, TEnumAsByte<EParkourMovementState>, PrevParkourState, TEnumAsByte<EParkourMovementState>, NewParkourState);
 
+//Snapshot of every value that shapes the reach of the parkour moves; used by offline tools(e.g. the reachability commandlet) so they simulate with exactly the same rules as the component
+struct FParkourSimulationParameters
+{
+	float GravityZ;
+	float JumpZVelocity;
+	float MaxWalkSpeed;
+	float MaxWalkSpeedCrouched;
+	float MaxStepHeight;
+	float WalkableFloorZ;
+	float MinSlideSpeed;
+	float SlideForce;
+	float MinTuckJumpSpeed;
+	float TuckJumpForwardForce;
+	float LungeForwardSpeed;
+	float LungeMinPitch;
+	float LungeMaxPitch;
+	float WallrunForwardSpeed;
+	float WallrunSideSpeed;
+	float WallrunMaxHeightGain;
+	float MaxWallrunTime;
+	float NoHangDuration;
+	FVector HandSize;
+	float GrabHeight;
+	float GrabbingReach;
+	float AttachHeight;
+	float AttachDistance;
+	float CapsuleRadius;
+	float CapsuleHalfHeight;
+};
+
 //Enumerator identify directions relative to the player; used only internally
 enum ETraceDirection
 {
@@ -60,6 +93,10 @@ class BUILDING_ESCAPE_API UParkourMovementComponent : public UCharacterMovementC
 {
 	GENERATED_BODY()
 
+	//Bridge the events of the gameplay event bus to the Blueprint delegates below
+	friend struct FParkourStateEvent;
+	friend struct FHangingStateEvent;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -77,8 +114,13 @@ public:
 	virtual bool IsMovingOnGround() const override;
 	virtual bool IsCrouching() const override;
 	virtual bool CanCrouchInCurrentState() const override;
+	virtual void PhysicsVolumeChanged(class APhysicsVolume* NewVolume) override;
 	//END UCharacterMovementComponent Interface
 
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
 
 	UFUNCTION(BlueprintPure)
 	TEnumAsByte<EParkourMovementState> GetMovementState();
@@ -90,6 +132,18 @@ public:
 	void AttemptCrouch();
 	void AttemptUnCrouch();
 
+	//Gathers the movement rules into a single struct. Capsule dimensions are taken from the owner if there is one, otherwise the values passed in are used(e.g. when reading a class default object)
+	FParkourSimulationParameters GetSimulationParameters(float InCapsuleRadius, float InCapsuleHalfHeight) const;
+	//Rebuilds the parameters cached for the hang tests. Called on BeginPlay, when crouching changes the capsule and when the physics volume changes the gravity; call it after changing a movement value at runtime
+	void RefreshSimulationParameters();
+
+	// Stateless version of the hang test, shared by the component and by offline tools. Performs several traces that verify if the location and rotation passed can be projected to a fully valid hanging spot. The out parameters are only assigned when the function returns true
+	static bool TestHangPoint(const UWorld* World, const FParkourSimulationParameters& Parameters, const FCollisionQueryParams& TraceParams, OUT FVector& OutHangLocation, OUT FRotator& OutHangRotation, FVector InOriginLocation, FRotator InOriginRotation);
+
+	//Writes or reads the pawn's transform, view, velocity and parkour state for the checkpoint subsystem.
+	//Moves that depend on the geometry and timers of the moment(hanging, wallrunning, sliding) aren't resumed; the pawn continues in the basic state of its movement mode
+	void SerializeCheckpoint(FArchive& Ar);
+
 private:
 
 // Parameters that define the rules of testing hangability and attachment. Values can be overriden from blueprint through an appropriate function	
@@ -103,11 +157,16 @@ private:
 	float AttachHeight;
 	// Forward distance between the player pivot and the wall the player is hanging on
 	float AttachDistance;
+	// Gap left between the capsule and the wall while hanging; AttachDistance is the capsule radius extended by this value
+	float AttachWallGap;
 
 	// Dimensions of the player capsule; set in BeginPlay
 	float CapsuleRadius;
 	float CapsuleHalfHeight;
 
+	// Result of GetSimulationParameters kept for the hang tests, so they don't gather it on every call; rebuilt by RefreshSimulationParameters
+	FParkourSimulationParameters SimulationParameters;
+
 //Begin Hang system
 //Internal variables
 	// Enumerators that store the current status of horizontal edges(extremes of the wall that the player is currently hanging on) that decide in which way the edges will be interacted with(block or corner transition)
@@ -191,6 +250,27 @@ private:
 	UPROPERTY(EditAnywhere)
 	float SlideDuration = 1.f;
 
+	//Forward speed of the lunge performed when jumping off a wall or a ledge; the pitch of the control rotation is clamped between LungeMinPitch and LungeMaxPitch
+	UPROPERTY(EditAnywhere)
+	float LungeForwardSpeed = 1000.f;
+
+	UPROPERTY(EditAnywhere)
+	float LungeMinPitch = -30.f;
+
+	UPROPERTY(EditAnywhere)
+	float LungeMaxPitch = 5.f;
+
+	//Velocity applied along the wall and towards the wall while wallrunning
+	UPROPERTY(EditAnywhere)
+	float WallrunForwardSpeed = 1200.f;
+
+	UPROPERTY(EditAnywhere)
+	float WallrunSideSpeed = 200.f;
+
+	//Maximum height above the jump off point that can be gained while wallrunning
+	UPROPERTY(EditAnywhere)
+	float WallrunMaxHeightGain = 300.f;
+
 	//Spawned colliders that act as triggers for corner transitions are all bound to this function; Differentation between the left and right collider is handled inside the implementation
 	UFUNCTION()
 	void EdgeOverlapBegin(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
@@ -205,7 +285,10 @@ private:
 	bool GetIsTouchingLeftWall();
 
 	UPROPERTY(EditAnywhere)
-	float MaxWallrunTime; // Duration of WallrunTimerHandle
+	float MaxWallrunTime = 2.f; // Duration of WallrunTimerHandle
+
+	UPROPERTY(EditAnywhere)
+	float NoHangDuration = 0.5f; // Duration of NoHangTimerHandle
 
 	//UCharacterMovementComponent overrides
 	virtual void Crouch(bool bClientSimulation = false) override;
@@ -231,6 +314,21 @@ private:
 	void UpdateBlockedDirections();
 	//Returns if a trace in given direction results in overlap; used inside the function above
 	bool TraceForBlockInDirection(TEnumAsByte<ETraceDirection> TraceDirection);
+	FVector GetDirectionTraceEnd(TEnumAsByte<ETraceDirection> TraceDirection) const;
+	//Stores the result of a direction trace and triggers the overlap functions below if the direction got blocked or free
+	void ApplyDirectionTraceResult(TEnumAsByte<ETraceDirection> TraceDirection, const FHitResult& HitResult);
+
+	//While walking the direction traces only prepare the wallrun checks, so they go through the trace scheduler with low priority and their results arrive a few frames later.
+	//The other states need them right away; those traces and the hang tests are run immediately and only reported to the scheduler
+	UTraceSchedulerSubsystem* TraceScheduler = nullptr;
+
+	//State changes are posted to the gameplay event bus, which merges them over the frame and only reaches the Blueprint delegates if they are bound
+	UGameplayEventBusSubsystem* EventBus = nullptr;
+	void PostParkourStateChanged(TEnumAsByte<EParkourMovementState> PrevState, TEnumAsByte<EParkourMovementState> NewState);
+	void PostHangingStateChanged(bool bIsHanging);
+	uint32 PendingDirectionRequests[ETraceDirection::MAX] = {};
+	void RequestBlockedDirections();
+	void OnDirectionTraceDone(const FScheduledTraceResult& Result);
 	//Map of rotation offsets, set once in BeginPlay
 	TMap<TEnumAsByte<ETraceDirection>, FRotator> TraceDirectionOffsets;
 	//Map containing the last result of traces done by UpdateBlockedDirections();
@@ -0,0 +1,390 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "PhysicsPropComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/NetSerialization.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/UnrealNetwork.h"
+#include "Subsystems/PhysicsPropSleepSubsystem.h"
+
+namespace
+{
+	//Matches the precision of SerializePackedVector<10, 24>
+	const float VectorQuantum = 0.1f;
+
+	bool QuantizedVectorsEqual(const FVector& A, const FVector& B)
+	{
+		return (A - B).GetAbsMax() < VectorQuantum / 2;
+	}
+
+	bool QuantizedRotatorsEqual(const FRotator& A, const FRotator& B)
+	{
+		return FRotator::CompressAxisToShort(A.Pitch) == FRotator::CompressAxisToShort(B.Pitch)
+			&& FRotator::CompressAxisToShort(A.Yaw) == FRotator::CompressAxisToShort(B.Yaw)
+			&& FRotator::CompressAxisToShort(A.Roll) == FRotator::CompressAxisToShort(B.Roll);
+	}
+}
+
+bool FPhysicsPropState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	enum
+	{
+		Flag_Asleep = 1,
+		Flag_LinearVelocity = 2,
+		Flag_AngularVelocity = 4,
+	};
+
+	uint8 Flags = 0;
+	if (Ar.IsSaving())
+	{
+		Flags |= bIsAsleep ? Flag_Asleep : 0;
+		Flags |= !LinearVelocity.IsNearlyZero(VectorQuantum / 2) ? Flag_LinearVelocity : 0;
+		Flags |= !AngularVelocity.IsNearlyZero(VectorQuantum / 2) ? Flag_AngularVelocity : 0;
+	}
+	Ar.SerializeBits(&Flags, 3);
+	bIsAsleep = (Flags & Flag_Asleep) != 0;
+
+	bOutSuccess = SerializePackedVector<10, 24>(Location, Ar);
+	Rotation.SerializeCompressedShort(Ar);
+
+	if (Flags & Flag_LinearVelocity)
+	{
+		bOutSuccess &= SerializePackedVector<10, 24>(LinearVelocity, Ar);
+	}
+	else if (Ar.IsLoading())
+	{
+		LinearVelocity = FVector::ZeroVector;
+	}
+
+	if (Flags & Flag_AngularVelocity)
+	{
+		bOutSuccess &= SerializePackedVector<10, 24>(AngularVelocity, Ar);
+	}
+	else if (Ar.IsLoading())
+	{
+		AngularVelocity = FVector::ZeroVector;
+	}
+
+	Ar << ServerTime;
+	return true;
+}
+
+bool FPhysicsPropState::QuantizesEqual(const FPhysicsPropState& Other) const
+{
+	return bIsAsleep == Other.bIsAsleep
+		&& QuantizedVectorsEqual(Location, Other.Location)
+		&& QuantizedRotatorsEqual(Rotation, Other.Rotation)
+		&& QuantizedVectorsEqual(LinearVelocity, Other.LinearVelocity)
+		&& QuantizedVectorsEqual(AngularVelocity, Other.AngularVelocity);
+}
+
+UPhysicsPropComponent::UPhysicsPropComponent()
+{
+	//Only awake props tick on the server, and only props with states left to follow on the clients
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UPhysicsPropComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UPhysicsPropComponent, ReplicatedState);
+}
+
+UPhysicsPropComponent* UPhysicsPropComponent::FindOrAddTo(AActor* Actor)
+{
+	if (!Actor)
+	{
+		return nullptr;
+	}
+
+	UPhysicsPropComponent* PhysicsProp = Actor->FindComponentByClass<UPhysicsPropComponent>();
+	if (!PhysicsProp && Actor->GetNetMode() != NM_Client)
+	{
+		PhysicsProp = NewObject<UPhysicsPropComponent>(Actor, TEXT("PhysicsProp"));
+		PhysicsProp->RegisterComponent();
+	}
+	return PhysicsProp;
+}
+
+void UPhysicsPropComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	//The root is the body in most props; otherwise the first simulating primitive is
+	Body = Cast<UPrimitiveComponent>(GetOwner()->GetRootComponent());
+	if (!Body || !Body->IsSimulatingPhysics())
+	{
+		Body = nullptr;
+		TInlineComponentArray<UPrimitiveComponent*> Primitives(GetOwner());
+		for (UPrimitiveComponent* Primitive : Primitives)
+		{
+			if (Primitive->IsSimulatingPhysics())
+			{
+				Body = Primitive;
+				break;
+			}
+		}
+	}
+	if (!Body)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Physics prop component on %s found no simulating body and won't replicate anything!"), *GetOwner()->GetName());
+		return;
+	}
+
+	if (GetNetMode() == NM_Client)
+	{
+		//Clients only follow the server's states, so their copy of the body doesn't simulate unless they hold it
+		Body->SetSimulatePhysics(false);
+		return;
+	}
+
+	//The states replace the actor's own movement replication
+	GetOwner()->SetReplicates(true);
+	GetOwner()->SetReplicateMovement(false);
+
+	//Sleep and wake notifications are only generated for bodies created with them enabled
+	if (!Body->BodyInstance.bGenerateWakeEvents)
+	{
+		Body->BodyInstance.bGenerateWakeEvents = true;
+		Body->RecreatePhysicsState();
+	}
+	Body->OnComponentWake.AddDynamic(this, &UPhysicsPropComponent::OnBodyWake);
+	Body->OnComponentSleep.AddDynamic(this, &UPhysicsPropComponent::OnBodySleep);
+
+	bIsAwake = true;
+	SetAwake(Body->RigidBodyIsAwake());
+
+	if (UPhysicsPropSleepSubsystem* SleepSubsystem = GetWorld()->GetSubsystem<UPhysicsPropSleepSubsystem>())
+	{
+		SleepSubsystem->RegisterBody(Body);
+	}
+}
+
+void UPhysicsPropComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Body)
+	{
+		if (UPhysicsPropSleepSubsystem* SleepSubsystem = GetWorld()->GetSubsystem<UPhysicsPropSleepSubsystem>())
+		{
+			SleepSubsystem->UnregisterBody(Body);
+		}
+		Body->OnComponentWake.RemoveDynamic(this, &UPhysicsPropComponent::OnBodyWake);
+		Body->OnComponentSleep.RemoveDynamic(this, &UPhysicsPropComponent::OnBodySleep);
+	}
+	Snapshots.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UPhysicsPropComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!Body)
+	{
+		return;
+	}
+
+	if (GetNetMode() == NM_Client)
+	{
+		FollowSnapshots();
+	}
+	else
+	{
+		UpdateReplicatedState();
+	}
+}
+
+FPhysicsPropState UPhysicsPropComponent::CaptureState() const
+{
+	FPhysicsPropState State;
+	if (Body)
+	{
+		State.Location = Body->GetComponentLocation();
+		State.Rotation = Body->GetComponentRotation();
+		State.LinearVelocity = Body->GetPhysicsLinearVelocity();
+		State.AngularVelocity = Body->GetPhysicsAngularVelocityInDegrees();
+		State.bIsAsleep = !Body->RigidBodyIsAwake();
+	}
+	State.ServerTime = GetServerTime();
+	return State;
+}
+
+float UPhysicsPropComponent::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+void UPhysicsPropComponent::UpdateReplicatedState()
+{
+	//States that quantize the same as the last one would send nothing new, so the property is left untouched and isn't even compared as changed
+	FPhysicsPropState NewState = CaptureState();
+	NewState.bIsAsleep = !bIsAwake && !Holder;
+	if (!NewState.QuantizesEqual(ReplicatedState))
+	{
+		ReplicatedState = NewState;
+	}
+}
+
+void UPhysicsPropComponent::SetAwake(bool bNewIsAwake)
+{
+	const bool bWasAwake = bIsAwake;
+	bIsAwake = bNewIsAwake;
+	SetComponentTickEnabled(bIsAwake || Holder);
+	GetOwner()->NetUpdateFrequency = Holder ? HeldNetUpdateFrequency : MovingNetUpdateFrequency;
+
+	if (bIsAwake || Holder)
+	{
+		if (GetOwner()->NetDormancy != DORM_Awake)
+		{
+			GetOwner()->SetNetDormancy(DORM_Awake);
+		}
+	}
+	else if (bWasAwake)
+	{
+		//The resting state is still sent before the channel goes dormant
+		UpdateReplicatedState();
+		GetOwner()->SetNetDormancy(DORM_DormantAll);
+	}
+}
+
+void UPhysicsPropComponent::OnCheckpointRestored()
+{
+	if (!Body || GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	//Teleporting a sleeping body fires no wake event, so the dormant channel has to be flushed for the clients to see the move
+	GetOwner()->FlushNetDormancy();
+	UpdateReplicatedState();
+}
+
+void UPhysicsPropComponent::OnBodyWake(UPrimitiveComponent* WakingComponent, FName BoneName)
+{
+	SetAwake(true);
+}
+
+void UPhysicsPropComponent::OnBodySleep(UPrimitiveComponent* SleepingComponent, FName BoneName)
+{
+	SetAwake(false);
+}
+
+void UPhysicsPropComponent::SetHolder(UInteractor* NewHolder)
+{
+	Holder = NewHolder;
+	if (Body && Holder)
+	{
+		Body->WakeAllRigidBodies();
+	}
+	SetAwake(Body && Body->RigidBodyIsAwake());
+}
+
+void UPhysicsPropComponent::ApplyHolderState(const FPhysicsPropState& State)
+{
+	if (!Body)
+	{
+		return;
+	}
+
+	Body->SetWorldLocationAndRotation(State.Location, State.Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	Body->SetPhysicsLinearVelocity(State.LinearVelocity);
+	Body->SetPhysicsAngularVelocityInDegrees(State.AngularVelocity);
+}
+
+void UPhysicsPropComponent::BeginLocalHold()
+{
+	bIsLocallyHeld = true;
+	if (Body && GetNetMode() == NM_Client)
+	{
+		Snapshots.Reset();
+		SetComponentTickEnabled(false);
+		Body->SetSimulatePhysics(true);
+	}
+}
+
+void UPhysicsPropComponent::EndLocalHold()
+{
+	bIsLocallyHeld = false;
+	if (Body && GetNetMode() == NM_Client)
+	{
+		Body->SetSimulatePhysics(false);
+	}
+}
+
+void UPhysicsPropComponent::OnRep_ReplicatedState()
+{
+	if (bIsLocallyHeld || !Body)
+	{
+		return;
+	}
+
+	//States can't arrive out of order through property replication, but a newer server time is still required so a duplicate can't stall the buffer
+	if (Snapshots.Num() > 0 && ReplicatedState.ServerTime <= Snapshots.Last().ServerTime)
+	{
+		return;
+	}
+
+	//A prop waking up after a long rest starts moving from where it rested, one interpolation step before its first new state
+	if (Snapshots.Num() > 0 && Snapshots.Last().bIsAsleep)
+	{
+		FPhysicsPropState RestingState = Snapshots.Last();
+		RestingState.ServerTime = FMath::Max(RestingState.ServerTime, ReplicatedState.ServerTime - 1.f / MovingNetUpdateFrequency);
+		Snapshots.Reset();
+		Snapshots.Add(RestingState);
+	}
+
+	if (Snapshots.Num() == Snapshots.Max())
+	{
+		Snapshots.RemoveAt(0, 1, false);
+	}
+	Snapshots.Add(ReplicatedState);
+	SetComponentTickEnabled(true);
+}
+
+void UPhysicsPropComponent::FollowSnapshots()
+{
+	if (Snapshots.Num() == 0)
+	{
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	//Everything older than the pair around the render time is dropped
+	const float RenderTime = GetServerTime() - InterpolationDelay;
+	while (Snapshots.Num() >= 2 && Snapshots[1].ServerTime <= RenderTime)
+	{
+		Snapshots.RemoveAt(0, 1, false);
+	}
+
+	const FPhysicsPropState& From = Snapshots[0];
+	FVector Location;
+	FQuat Rotation;
+	if (Snapshots.Num() >= 2)
+	{
+		const FPhysicsPropState& To = Snapshots[1];
+		const float Alpha = FMath::Clamp((RenderTime - From.ServerTime) / FMath::Max(To.ServerTime - From.ServerTime, KINDA_SMALL_NUMBER), 0.f, 1.f);
+		Location = FMath::Lerp(From.Location, To.Location, Alpha);
+		Rotation = FQuat::Slerp(From.Rotation.Quaternion(), To.Rotation.Quaternion(), Alpha);
+	}
+	else
+	{
+		//Past the newest state the prop keeps its velocity for a moment; resting props and props that ran out of extrapolation stop until the next state arrives
+		const float Extrapolation = From.bIsAsleep ? 0.f : FMath::Clamp(RenderTime - From.ServerTime, 0.f, MaxExtrapolation);
+		Location = From.Location + From.LinearVelocity * Extrapolation;
+		Rotation = From.Rotation.Quaternion();
+		if (From.bIsAsleep || RenderTime - From.ServerTime >= MaxExtrapolation)
+		{
+			SetComponentTickEnabled(false);
+		}
+	}
+
+	Body->SetWorldLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+}
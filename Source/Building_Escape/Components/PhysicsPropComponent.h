@@ -0,0 +1,135 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "PhysicsPropComponent.generated.h"
+
+class UInteractor;
+class UPrimitiveComponent;
+
+//Transform and velocities of a physics prop as they are sent over the network. Positions and velocities are quantized to a tenth of a unit and the rotation to 16 bits per axis;
+//velocities are left out entirely when they are zero, which is always the case for resting props
+USTRUCT()
+struct FPhysicsPropState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector Location = FVector::ZeroVector;
+
+	UPROPERTY()
+	FRotator Rotation = FRotator::ZeroRotator;
+
+	UPROPERTY()
+	FVector LinearVelocity = FVector::ZeroVector;
+
+	//In degrees per second
+	UPROPERTY()
+	FVector AngularVelocity = FVector::ZeroVector;
+
+	//Server world time the state was captured at; orders the states in the clients' interpolation buffer
+	UPROPERTY()
+	float ServerTime = 0.f;
+
+	UPROPERTY()
+	bool bIsAsleep = false;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	//True if both states quantize to the same values, in which case sending the new one would change nothing on the clients
+	bool QuantizesEqual(const FPhysicsPropState& Other) const;
+};
+
+template<>
+struct TStructOpsTypeTraits<FPhysicsPropState> : public TStructOpsTypeTraitsBase2<FPhysicsPropState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+/**
+ * Replicates the simulated body of a prop(holdables, weights for mass tresholds) with compact, quantized states instead of the actor's movement replication.
+ * The server only sends a new state when the quantized one changed, at a high rate while the prop is held and at a lower one while it moves on its own;
+ * once the body falls asleep the last state is sent and the actor goes dormant until the body is woken up again.
+ * Props held by a client are simulated by that client, which sends its states to the server through its interactor. Every other client follows the states
+ * through a short interpolation buffer, with the body kinematic, so late or bunched up updates don't make it jitter.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class BUILDING_ESCAPE_API UPhysicsPropComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UPhysicsPropComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	//Adds the component to actors that don't have one yet; only on the server, the clients get it through replication
+	static UPhysicsPropComponent* FindOrAddTo(AActor* Actor);
+
+	UPrimitiveComponent* GetBody() const { return Body; }
+	FPhysicsPropState CaptureState() const;
+
+	//Called on the server when a player starts or stops holding the prop; a client holder also drives the body through ApplyHolderState
+	void SetHolder(UInteractor* NewHolder);
+	UInteractor* GetHolder() const { return Holder; }
+	void ApplyHolderState(const FPhysicsPropState& State);
+
+	//Called on the machine of the holding player; replicated states are ignored while the prop is held locally
+	void BeginLocalHold();
+	void EndLocalHold();
+
+	//Called on the server after a checkpoint moved the body; sends its new state even if the body stayed asleep and the actor dormant
+	void OnCheckpointRestored();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UPROPERTY()
+	UPrimitiveComponent* Body = nullptr;
+	UPROPERTY()
+	UInteractor* Holder = nullptr;
+	bool bIsLocallyHeld = false;
+
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedState)
+	FPhysicsPropState ReplicatedState;
+	UFUNCTION()
+	void OnRep_ReplicatedState();
+
+	//Server
+	void UpdateReplicatedState();
+	void SetAwake(bool bNewIsAwake);
+	bool bIsAwake = false;
+	UFUNCTION()
+	void OnBodyWake(UPrimitiveComponent* WakingComponent, FName BoneName);
+	UFUNCTION()
+	void OnBodySleep(UPrimitiveComponent* SleepingComponent, FName BoneName);
+
+	//Clients; the buffer holds the latest states in the order of their server time
+	TArray<FPhysicsPropState, TInlineAllocator<6>> Snapshots;
+	void FollowSnapshots();
+	float GetServerTime() const;
+
+	//Updates per second sent while the prop is held
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float HeldNetUpdateFrequency = 30.f;
+
+	//Updates per second sent while the prop moves on its own
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float MovingNetUpdateFrequency = 10.f;
+
+	//Clients show the prop this many seconds in the past, so there is usually a newer state to interpolate towards
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float InterpolationDelay = 0.1f;
+
+	//How far past the newest state clients extrapolate with its velocity before they stop and wait
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float MaxExtrapolation = 0.15f;
+};
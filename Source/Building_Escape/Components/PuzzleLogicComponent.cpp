@@ -0,0 +1,148 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "PuzzleLogicComponent.h"
+#include "Components/Interactable.h"
+#include "Components/MassTreshold.h"
+#include "Components/OpenDoor.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Net/UnrealNetwork.h"
+#include "Subsystems/PuzzleLogicSubsystem.h"
+#include "TimerManager.h"
+
+UPuzzleLogicComponent::UPuzzleLogicComponent()
+{
+	//Nodes are evaluated by the subsystem, so they never tick on their own
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UPuzzleLogicComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UPuzzleLogicComponent, bOutput);
+}
+
+void UPuzzleLogicComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (Operation == PuzzleLogic_Plate)
+	{
+		SignalSource = GetOwner()->FindComponentByClass<UMassTreshold>();
+	}
+	else if (Operation == PuzzleLogic_Interaction)
+	{
+		SignalSource = GetOwner()->FindComponentByClass<UInteractable>();
+	}
+	if ((Operation == PuzzleLogic_Plate || Operation == PuzzleLogic_Interaction) && !SignalSource)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Puzzle logic component %s on %s has nothing to take its signal from!"), *GetName(), *GetOwner()->GetName());
+	}
+
+	if (bIsSink)
+	{
+		GetOwner()->GetComponents<UOpenDoor>(OUT Doors);
+		GetOwner()->GetComponents<UInteractable>(OUT Interactables);
+	}
+
+	//Only the outputs of sinks matter to the clients; the rest of the graph stays on the server
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		SetIsReplicated(bIsSink);
+		if (bIsSink)
+		{
+			GetOwner()->SetReplicates(true);
+		}
+	}
+
+	if (UPuzzleLogicSubsystem* PuzzleLogic = GetWorld()->GetSubsystem<UPuzzleLogicSubsystem>())
+	{
+		PuzzleLogic->RegisterNode(this);
+	}
+
+	//An output replicated before play began couldn't be applied yet
+	if (GetOwnerRole() != ROLE_Authority && bIsSink && bOutput)
+	{
+		ApplyOutput();
+	}
+}
+
+void UPuzzleLogicComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPuzzleLogicSubsystem* PuzzleLogic = GetWorld()->GetSubsystem<UPuzzleLogicSubsystem>())
+	{
+		PuzzleLogic->UnregisterNode(this);
+	}
+	GetWorld()->GetTimerManager().ClearTimer(DelayTimer);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UPuzzleLogicComponent::SetSignal(bool bNewSignal)
+{
+	if (Operation != PuzzleLogic_Signal)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("SetSignal was called on puzzle logic component %s on %s, which isn't a Signal node."), *GetName(), *GetOwner()->GetName());
+		return;
+	}
+
+	if (UPuzzleLogicSubsystem* PuzzleLogic = GetWorld()->GetSubsystem<UPuzzleLogicSubsystem>())
+	{
+		PuzzleLogic->SetSignal(this, bNewSignal);
+	}
+}
+
+bool UPuzzleLogicComponent::GetOutput() const
+{
+	return bOutput;
+}
+
+void UPuzzleLogicComponent::SerializeCheckpoint(FArchive& Ar)
+{
+	uint8 Flags = (bSignal ? 1 : 0) | (bOutput ? 2 : 0);
+	//Negative while no delay is running
+	float DelayRemaining = GetWorld()->GetTimerManager().IsTimerActive(DelayTimer) ? GetWorld()->GetTimerManager().GetTimerRemaining(DelayTimer) : -1.f;
+	Ar << Flags;
+	Ar << DelayRemaining;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	bSignal = (Flags & 1) != 0;
+	bOutput = (Flags & 2) != 0;
+	if (UPuzzleLogicSubsystem* PuzzleLogic = GetWorld()->GetSubsystem<UPuzzleLogicSubsystem>())
+	{
+		PuzzleLogic->RefreshNode(this, DelayRemaining);
+	}
+}
+
+void UPuzzleLogicComponent::OnRep_Output()
+{
+	if (HasBegunPlay())
+	{
+		ApplyOutput();
+	}
+}
+
+void UPuzzleLogicComponent::ApplyOutput()
+{
+	bHasAppliedOutput = true;
+	for (UOpenDoor* Door : Doors)
+	{
+		if (Door) { Door->ToggleShouldBeOpened(bOutput); }
+	}
+	for (UInteractable* Interactable : Interactables)
+	{
+		if (Interactable) { Interactable->ToggleActivity(bOutput); }
+	}
+
+	if (OutputChanged.IsBound())
+	{
+		OutputChanged.Broadcast(bOutput);
+	}
+}
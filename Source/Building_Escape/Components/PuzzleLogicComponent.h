@@ -0,0 +1,106 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "PuzzleLogicComponent.generated.h"
+
+class UOpenDoor;
+class UInteractable;
+
+UENUM(BlueprintType)
+enum EPuzzleLogicOperation
+{
+	//Set from Blueprint through SetSignal
+	PuzzleLogic_Signal   UMETA(DisplayName = "Signal"),
+	//Follows the mass treshold of the owner
+	PuzzleLogic_Plate   UMETA(DisplayName = "Plate"),
+	//Follows the interactable of the owner; Use interactables toggle it, Hold interactables hold it on
+	PuzzleLogic_Interaction   UMETA(DisplayName = "Interaction"),
+	PuzzleLogic_And   UMETA(DisplayName = "And"),
+	PuzzleLogic_Or   UMETA(DisplayName = "Or"),
+	//Like Or, but only takes over the result once it stayed the same for the delay
+	PuzzleLogic_Delay   UMETA(DisplayName = "Delay"),
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FPuzzleLogicOutputDelegate, bool, bNewOutput);
+
+/**
+ * A single node of the puzzle logic graph. Signals(plates, interactables, Blueprint) feed gates whose inputs are other actors with a puzzle logic component,
+ * and sinks apply their output to the doors and interactables of their owner. The graph is compiled and evaluated by the puzzle logic subsystem on the server;
+ * only the outputs of sinks are replicated, everything else exists only inside the compiled graph.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class BUILDING_ESCAPE_API UPuzzleLogicComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+	friend class UPuzzleLogicSubsystem;
+
+public:
+	UPuzzleLogicComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	//Only used by Signal nodes; the graph picks the change up within the frame
+	UFUNCTION(BlueprintCallable, Category = "Puzzle Logic")
+	void SetSignal(bool bNewSignal);
+
+	UFUNCTION(BlueprintPure, Category = "Puzzle Logic")
+	bool GetOutput() const;
+
+	//Broadcast on the server and the clients whenever the output of a sink changes
+	UPROPERTY(BlueprintAssignable)
+	FPuzzleLogicOutputDelegate OutputChanged;
+
+	TEnumAsByte<EPuzzleLogicOperation> GetOperation() const { return Operation; }
+	bool IsSink() const { return bIsSink; }
+	//The mass treshold or interactable Plate and Interaction nodes follow
+	UObject* GetSignalSource() const { return SignalSource; }
+
+	//Writes or reads the signal, the output and the time left of a running delay for the checkpoint subsystem. A loaded sink neither applies its output again
+	//nor broadcasts OutputChanged; its doors and interactables are restored on their own
+	void SerializeCheckpoint(FArchive& Ar);
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UPROPERTY(EditAnywhere, Category = "Puzzle Logic")
+	TEnumAsByte<EPuzzleLogicOperation> Operation = PuzzleLogic_Or;
+
+	//Actors whose puzzle logic component feeds this node; ignored by signals
+	UPROPERTY(EditInstanceOnly, Category = "Puzzle Logic")
+	TArray<AActor*> Inputs;
+
+	UPROPERTY(EditAnywhere, Category = "Puzzle Logic")
+	bool bInvertOutput = false;
+
+	UPROPERTY(EditAnywhere, Category = "Puzzle Logic")
+	float Delay = 1.f;
+
+	//Sinks open the doors of their owner and toggle the activity of its interactables with their output
+	UPROPERTY(EditAnywhere, Category = "Puzzle Logic")
+	bool bIsSink = false;
+
+	UPROPERTY(ReplicatedUsing = OnRep_Output)
+	bool bOutput = false;
+	UFUNCTION()
+	void OnRep_Output();
+	void ApplyOutput();
+
+	//State the subsystem keeps on the node so it survives recompiling the graph
+	bool bSignal = false;
+	bool bHasAppliedOutput = false;
+	bool bIsDelayElapsed = false;
+	FTimerHandle DelayTimer;
+
+	UPROPERTY()
+	UObject* SignalSource = nullptr;
+	UPROPERTY()
+	TArray<UOpenDoor*> Doors;
+	UPROPERTY()
+	TArray<UInteractable*> Interactables;
+};
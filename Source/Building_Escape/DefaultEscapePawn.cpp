@@ -44,6 +44,11 @@ void ADefaultEscapePawn::BeginPlay()
 	MovementModeChangedDelegate.AddUniqueDynamic(GetParkourMovementComponent(), &UParkourMovementComponent::OnMovementModeChangedDelegate);
 }
 
+const TArray<FPreloadAssetEntry>& ADefaultEscapePawn::GetPreloadAssets() const
+{
+	return PreloadAssets;
+}
+
 void InitializeDefaultPawnInputBindings()
 {
 	static bool bBindingsAdded = false;
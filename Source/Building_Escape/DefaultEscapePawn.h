@@ -11,6 +11,7 @@
 #include "CoreMinimal.h"
 #include "UObject/ObjectMacros.h"
 #include "GameFramework/Character.h"
+#include "AssetPreloadManager.h"
 #include "DefaultEscapePawn.generated.h"
 
 class UInputComponent;
@@ -38,6 +39,8 @@ class BUILDING_ESCAPE_API ADefaultEscapePawn : public ACharacter
 
 	UParkourMovementComponent* GetParkourMovementComponent() const;
 
+	const TArray<FPreloadAssetEntry>& GetPreloadAssets() const;
+
 	/**
 	 * Input callback to move forward in local space (or backward if Val is negative).
 	 * @param Val Amount of movement in the forward direction (or backward if negative).
@@ -92,6 +95,10 @@ public:
 	UPROPERTY(Category = Pawn, EditAnywhere, BlueprintReadOnly)
 		uint32 bAddDefaultMovementBindings : 1;
 
+	/** Assets the pawn needs in the middle of the action(e.g. the parkour montages); the game mode preloads them while the level loads. Read from DefaultGame.ini. */
+	UPROPERTY(Config, Category = Preloading, EditDefaultsOnly)
+		TArray<FPreloadAssetEntry> PreloadAssets;
+
 
 };
 
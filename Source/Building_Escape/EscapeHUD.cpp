@@ -0,0 +1,155 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "EscapeHUD.h"
+#include "Components/Interactable.h"
+#include "Engine/Canvas.h"
+#include "Engine/Texture2D.h"
+#include "Engine/World.h"
+
+AEscapeHUD::AEscapeHUD()
+{
+	MarkedFrameTexture = TSoftObjectPtr<UTexture2D>(FSoftObjectPath(TEXT("/Game/2DAssets/IndicatorFrame.IndicatorFrame")));
+	FocusedFrameTexture = TSoftObjectPtr<UTexture2D>(FSoftObjectPath(TEXT("/Game/2DAssets/IndicatorFrameFat.IndicatorFrameFat")));
+	InteractionHintTexture = TSoftObjectPtr<UTexture2D>(FSoftObjectPath(TEXT("/Game/2DAssets/RMB_indicator.RMB_indicator")));
+}
+
+void AEscapeHUD::BeginPlay()
+{
+	Super::BeginPlay();
+
+	MarkedFrame = MarkedFrameTexture.LoadSynchronous();
+	FocusedFrame = FocusedFrameTexture.LoadSynchronous();
+	InteractionHint = InteractionHintTexture.LoadSynchronous();
+
+	//The indicators are kept up to date by the focus changes alone, so nothing has to be polled every frame
+	InteractableRegistry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>();
+	if (InteractableRegistry)
+	{
+		FocusStatesChangedHandle = InteractableRegistry->OnFocusStatesChanged.AddUObject(this, &AEscapeHUD::OnFocusStatesChanged);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s found no interactable registry, interaction indicators won't be drawn!"), *GetName());
+	}
+}
+
+void AEscapeHUD::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (InteractableRegistry)
+	{
+		InteractableRegistry->OnFocusStatesChanged.Remove(FocusStatesChangedHandle);
+		InteractableRegistry = nullptr;
+	}
+	Indicators.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AEscapeHUD::OnFocusStatesChanged(const TArray<FInteractableFocusChange>& FocusChanges)
+{
+	for (const FInteractableFocusChange& FocusChange : FocusChanges)
+	{
+		const int32 IndicatorIndex = Indicators.IndexOfByPredicate([&FocusChange](const FIndicator& Indicator) { return Indicator.Handle == FocusChange.Handle; });
+
+		if (FocusChange.NewState == InactiveState)
+		{
+			if (IndicatorIndex != INDEX_NONE)
+			{
+				Indicators.RemoveAtSwap(IndicatorIndex, 1, false);
+			}
+		}
+		else if (IndicatorIndex != INDEX_NONE)
+		{
+			Indicators[IndicatorIndex].State = FocusChange.NewState;
+		}
+		else
+		{
+			FIndicator& Indicator = Indicators.AddDefaulted_GetRef();
+			Indicator.Handle = FocusChange.Handle;
+			Indicator.State = FocusChange.NewState;
+		}
+	}
+}
+
+void AEscapeHUD::DrawHUD()
+{
+	Super::DrawHUD();
+
+	if (!Canvas || !InteractableRegistry || Indicators.Num() == 0)
+	{
+		return;
+	}
+
+	//Projecting every indicator first, so each texture is drawn in one uninterrupted run the canvas can batch
+	MarkedPositions.Reset();
+	FocusedPositions.Reset();
+	FocusedDisplayData.Reset();
+	for (int32 IndicatorIndex = Indicators.Num() - 1; IndicatorIndex >= 0; IndicatorIndex--)
+	{
+		//Interactables that left the world don't report a change, their handles simply stop resolving
+		UInteractable* Interactable = InteractableRegistry->Resolve(Indicators[IndicatorIndex].Handle);
+		if (!Interactable)
+		{
+			Indicators.RemoveAtSwap(IndicatorIndex, 1, false);
+			continue;
+		}
+
+		//The projected depth is 0 for locations behind the view
+		const FVector ScreenLocation = Canvas->Project(Interactable->GetComponentLocation());
+		if (ScreenLocation.Z <= 0.f) { continue; }
+
+		if (Indicators[IndicatorIndex].State == FocusedState)
+		{
+			FocusedPositions.Add(FVector2D(ScreenLocation.X, ScreenLocation.Y));
+			FocusedDisplayData.Add(&Interactable->GetDisplayData());
+		}
+		else
+		{
+			MarkedPositions.Add(FVector2D(ScreenLocation.X, ScreenLocation.Y));
+		}
+	}
+
+	//Sizes are defined for a full HD viewport
+	const float Scale = Canvas->ClipX / 1920.f;
+	DrawIndicators(MarkedFrame, MarkedPositions, MarkedFrameSize * Scale, FVector2D::ZeroVector, MarkedColor);
+	DrawIndicators(FocusedFrame, FocusedPositions, FocusedFrameSize * Scale, FVector2D::ZeroVector, FocusedColor);
+	DrawIndicators(InteractionHint, FocusedPositions, InteractionHintSize * Scale, InteractionHintOffset * Scale, FocusedColor);
+	DrawInteractionDisplayData(Scale);
+}
+
+void AEscapeHUD::DrawInteractionDisplayData(float Scale)
+{
+	//The display data is resolved once per interactable, so nothing is looked up by name here
+	const float HalfIconSize = InteractionIconSize * Scale / 2;
+	for (int32 FocusedIndex = 0; FocusedIndex < FocusedPositions.Num(); FocusedIndex++)
+	{
+		const FVector2D& Position = FocusedPositions[FocusedIndex];
+		const FInteractionDisplayData& DisplayData = *FocusedDisplayData[FocusedIndex];
+
+		if (DisplayData.Icon)
+		{
+			const FVector2D IconPosition = Position + InteractionIconOffset * Scale;
+			DrawTexture(DisplayData.Icon, IconPosition.X - HalfIconSize, IconPosition.Y - HalfIconSize, InteractionIconSize * Scale, InteractionIconSize * Scale, 0.f, 0.f, 1.f, 1.f, FocusedColor);
+		}
+		if (!DisplayData.DisplayName.IsEmpty())
+		{
+			const FVector2D NamePosition = Position + InteractionNameOffset * Scale;
+			DrawText(DisplayData.DisplayName.ToString(), FocusedColor, NamePosition.X, NamePosition.Y, nullptr, Scale);
+		}
+	}
+}
+
+void AEscapeHUD::DrawIndicators(UTexture2D* Texture, const TArray<FVector2D>& Positions, float Size, const FVector2D& Offset, const FLinearColor& Color)
+{
+	if (!Texture)
+	{
+		return;
+	}
+
+	const float HalfSize = Size / 2;
+	for (const FVector2D& Position : Positions)
+	{
+		DrawTexture(Texture, Position.X + Offset.X - HalfSize, Position.Y + Offset.Y - HalfSize, Size, Size, 0.f, 0.f, 1.f, 1.f, Color);
+	}
+}
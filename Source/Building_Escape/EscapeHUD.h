@@ -0,0 +1,103 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/HUD.h"
+#include "Subsystems/InteractableRegistrySubsystem.h"
+#include "EscapeHUD.generated.h"
+
+class UTexture2D;
+
+/**
+ * Draws the indicators of every marked and focused interactable straight onto the canvas, replacing one indicator widget per interactable.
+ * The set of indicators is only updated from the registry's per frame change list; every frame the indicators are projected and drawn grouped by texture,
+ * so the canvas batches each group into a single draw and the cost doesn't depend on widgets at all.
+ */
+UCLASS()
+class BUILDING_ESCAPE_API AEscapeHUD : public AHUD
+{
+	GENERATED_BODY()
+
+public:
+	AEscapeHUD();
+
+	virtual void DrawHUD() override;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	//Frame drawn around marked interactables
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	TSoftObjectPtr<UTexture2D> MarkedFrameTexture;
+
+	//Frame drawn around the focused interactable
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	TSoftObjectPtr<UTexture2D> FocusedFrameTexture;
+
+	//Input hint drawn next to the focused interactable
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	TSoftObjectPtr<UTexture2D> InteractionHintTexture;
+
+	//Sizes are in pixels at 1920 horizontal resolution and scale with the viewport
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	float MarkedFrameSize = 32.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	float FocusedFrameSize = 48.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	float InteractionHintSize = 32.f;
+
+	//Offset of the hint from the centre of the focused frame
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	FVector2D InteractionHintOffset = FVector2D(40.f, 0.f);
+
+	//Icon of the interaction, from the cached display data, drawn next to the focused interactable
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	float InteractionIconSize = 32.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	FVector2D InteractionIconOffset = FVector2D(-40.f, 0.f);
+
+	//Top left corner of the interaction name, relative to the centre of the focused frame
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	FVector2D InteractionNameOffset = FVector2D(24.f, 24.f);
+
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	FLinearColor MarkedColor = FLinearColor(1.f, 1.f, 1.f, 0.6f);
+
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction indicators")
+	FLinearColor FocusedColor = FLinearColor::White;
+
+private:
+	struct FIndicator
+	{
+		FInteractableHandle Handle;
+		TEnumAsByte<EFocusState> State = InactiveState;
+	};
+
+	//Only marked and focused interactables have an indicator
+	TArray<FIndicator> Indicators;
+
+	//Screen positions of the indicators of the current frame, split by the texture they're drawn with; reused between frames
+	TArray<FVector2D> MarkedPositions;
+	TArray<FVector2D> FocusedPositions;
+	//Display data of the focused interactables, parallel to FocusedPositions
+	TArray<const FInteractionDisplayData*> FocusedDisplayData;
+
+	UPROPERTY()
+	UTexture2D* MarkedFrame = nullptr;
+	UPROPERTY()
+	UTexture2D* FocusedFrame = nullptr;
+	UPROPERTY()
+	UTexture2D* InteractionHint = nullptr;
+
+	UInteractableRegistrySubsystem* InteractableRegistry = nullptr;
+	FDelegateHandle FocusStatesChangedHandle;
+
+	void OnFocusStatesChanged(const TArray<FInteractableFocusChange>& FocusChanges);
+	void DrawInteractionDisplayData(float Scale);
+	void DrawIndicators(UTexture2D* Texture, const TArray<FVector2D>& Positions, float Size, const FVector2D& Offset, const FLinearColor& Color);
+};
@@ -0,0 +1,116 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "InteractionFocusScorer.h"
+#include "Math/VectorRegister.h"
+
+void FInteractionFocusScorer::Reset()
+{
+	LocationsX.Reset();
+	LocationsY.Reset();
+	LocationsZ.Reset();
+	NumCandidates = 0;
+}
+
+int32 FInteractionFocusScorer::AddCandidate(const FVector& Location)
+{
+	LocationsX.Add(Location.X);
+	LocationsY.Add(Location.Y);
+	LocationsZ.Add(Location.Z);
+	return NumCandidates++;
+}
+
+int32 FInteractionFocusScorer::Score(const FInteractionFocusView& View, TArray<int32>& OutMarkedIndices)
+{
+	if (NumCandidates == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	//The arrays are padded to whole vectors; results of the padding lanes are masked out below
+	const int32 NumPadded = Align(NumCandidates, 4);
+	LocationsX.SetNumZeroed(NumPadded, false);
+	LocationsY.SetNumZeroed(NumPadded, false);
+	LocationsZ.SetNumZeroed(NumPadded, false);
+
+	//Only the X, Y and W columns of the matrix are needed for the distance to the centre of the screen
+	const FMatrix& M = View.ViewProjectionMatrix;
+	const VectorRegister M00 = VectorSetFloat1(M.M[0][0]), M10 = VectorSetFloat1(M.M[1][0]), M20 = VectorSetFloat1(M.M[2][0]), M30 = VectorSetFloat1(M.M[3][0]);
+	const VectorRegister M01 = VectorSetFloat1(M.M[0][1]), M11 = VectorSetFloat1(M.M[1][1]), M21 = VectorSetFloat1(M.M[2][1]), M31 = VectorSetFloat1(M.M[3][1]);
+	const VectorRegister M03 = VectorSetFloat1(M.M[0][3]), M13 = VectorSetFloat1(M.M[1][3]), M23 = VectorSetFloat1(M.M[2][3]), M33 = VectorSetFloat1(M.M[3][3]);
+
+	const VectorRegister ViewX = VectorSetFloat1(View.ViewLocation.X);
+	const VectorRegister ViewY = VectorSetFloat1(View.ViewLocation.Y);
+	const VectorRegister ViewZ = VectorSetFloat1(View.ViewLocation.Z);
+	//Normalized device coordinates go from -1 to 1, so half of the view size turns them into pixels from the centre
+	const VectorRegister HalfWidth = VectorSetFloat1(View.ViewWidth * 0.5f);
+	const VectorRegister HalfHeight = VectorSetFloat1(View.ViewHeight * 0.5f);
+	const VectorRegister ScreenScale = VectorSetFloat1(View.ScreenScale);
+	const VectorRegister FocusRangeSquared = VectorSetFloat1(View.FocusRangeSquared);
+	const VectorRegister MarkRangeSquared = VectorSetFloat1(View.MarkRangeSquared);
+	const VectorRegister ScreenRangeSquared = VectorSetFloat1(View.ScreenRangeSquared);
+	const VectorRegister MinW = VectorSetFloat1(KINDA_SMALL_NUMBER);
+
+	int32 BestIndex = INDEX_NONE;
+	float BestScreenDistance = MAX_flt;
+	float ScreenDistances[4];
+
+	for (int32 Base = 0; Base < NumPadded; Base += 4)
+	{
+		const VectorRegister X = VectorLoadAligned(&LocationsX[Base]);
+		const VectorRegister Y = VectorLoadAligned(&LocationsY[Base]);
+		const VectorRegister Z = VectorLoadAligned(&LocationsZ[Base]);
+
+		//World distance to the view location decides the marking and the focus range
+		const VectorRegister DeltaX = VectorSubtract(X, ViewX);
+		const VectorRegister DeltaY = VectorSubtract(Y, ViewY);
+		const VectorRegister DeltaZ = VectorSubtract(Z, ViewZ);
+		const VectorRegister WorldDistanceSquared = VectorMultiplyAdd(DeltaZ, DeltaZ, VectorMultiplyAdd(DeltaY, DeltaY, VectorMultiply(DeltaX, DeltaX)));
+
+		//Projecting the four locations to clip space at once
+		const VectorRegister ClipX = VectorMultiplyAdd(Z, M20, VectorMultiplyAdd(Y, M10, VectorMultiplyAdd(X, M00, M30)));
+		const VectorRegister ClipY = VectorMultiplyAdd(Z, M21, VectorMultiplyAdd(Y, M11, VectorMultiplyAdd(X, M01, M31)));
+		const VectorRegister ClipW = VectorMultiplyAdd(Z, M23, VectorMultiplyAdd(Y, M13, VectorMultiplyAdd(X, M03, M33)));
+
+		const VectorRegister InvW = VectorReciprocalAccurate(ClipW);
+		const VectorRegister PixelX = VectorMultiply(VectorMultiply(ClipX, InvW), HalfWidth);
+		const VectorRegister PixelY = VectorMultiply(VectorMultiply(ClipY, InvW), HalfHeight);
+		const VectorRegister ScreenDistance = VectorMultiply(ScreenScale, VectorMultiplyAdd(PixelY, PixelY, VectorMultiply(PixelX, PixelX)));
+
+		//Candidates behind the view have a negative W and would project mirrored, so they can't get focus
+		const VectorRegister FocusMask = VectorBitwiseAnd
+		(
+			VectorBitwiseAnd(VectorCompareGT(ClipW, MinW), VectorCompareGE(FocusRangeSquared, WorldDistanceSquared)),
+			VectorCompareGE(ScreenRangeSquared, ScreenDistance)
+		);
+		const VectorRegister MarkMask = VectorCompareGE(MarkRangeSquared, WorldDistanceSquared);
+
+		const int32 NumLanes = FMath::Min(4, NumCandidates - Base);
+		const int32 LaneMask = (1 << NumLanes) - 1;
+		const int32 FocusBits = VectorMaskBits(FocusMask) & LaneMask;
+		const int32 MarkBits = VectorMaskBits(MarkMask) & LaneMask;
+
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			if (MarkBits & (1 << Lane))
+			{
+				OutMarkedIndices.Add(Base + Lane);
+			}
+		}
+
+		if (FocusBits)
+		{
+			VectorStore(ScreenDistance, ScreenDistances);
+			for (int32 Lane = 0; Lane < NumLanes; Lane++)
+			{
+				if ((FocusBits & (1 << Lane)) && ScreenDistances[Lane] < BestScreenDistance)
+				{
+					BestScreenDistance = ScreenDistances[Lane];
+					BestIndex = Base + Lane;
+				}
+			}
+		}
+	}
+
+	return BestIndex;
+}
@@ -0,0 +1,47 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Everything the scorer needs to know about the view; filled once per frame by the interactor
+struct FInteractionFocusView
+{
+	FMatrix ViewProjectionMatrix = FMatrix::Identity;
+	FVector ViewLocation = FVector::ZeroVector;
+	//Pixel size of the view the candidates are projected onto
+	float ViewWidth = 0.f;
+	float ViewHeight = 0.f;
+	//Multiplies the squared pixel distances so they stay consistent regardless of the screen resolution
+	float ScreenScale = 1.f;
+	//Candidates closer than this to the view location can get focus; a negative value disables focusing altogether
+	float FocusRangeSquared = -1.f;
+	float MarkRangeSquared = 0.f;
+	float ScreenRangeSquared = 0.f;
+};
+
+/**
+ * Projects all the interaction candidates of a frame at once and picks the one closest to the centre of the screen.
+ * Candidate locations are kept as structure of arrays, so four of them are projected and tested with every vector operation,
+ * and the view state is taken once per frame instead of being rebuilt for every candidate.
+ */
+class BUILDING_ESCAPE_API FInteractionFocusScorer
+{
+public:
+	//Clears the candidates of the previous frame; the arrays keep their memory
+	void Reset();
+
+	//Returns the index the candidate is referred to by in the results
+	int32 AddCandidate(const FVector& Location);
+	int32 Num() const { return NumCandidates; }
+
+	//Appends the index of every candidate within the marking range to OutMarkedIndices and returns the index of the focus candidate, or INDEX_NONE if there isn't one.
+	//The focus candidate is within the focus range, in front of the view and within the screen range from the centre of the screen, the closest one to the centre winning.
+	int32 Score(const FInteractionFocusView& View, TArray<int32>& OutMarkedIndices);
+
+private:
+	TArray<float, TAlignedHeapAllocator<16>> LocationsX;
+	TArray<float, TAlignedHeapAllocator<16>> LocationsY;
+	TArray<float, TAlignedHeapAllocator<16>> LocationsZ;
+	int32 NumCandidates = 0;
+};
@@ -0,0 +1,54 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "StreamingCell.h"
+#include "Components/BoxComponent.h"
+#include "Engine/World.h"
+#include "Subsystems/CellStreamingSubsystem.h"
+
+// Sets default values
+AStreamingCell::AStreamingCell()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	//The box only describes the area of the cell, it never collides with anything
+	CellBounds = CreateDefaultSubobject<UBoxComponent>(FName("Cell Bounds"));
+	CellBounds->SetBoxExtent(FVector(500.f, 500.f, 200.f));
+	CellBounds->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	CellBounds->SetGenerateOverlapEvents(false);
+	CellBounds->SetHiddenInGame(true);
+	CellBounds->SetCanEverAffectNavigation(false);
+	RootComponent = CellBounds;
+}
+
+// Called when the game starts or when spawned
+void AStreamingCell::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (CellLevel.IsNull())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Streaming cell %s has no level assigned!"), *GetName());
+		return;
+	}
+
+	if (UCellStreamingSubsystem* CellStreaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>())
+	{
+		CellStreaming->RegisterCell(this);
+	}
+}
+
+void AStreamingCell::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UCellStreamingSubsystem* CellStreaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>())
+	{
+		CellStreaming->UnregisterCell(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FBox AStreamingCell::GetCellBounds() const
+{
+	return CellBounds->Bounds.GetBox();
+}
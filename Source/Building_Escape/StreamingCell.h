@@ -0,0 +1,47 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "StreamingCell.generated.h"
+
+class UBoxComponent;
+
+/**
+ * Marks the part of the map covered by a single sublevel(usually one room or one grid cell).
+ * Placed in the persistent level; UCellStreamingSubsystem loads and unloads the sublevel depending on the distance between the bounds and the players.
+ */
+UCLASS()
+class BUILDING_ESCAPE_API AStreamingCell : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AStreamingCell();
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	FBox GetCellBounds() const;
+
+	//Sublevel holding the content of this cell
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+	TSoftObjectPtr<UWorld> CellLevel;
+
+	//Cells with a higher priority are requested first when more cells wait for loading than can be loaded at once
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+	int32 Priority = 0;
+
+	//Cells that should never be unloaded, e.g. the one holding the spawn area
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+	bool bAlwaysLoaded = false;
+
+private:
+	UPROPERTY(VisibleAnywhere, Category = "Streaming")
+	UBoxComponent* CellBounds = nullptr;
+};
@@ -0,0 +1,287 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "CellStreamingSubsystem.h"
+#include "StreamingCell.h"
+#include "Components/MassTreshold.h"
+#include "Components/OpenDoor.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/LevelStreamingDynamic.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformTime.h"
+
+void UCellStreamingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UCellStreamingSubsystem::OnLevelAddedToWorld);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UCellStreamingSubsystem::OnLevelRemovedFromWorld);
+}
+
+void UCellStreamingSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	Cells.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UCellStreamingSubsystem::IsTickable() const
+{
+	return Cells.Num() > 0 && GetWorld() && GetWorld()->IsGameWorld();
+}
+
+TStatId UCellStreamingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellStreamingSubsystem, STATGROUP_Tickables);
+}
+
+void UCellStreamingSubsystem::Tick(float DeltaTime)
+{
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate < UpdateInterval)
+	{
+		return;
+	}
+	TimeSinceUpdate = 0.f;
+
+	UpdateStreaming();
+}
+
+void UCellStreamingSubsystem::RegisterCell(AStreamingCell* Cell)
+{
+	for (const FCellState& CellState : Cells)
+	{
+		if (CellState.Cell == Cell) { return; }
+	}
+
+	FCellState CellState;
+	CellState.Cell = Cell;
+	Cells.Add(CellState);
+
+	//The first update happens right away, so the cells around the spawn start loading without waiting for the interval
+	TimeSinceUpdate = UpdateInterval;
+}
+
+void UCellStreamingSubsystem::UnregisterCell(AStreamingCell* Cell)
+{
+	Cells.RemoveAll([Cell](const FCellState& CellState) { return CellState.Cell == Cell; });
+}
+
+void UCellStreamingSubsystem::AddStreamingHint(const FVector& Location, float Radius, float Duration)
+{
+	const float ExpireTime = GetWorld()->GetTimeSeconds() + Duration;
+	const float RadiusSquared = FMath::Square(Radius);
+
+	for (FCellState& CellState : Cells)
+	{
+		if (CellState.Cell.IsValid() && CellState.Cell->GetCellBounds().ComputeSquaredDistanceToPoint(Location) <= RadiusSquared)
+		{
+			CellState.HintExpireTime = FMath::Max(CellState.HintExpireTime, ExpireTime);
+		}
+	}
+}
+
+void UCellStreamingSubsystem::RegisterDoorHint(UOpenDoor* Door)
+{
+	DoorHints.AddUnique(Door);
+}
+
+void UCellStreamingSubsystem::UnregisterDoorHint(UOpenDoor* Door)
+{
+	DoorHints.Remove(Door);
+}
+
+void UCellStreamingSubsystem::RegisterMassTreshold(UMassTreshold* MassTreshold)
+{
+	MassTresholds.AddUnique(MassTreshold);
+}
+
+void UCellStreamingSubsystem::UnregisterMassTreshold(UMassTreshold* MassTreshold)
+{
+	MassTresholds.Remove(MassTreshold);
+}
+
+void UCellStreamingSubsystem::GatherViewLocations(TArray<FVector, TInlineAllocator<4>>& OutViewLocations) const
+{
+	//The server streams for every connected player, clients only for their local ones
+	const bool bIsClient = GetWorld()->GetNetMode() == NM_Client;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (!PlayerController || (bIsClient && !PlayerController->IsLocalController())) { continue; }
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(OUT ViewLocation, OUT ViewRotation);
+		OutViewLocations.Add(ViewLocation);
+	}
+}
+
+void UCellStreamingSubsystem::UpdateStreaming()
+{
+	TArray<FVector, TInlineAllocator<4>> ViewLocations;
+	GatherViewLocations(ViewLocations);
+
+	//Doors near the players refresh the hints for the cells behind them
+	const float DoorHintActivationRadiusSquared = FMath::Square(DoorHintActivationRadius);
+	DoorHints.RemoveAll([](const TWeakObjectPtr<UOpenDoor>& Door) { return !Door.IsValid(); });
+	for (const TWeakObjectPtr<UOpenDoor>& Door : DoorHints)
+	{
+		const FVector DoorLocation = Door->GetComponentLocation();
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			if (FVector::DistSquared(DoorLocation, ViewLocation) <= DoorHintActivationRadiusSquared)
+			{
+				AddStreamingHint(DoorLocation, Door->GetStreamingHintRadius(), HintDuration);
+				break;
+			}
+		}
+	}
+
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	TArray<TPair<float, int32>, TInlineAllocator<16>> PendingLoads;
+	int32 LoadsInProgress = 0;
+
+	for (int32 CellIndex = 0; CellIndex < Cells.Num(); CellIndex++)
+	{
+		FCellState& CellState = Cells[CellIndex];
+		if (!CellState.Cell.IsValid()) { continue; }
+
+		const FBox CellBounds = CellState.Cell->GetCellBounds();
+		float ClosestDistanceSquared = MAX_flt;
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, CellBounds.ComputeSquaredDistanceToPoint(ViewLocation));
+		}
+
+		const float Radius = CellState.bIsRequested ? UnloadRadius : LoadRadius;
+		const bool bIsHinted = CellState.HintExpireTime >= CurrentTime;
+		const bool bShouldBeLoaded = CellState.Cell->bAlwaysLoaded || bIsHinted || ClosestDistanceSquared <= FMath::Square(Radius);
+
+		ULevelStreaming* StreamingLevel = CellState.StreamingLevel.Get();
+		if (CellState.bIsRequested && StreamingLevel)
+		{
+			//Reporting how long each cell took to become visible helps to find the ones that are too heavy
+			const bool bIsVisible = StreamingLevel->IsLevelVisible();
+			if (bIsVisible && !CellState.bIsVisible)
+			{
+				UE_LOG(LogTemp, Log, TEXT("Streaming cell %s became visible after %.2f s"), *CellState.Cell->GetName(), FPlatformTime::Seconds() - CellState.LoadRequestTime);
+			}
+			CellState.bIsVisible = bIsVisible;
+			LoadsInProgress += bIsVisible ? 0 : 1;
+		}
+
+		if (bShouldBeLoaded && !CellState.bIsRequested)
+		{
+			//Closer cells go first, the priority of the cell and the hints can move a cell ahead of closer ones
+			float Score = FMath::Sqrt(ClosestDistanceSquared) - CellState.Cell->Priority * PriorityDistanceWeight - (bIsHinted ? PriorityDistanceWeight : 0.f);
+			PendingLoads.Add(TPair<float, int32>(Score, CellIndex));
+		}
+		else if (!bShouldBeLoaded && CellState.bIsRequested)
+		{
+			RequestUnload(CellState);
+		}
+	}
+
+	PendingLoads.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key < B.Key; });
+	for (const TPair<float, int32>& PendingLoad : PendingLoads)
+	{
+		if (LoadsInProgress >= MaxConcurrentLoads) { break; }
+
+		RequestLoad(Cells[PendingLoad.Value]);
+		LoadsInProgress++;
+	}
+}
+
+ULevelStreaming* UCellStreamingSubsystem::FindOrCreateStreamingLevel(FCellState& CellState)
+{
+	if (CellState.StreamingLevel.IsValid())
+	{
+		return CellState.StreamingLevel.Get();
+	}
+
+	AStreamingCell* Cell = CellState.Cell.Get();
+	const FString CellPackageName = Cell->CellLevel.ToSoftObjectPath().GetLongPackageName();
+
+	//Sublevels added to the persistent level in the editor are reused, so their settings(transform, LODs) are respected
+	for (ULevelStreaming* StreamingLevel : GetWorld()->GetStreamingLevels())
+	{
+		if (StreamingLevel && UWorld::RemovePIEPrefix(StreamingLevel->GetWorldAssetPackageName()) == CellPackageName)
+		{
+			CellState.StreamingLevel = StreamingLevel;
+			return StreamingLevel;
+		}
+	}
+
+	//Anything else is instanced at runtime; the instance is kept afterwards and toggled like the others
+	bool bSuccess = false;
+	ULevelStreamingDynamic* DynamicLevel = ULevelStreamingDynamic::LoadLevelInstanceBySoftObjectPtr(GetWorld(), Cell->CellLevel, FVector::ZeroVector, FRotator::ZeroRotator, OUT bSuccess);
+	if (!bSuccess || !DynamicLevel)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Level %s of streaming cell %s couldn't be loaded!"), *CellPackageName, *Cell->GetName());
+		return nullptr;
+	}
+
+	CellState.StreamingLevel = DynamicLevel;
+	return DynamicLevel;
+}
+
+void UCellStreamingSubsystem::RequestLoad(FCellState& CellState)
+{
+	ULevelStreaming* StreamingLevel = FindOrCreateStreamingLevel(CellState);
+	if (!StreamingLevel)
+	{
+		//Without a level there is nothing to load; the cell is treated as loaded so it isn't retried every update
+		CellState.bIsRequested = true;
+		return;
+	}
+
+	StreamingLevel->SetPriority(CellState.Cell->Priority);
+	StreamingLevel->bShouldBlockOnLoad = false;
+	StreamingLevel->SetShouldBeLoaded(true);
+	StreamingLevel->SetShouldBeVisible(true);
+	CellState.bIsRequested = true;
+	CellState.bIsVisible = false;
+	CellState.LoadRequestTime = FPlatformTime::Seconds();
+}
+
+void UCellStreamingSubsystem::RequestUnload(FCellState& CellState)
+{
+	if (ULevelStreaming* StreamingLevel = CellState.StreamingLevel.Get())
+	{
+		StreamingLevel->SetShouldBeVisible(false);
+		StreamingLevel->SetShouldBeLoaded(false);
+	}
+	CellState.bIsRequested = false;
+	CellState.bIsVisible = false;
+}
+
+void UCellStreamingSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld())
+	{
+		RefreshMassTresholds();
+	}
+}
+
+void UCellStreamingSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld())
+	{
+		RefreshMassTresholds();
+	}
+}
+
+void UCellStreamingSubsystem::RefreshMassTresholds()
+{
+	//Actors of a level that streams in or out don't generate overlap events, so bodies could have appeared on or vanished from any plate
+	MassTresholds.RemoveAll([](const TWeakObjectPtr<UMassTreshold>& MassTreshold) { return !MassTreshold.IsValid(); });
+	for (const TWeakObjectPtr<UMassTreshold>& MassTreshold : MassTresholds)
+	{
+		MassTreshold->RecalculateMass();
+	}
+}
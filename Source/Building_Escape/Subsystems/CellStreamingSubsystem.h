@@ -0,0 +1,106 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "CellStreamingSubsystem.generated.h"
+
+class AStreamingCell;
+class ULevelStreaming;
+class UMassTreshold;
+class UOpenDoor;
+
+/**
+ * Loads the sublevels of AStreamingCell actors asynchronously around every player and unloads them once the players move away.
+ * Doors act as hints that preload the cells behind them before they open, and gameplay components that depend on overlaps
+ * are kept consistent while the cells around them stream in and out.
+ * The radii and limits are read from the [/Script/Building_Escape.CellStreamingSubsystem] section of DefaultGame.ini.
+ */
+UCLASS(Config = Game)
+class BUILDING_ESCAPE_API UCellStreamingSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	void RegisterCell(AStreamingCell* Cell);
+	void UnregisterCell(AStreamingCell* Cell);
+
+	//Loads every cell whose bounds are within Radius from Location for at least Duration seconds, regardless of the distance to the players
+	void AddStreamingHint(const FVector& Location, float Radius, float Duration);
+	//The configured lifetime of a hint that isn't refreshed
+	float GetHintDuration() const { return HintDuration; }
+	void RegisterDoorHint(UOpenDoor* Door);
+	void UnregisterDoorHint(UOpenDoor* Door);
+
+	//Mass tresholds come and go with the cells they are placed in
+	void RegisterMassTreshold(UMassTreshold* MassTreshold);
+	void UnregisterMassTreshold(UMassTreshold* MassTreshold);
+
+private:
+	struct FCellState
+	{
+		TWeakObjectPtr<AStreamingCell> Cell;
+		TWeakObjectPtr<ULevelStreaming> StreamingLevel;
+		float HintExpireTime = -1.f;
+		double LoadRequestTime = 0.0;
+		bool bIsRequested = false;
+		bool bIsVisible = false;
+	};
+
+	TArray<FCellState> Cells;
+	TArray<TWeakObjectPtr<UOpenDoor>> DoorHints;
+	TArray<TWeakObjectPtr<UMassTreshold>> MassTresholds;
+
+	float TimeSinceUpdate = 0.f;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+
+	void UpdateStreaming();
+	void GatherViewLocations(TArray<FVector, TInlineAllocator<4>>& OutViewLocations) const;
+	ULevelStreaming* FindOrCreateStreamingLevel(FCellState& CellState);
+	void RequestLoad(FCellState& CellState);
+	void RequestUnload(FCellState& CellState);
+
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+	void RefreshMassTresholds();
+
+	//Cells closer than this to any player are loaded
+	UPROPERTY(Config)
+	float LoadRadius = 3000.f;
+
+	//Loaded cells are only unloaded once every player is further than this; the gap to LoadRadius keeps cells at the border from being reloaded over and over
+	UPROPERTY(Config)
+	float UnloadRadius = 4000.f;
+
+	//Seconds between the streaming updates
+	UPROPERTY(Config)
+	float UpdateInterval = 0.25f;
+
+	//Maximum amount of cells being loaded at the same time; the others wait in order of priority
+	UPROPERTY(Config)
+	int32 MaxConcurrentLoads = 2;
+
+	//How many units of distance a single point of cell priority is worth when ordering the pending cells
+	UPROPERTY(Config)
+	float PriorityDistanceWeight = 500.f;
+
+	//Doors closer than this to a player preload the cells behind them
+	UPROPERTY(Config)
+	float DoorHintActivationRadius = 1500.f;
+
+	//How long a hinted cell stays requested after the hint was last refreshed
+	UPROPERTY(Config)
+	float HintDuration = 5.f;
+};
@@ -0,0 +1,291 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "CheckpointSubsystem.h"
+#include "Components/Interactable.h"
+#include "Components/Interactor.h"
+#include "Components/MassTreshold.h"
+#include "Components/OpenDoor.h"
+#include "Components/ParkourMovementComponent.h"
+#include "Components/PhysicsPropComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/PuzzleLogicComponent.h"
+#include "Subsystems/PhysicsPropSleepSubsystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/PlatformTime.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+//Appends a record for every component of the array
+template<typename ComponentType>
+static void AddRecords(FArchive& Writer, FCheckpoint& OutCheckpoint, const TArray<ComponentType*>& Components, FCheckpoint::ERecordType Type)
+{
+	for (ComponentType* Component : Components)
+	{
+		UCheckpointSubsystem::AddRecord(Writer, OutCheckpoint, Component, Type);
+	}
+}
+
+void UCheckpointSubsystem::CaptureCheckpoint(FCheckpoint& OutCheckpoint)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	UWorld* World = GetWorld();
+	OutCheckpoint.Reset();
+
+	//Clients only follow the server's state, so there is nothing to capture on them
+	if (World->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Checkpoints can only be captured on the server!"));
+		return;
+	}
+
+	FMemoryWriter Writer(OutCheckpoint.Data);
+
+	//Records are written in the order they are restored in
+	if (UPhysicsPropSleepSubsystem* SleepSubsystem = World->GetSubsystem<UPhysicsPropSleepSubsystem>())
+	{
+		TArray<UPrimitiveComponent*> Bodies;
+		SleepSubsystem->GetRegisteredBodies(OUT Bodies);
+		for (UPrimitiveComponent* Body : Bodies)
+		{
+			AddRecord(Writer, OutCheckpoint, Body, FCheckpoint::RecordType_Body);
+		}
+	}
+
+	//The components are found in a single pass over the actors of the world, and written grouped by type
+	TArray<UOpenDoor*> Doors;
+	TArray<UMassTreshold*> MassTresholds;
+	TArray<UPuzzleLogicComponent*> PuzzleNodes;
+	TArray<UInteractable*> Interactables;
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		for (UActorComponent* Component : It->GetComponents())
+		{
+			if (!Component || !Component->HasBegunPlay() || Component->IsPendingKill()) { continue; }
+
+			if (UOpenDoor* Door = Cast<UOpenDoor>(Component)) { Doors.Add(Door); }
+			else if (UMassTreshold* MassTreshold = Cast<UMassTreshold>(Component)) { MassTresholds.Add(MassTreshold); }
+			else if (UPuzzleLogicComponent* PuzzleNode = Cast<UPuzzleLogicComponent>(Component)) { PuzzleNodes.Add(PuzzleNode); }
+			else if (UInteractable* Interactable = Cast<UInteractable>(Component)) { Interactables.Add(Interactable); }
+		}
+	}
+	AddRecords(Writer, OutCheckpoint, Doors, FCheckpoint::RecordType_Door);
+	AddRecords(Writer, OutCheckpoint, MassTresholds, FCheckpoint::RecordType_MassTreshold);
+	AddRecords(Writer, OutCheckpoint, PuzzleNodes, FCheckpoint::RecordType_PuzzleLogic);
+	AddRecords(Writer, OutCheckpoint, Interactables, FCheckpoint::RecordType_Interactable);
+
+	for (FConstControllerIterator It = World->GetControllerIterator(); It; ++It)
+	{
+		AController* Controller = It->Get();
+		APawn* Pawn = Controller ? Controller->GetPawn() : nullptr;
+		if (Pawn && Pawn->FindComponentByClass<UParkourMovementComponent>())
+		{
+			AddRecord(Writer, OutCheckpoint, Controller, FCheckpoint::RecordType_Pawn);
+		}
+	}
+
+	Stats.Captures++;
+	Stats.LastRecords = OutCheckpoint.Records.Num();
+	Stats.LastSizeBytes = OutCheckpoint.Data.Num();
+	Stats.LastCaptureMilliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+void UCheckpointSubsystem::CaptureRecord(FCheckpoint& Checkpoint, UObject* Object, FCheckpoint::ERecordType Type)
+{
+	if (!Object || Checkpoint.Records.ContainsByPredicate([Object](const FCheckpoint::FRecord& Record) { return Record.Object == Object; }))
+	{
+		return;
+	}
+
+	FMemoryWriter Writer(Checkpoint.Data);
+	Writer.Seek(Checkpoint.Data.Num());
+	AddRecord(Writer, Checkpoint, Object, Type);
+}
+
+void UCheckpointSubsystem::AddRecord(FArchive& Writer, FCheckpoint& Checkpoint, UObject* Object, FCheckpoint::ERecordType Type)
+{
+	FCheckpoint::FRecord& Record = Checkpoint.Records.AddDefaulted_GetRef();
+	Record.Object = Object;
+	Record.Offset = Writer.Tell();
+	Record.Type = Type;
+	SerializeRecord(Writer, Object, Type);
+}
+
+bool UCheckpointSubsystem::SerializeRecord(FArchive& Ar, UObject* Object, FCheckpoint::ERecordType Type)
+{
+	switch (Type)
+	{
+	case FCheckpoint::RecordType_Body:
+		SerializeBody(Ar, CastChecked<UPrimitiveComponent>(Object));
+		return true;
+	case FCheckpoint::RecordType_Door:
+		CastChecked<UOpenDoor>(Object)->SerializeCheckpoint(Ar);
+		return true;
+	case FCheckpoint::RecordType_MassTreshold:
+		CastChecked<UMassTreshold>(Object)->SerializeCheckpoint(Ar);
+		return true;
+	case FCheckpoint::RecordType_PuzzleLogic:
+		CastChecked<UPuzzleLogicComponent>(Object)->SerializeCheckpoint(Ar);
+		return true;
+	case FCheckpoint::RecordType_Interactable:
+		CastChecked<UInteractable>(Object)->SerializeCheckpoint(Ar);
+		return true;
+	case FCheckpoint::RecordType_Pawn:
+	{
+		//The player may have respawned since the capture; the state goes to the pawn they have now
+		APawn* Pawn = CastChecked<AController>(Object)->GetPawn();
+		UParkourMovementComponent* ParkourMovement = Pawn ? Pawn->FindComponentByClass<UParkourMovementComponent>() : nullptr;
+		if (!ParkourMovement)
+		{
+			return false;
+		}
+		ParkourMovement->SerializeCheckpoint(Ar);
+		return true;
+	}
+	}
+	return false;
+}
+
+bool UCheckpointSubsystem::RestoreCheckpoint(const FCheckpoint& Checkpoint)
+{
+	UWorld* World = GetWorld();
+	if (!Checkpoint.IsValid() || World->GetNetMode() == NM_Client)
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	//Held props would be pulled straight back to where they're held
+	ReleaseHolds();
+	const int32 SkippedRecords = RestoreRecords(Checkpoint);
+
+	Stats.Restores++;
+	Stats.LastSkippedRecords = SkippedRecords;
+	Stats.LastRestoreMilliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	return true;
+}
+
+int32 UCheckpointSubsystem::RestoreRecords(const FCheckpoint& Checkpoint)
+{
+	UPhysicsPropSleepSubsystem* SleepSubsystem = GetWorld()->GetSubsystem<UPhysicsPropSleepSubsystem>();
+	FMemoryReader Reader(Checkpoint.Data);
+	int32 SkippedRecords = 0;
+	for (const FCheckpoint::FRecord& Record : Checkpoint.Records)
+	{
+		UObject* Object = Record.Object.Get();
+		if (!Object || Object->IsPendingKill())
+		{
+			SkippedRecords++;
+			continue;
+		}
+
+		//Frozen bodies are kinematic and wouldn't take the velocities
+		UPrimitiveComponent* Body = Record.Type == FCheckpoint::RecordType_Body ? CastChecked<UPrimitiveComponent>(Object) : nullptr;
+		if (Body && SleepSubsystem)
+		{
+			SleepSubsystem->WakeBody(Body);
+		}
+
+		Reader.Seek(Record.Offset);
+		if (!SerializeRecord(Reader, Object, Record.Type))
+		{
+			SkippedRecords++;
+			continue;
+		}
+
+		UPhysicsPropComponent* PhysicsProp = Body ? Body->GetOwner()->FindComponentByClass<UPhysicsPropComponent>() : nullptr;
+		if (PhysicsProp)
+		{
+			PhysicsProp->OnCheckpointRestored();
+		}
+	}
+	return SkippedRecords;
+}
+
+void UCheckpointSubsystem::SerializeBody(FArchive& Ar, UPrimitiveComponent* Body)
+{
+	FVector Location = Body->GetComponentLocation();
+	FQuat Rotation = Body->GetComponentQuat();
+	FVector LinearVelocity = Body->GetPhysicsLinearVelocity();
+	FVector AngularVelocity = Body->GetPhysicsAngularVelocityInDegrees();
+	uint8 bIsAwake = Body->RigidBodyIsAwake() ? 1 : 0;
+	Ar << Location;
+	Ar << Rotation;
+	Ar << LinearVelocity;
+	Ar << AngularVelocity;
+	Ar << bIsAwake;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	//Teleporting moves the body without sweeping, and updates the overlaps of the plates it lands on or leaves
+	Body->SetWorldLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	if (bIsAwake)
+	{
+		Body->WakeAllRigidBodies();
+		Body->SetPhysicsLinearVelocity(LinearVelocity);
+		Body->SetPhysicsAngularVelocityInDegrees(AngularVelocity);
+	}
+	else
+	{
+		Body->SetPhysicsLinearVelocity(FVector::ZeroVector);
+		Body->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+		Body->PutAllRigidBodiesToSleep();
+	}
+}
+
+void UCheckpointSubsystem::ReleaseHolds()
+{
+	UPhysicsPropSleepSubsystem* SleepSubsystem = GetWorld()->GetSubsystem<UPhysicsPropSleepSubsystem>();
+	if (!SleepSubsystem)
+	{
+		return;
+	}
+
+	TArray<UPrimitiveComponent*> Bodies;
+	SleepSubsystem->GetRegisteredBodies(OUT Bodies);
+	for (UPrimitiveComponent* Body : Bodies)
+	{
+		UPhysicsPropComponent* PhysicsProp = Body->GetOwner()->FindComponentByClass<UPhysicsPropComponent>();
+		UInteractor* Holder = PhysicsProp ? PhysicsProp->GetHolder() : nullptr;
+		if (!Holder) { continue; }
+
+		//A remote holder only drops the prop once the RPC arrives; the server stops following its states right away
+		Holder->ReleaseHold();
+		if (PhysicsProp->GetHolder())
+		{
+			PhysicsProp->SetHolder(nullptr);
+		}
+	}
+}
+
+void UCheckpointSubsystem::SaveCheckpoint()
+{
+	CaptureCheckpoint(OUT SavedCheckpoint);
+}
+
+bool UCheckpointSubsystem::LoadCheckpoint()
+{
+	return RestoreCheckpoint(SavedCheckpoint);
+}
+
+bool UCheckpointSubsystem::HasCheckpoint() const
+{
+	return SavedCheckpoint.IsValid();
+}
+
+FCheckpointStats UCheckpointSubsystem::GetStats() const
+{
+	return Stats;
+}
+
+void UCheckpointSubsystem::ResetStats()
+{
+	Stats = FCheckpointStats();
+}
@@ -0,0 +1,117 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CheckpointSubsystem.generated.h"
+
+class UPrimitiveComponent;
+
+//The state of a world as captured by the checkpoint subsystem; only valid within the session it was captured in, since the records refer to the live objects
+struct BUILDING_ESCAPE_API FCheckpoint
+{
+	//Restored in this order, so doors and plates see the props where they were and pawns find the puzzle as it was
+	enum ERecordType : uint8
+	{
+		RecordType_Body,
+		RecordType_Door,
+		RecordType_MassTreshold,
+		RecordType_PuzzleLogic,
+		RecordType_Interactable,
+		//Refers to the controller, so the state is applied to whatever pawn it possesses at the time of the restore
+		RecordType_Pawn,
+	};
+
+	struct FRecord
+	{
+		TWeakObjectPtr<UObject> Object;
+		int32 Offset = 0;
+		ERecordType Type = RecordType_Body;
+	};
+
+	TArray<uint8> Data;
+	TArray<FRecord> Records;
+
+	bool IsValid() const { return Records.Num() > 0; }
+	void Reset()
+	{
+		Data.Reset();
+		Records.Reset();
+	}
+};
+
+USTRUCT(BlueprintType)
+struct FCheckpointStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Checkpoint")
+	int32 Captures = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Checkpoint")
+	int32 Restores = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Checkpoint")
+	int32 LastRecords = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Checkpoint")
+	int32 LastSizeBytes = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Checkpoint")
+	float LastCaptureMilliseconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Checkpoint")
+	float LastRestoreMilliseconds = 0.f;
+
+	//Records whose object was gone when the checkpoint was restored
+	UPROPERTY(BlueprintReadOnly, Category = "Checkpoint")
+	int32 LastSkippedRecords = 0;
+};
+
+/**
+ * Captures the state of the puzzle(doors, mass tresholds, puzzle logic, interactables), the props and the player pawns into a compact binary buffer,
+ * and restores it in place within a single frame, so retrying a room doesn't need the level to be reloaded.
+ * Each element writes and reads its own state through SerializeCheckpoint; the buffer holds no object references, those are kept next to it.
+ * Props are the bodies the physics prop sleep subsystem manages, i.e. holdables and everything that was ever put on a plate.
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UCheckpointSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	void CaptureCheckpoint(FCheckpoint& OutCheckpoint);
+	//Returns false if the checkpoint is empty; elements that are gone since the capture are skipped
+	bool RestoreCheckpoint(const FCheckpoint& Checkpoint);
+
+	//Adds a single object to a partial checkpoint, unless it's in there already; predicted interactions keep the state they roll back to this way
+	static void CaptureRecord(FCheckpoint& Checkpoint, UObject* Object, FCheckpoint::ERecordType Type);
+	//Restores the records of a checkpoint on any machine, without releasing holds or counting it in the stats; returns the number of records skipped
+	int32 RestoreRecords(const FCheckpoint& Checkpoint);
+	//Appends a record for the object and writes its state at the record's offset
+	static void AddRecord(FArchive& Writer, FCheckpoint& Checkpoint, UObject* Object, FCheckpoint::ERecordType Type);
+
+	//Keep a single checkpoint in the subsystem, e.g. when a room is entered, and go back to it on respawn or retry
+	UFUNCTION(BlueprintCallable, Category = "Checkpoint")
+	void SaveCheckpoint();
+	UFUNCTION(BlueprintCallable, Category = "Checkpoint")
+	bool LoadCheckpoint();
+	UFUNCTION(BlueprintPure, Category = "Checkpoint")
+	bool HasCheckpoint() const;
+
+	UFUNCTION(BlueprintPure, Category = "Checkpoint")
+	FCheckpointStats GetStats() const;
+
+	UFUNCTION(BlueprintCallable, Category = "Checkpoint")
+	void ResetStats();
+
+private:
+	FCheckpoint SavedCheckpoint;
+	FCheckpointStats Stats;
+
+	//Returns false if there is nothing left to write or read the record with, like a controller without a parkour pawn
+	static bool SerializeRecord(FArchive& Ar, UObject* Object, FCheckpoint::ERecordType Type);
+	static void SerializeBody(FArchive& Ar, UPrimitiveComponent* Body);
+	void ReleaseHolds();
+};
@@ -0,0 +1,234 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "DoorAnimationSubsystem.h"
+#include "Components/OpenDoor.h"
+#include "Components/PrimitiveComponent.h"
+#include "Curves/CurveFloat.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/GameStateBase.h"
+
+void UDoorAnimationSubsystem::Deinitialize()
+{
+	Doors.Empty();
+	DoorParents.Empty();
+	Rotations.Empty();
+	StartYaws.Empty();
+	TargetYaws.Empty();
+	StartTimes.Empty();
+	InterpSpeeds.Empty();
+	Curves.Empty();
+	CurveEnds.Empty();
+	SweptCenters.Empty();
+	SweptExtents.Empty();
+	DefersOverlaps.Empty();
+	OverlapsDeferred.Empty();
+	DoorIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UDoorAnimationSubsystem::IsTickable() const
+{
+	return Doors.Num() > 0 && GetWorld() && GetWorld()->IsGameWorld();
+}
+
+TStatId UDoorAnimationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDoorAnimationSubsystem, STATGROUP_Tickables);
+}
+
+void UDoorAnimationSubsystem::Tick(float DeltaTime)
+{
+	const float ServerTime = GetServerTime();
+	for (int32 Index = Doors.Num() - 1; Index >= 0; Index--)
+	{
+		USceneComponent* DoorParent = DoorParents[Index].Get();
+		if (!DoorParent)
+		{
+			RemoveDoorAt(Index);
+			continue;
+		}
+
+		if (DefersOverlaps[Index])
+		{
+			SetOverlapsDeferred(Index, IsSweptVolumeClear(Index));
+		}
+
+		const float Elapsed = ServerTime - StartTimes[Index];
+		const float Alpha = UOpenDoor::EvaluateMotionAlpha(Curves[Index], InterpSpeeds[Index], Elapsed);
+		FRotator& Rotation = Rotations[Index];
+		Rotation.Yaw = FMath::Lerp(StartYaws[Index], TargetYaws[Index], Alpha);
+
+		const bool bIsSettled = IsSettled(Index, Elapsed, Rotation.Yaw);
+		if (bIsSettled)
+		{
+			Rotation.Yaw = TargetYaws[Index];
+		}
+		//Without teleporting, the physics body of the door gets the new rotation as its kinematic target and sweeps the bodies in its way along
+		DoorParent->SetWorldRotation(Rotation, false, nullptr, ETeleportType::None);
+
+		if (bIsSettled)
+		{
+			RemoveDoorAt(Index);
+		}
+	}
+}
+
+bool UDoorAnimationSubsystem::IsSettled(int32 Index, float Elapsed, float Yaw) const
+{
+	//Curves end at a known time, while easing only gets close enough to the target
+	if (Curves[Index])
+	{
+		return Elapsed >= CurveEnds[Index];
+	}
+	return FMath::Abs(TargetYaws[Index] - Yaw) <= SettleTolerance;
+}
+
+void UDoorAnimationSubsystem::WakeDoor(UOpenDoor* Door)
+{
+	USceneComponent* DoorParent = Door ? Door->GetAttachParent() : nullptr;
+	if (!DoorParent)
+	{
+		return;
+	}
+
+	//The start yaw is unwound towards the target so a door near +-180 degrees doesn't turn the long way round
+	const FDoorMotionState& MotionState = Door->GetMotionState();
+	const float TargetYaw = Door->GetTargetYaw();
+	const float StartYaw = TargetYaw + FRotator::NormalizeAxis(MotionState.StartYaw - TargetYaw);
+	UCurveFloat* Curve = Door->GetMotionCurve();
+	float CurveStart = 0.f;
+	float CurveEnd = 0.f;
+	if (Curve)
+	{
+		Curve->GetTimeRange(OUT CurveStart, OUT CurveEnd);
+	}
+
+	int32 Index;
+	if (const int32* ExistingIndex = DoorIndices.Find(Door))
+	{
+		Index = *ExistingIndex;
+	}
+	else
+	{
+		//The door turns around its hinge, so it stays within its distance from the hinge horizontally and its own bounds vertically
+		const FVector Hinge = DoorParent->GetComponentLocation();
+		const FBoxSphereBounds& Bounds = DoorParent->Bounds;
+		const float SweptRadius = FVector::Dist2D(Hinge, Bounds.Origin) + Bounds.BoxExtent.Size2D();
+
+		Index = Doors.Num();
+		DoorIndices.Add(Door, Index);
+		Doors.Add(Door);
+		DoorParents.Add(DoorParent);
+		Rotations.Add(DoorParent->GetComponentRotation());
+		StartYaws.AddUninitialized();
+		TargetYaws.AddUninitialized();
+		StartTimes.AddUninitialized();
+		InterpSpeeds.AddUninitialized();
+		Curves.AddUninitialized();
+		CurveEnds.AddUninitialized();
+		SweptCenters.Add(FVector(Hinge.X, Hinge.Y, Bounds.Origin.Z));
+		SweptExtents.Add(FVector(SweptRadius, SweptRadius, Bounds.BoxExtent.Z));
+		DefersOverlaps.Add(Door->ShouldDeferOverlaps() && DoorParent->IsA<UPrimitiveComponent>());
+		OverlapsDeferred.Add(false);
+	}
+	StartYaws[Index] = StartYaw;
+	TargetYaws[Index] = TargetYaw;
+	StartTimes[Index] = MotionState.StartServerTime;
+	InterpSpeeds[Index] = Door->GetInterpSpeed();
+	Curves[Index] = Curve;
+	CurveEnds[Index] = CurveEnd;
+
+	//Motions that already ended, like the ones late joiners receive, are finished right away instead of waiting for the next tick
+	const float Elapsed = GetServerTime() - MotionState.StartServerTime;
+	const float Yaw = FMath::Lerp(StartYaw, TargetYaw, UOpenDoor::EvaluateMotionAlpha(Curve, InterpSpeeds[Index], Elapsed));
+	if (IsSettled(Index, Elapsed, Yaw))
+	{
+		FRotator Rotation = DoorParent->GetComponentRotation();
+		if (!FMath::IsNearlyEqual(FRotator::NormalizeAxis(Rotation.Yaw - TargetYaw), 0.f, SettleTolerance))
+		{
+			Rotation.Yaw = TargetYaw;
+			DoorParent->SetWorldRotation(Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+		}
+		RemoveDoorAt(Index);
+	}
+}
+
+void UDoorAnimationSubsystem::RemoveDoor(UOpenDoor* Door)
+{
+	if (const int32* Index = DoorIndices.Find(Door))
+	{
+		RemoveDoorAt(*Index);
+	}
+}
+
+void UDoorAnimationSubsystem::RemoveDoorAt(int32 Index)
+{
+	if (DoorParents[Index].IsValid())
+	{
+		SetOverlapsDeferred(Index, false);
+	}
+
+	DoorIndices.Remove(Doors[Index]);
+	Doors.RemoveAtSwap(Index, 1, false);
+	DoorParents.RemoveAtSwap(Index, 1, false);
+	Rotations.RemoveAtSwap(Index, 1, false);
+	StartYaws.RemoveAtSwap(Index, 1, false);
+	TargetYaws.RemoveAtSwap(Index, 1, false);
+	StartTimes.RemoveAtSwap(Index, 1, false);
+	InterpSpeeds.RemoveAtSwap(Index, 1, false);
+	Curves.RemoveAtSwap(Index, 1, false);
+	CurveEnds.RemoveAtSwap(Index, 1, false);
+	SweptCenters.RemoveAtSwap(Index, 1, false);
+	SweptExtents.RemoveAtSwap(Index, 1, false);
+	DefersOverlaps.RemoveAtSwap(Index, 1, false);
+	OverlapsDeferred.RemoveAtSwap(Index, 1, false);
+	if (Doors.IsValidIndex(Index))
+	{
+		DoorIndices.Add(Doors[Index], Index);
+	}
+}
+
+bool UDoorAnimationSubsystem::IsSweptVolumeClear(int32 Index) const
+{
+	FCollisionObjectQueryParams ObjectQueryParams;
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_Pawn);
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_PhysicsBody);
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(DoorSweptVolume), false, DoorParents[Index]->GetOwner());
+
+	return !GetWorld()->OverlapAnyTestByObjectType(SweptCenters[Index], FQuat::Identity, ObjectQueryParams, FCollisionShape::MakeBox(SweptExtents[Index]), QueryParams);
+}
+
+void UDoorAnimationSubsystem::SetOverlapsDeferred(int32 Index, bool bNewDeferred)
+{
+	if (OverlapsDeferred[Index] == bNewDeferred)
+	{
+		return;
+	}
+
+	//While deferred the door doesn't generate overlap events, so moving it doesn't update any; the overlaps are brought up to date in one go when it's restored
+	UPrimitiveComponent* DoorPrimitive = CastChecked<UPrimitiveComponent>(DoorParents[Index].Get());
+	if (bNewDeferred && !DoorPrimitive->GetGenerateOverlapEvents())
+	{
+		return;
+	}
+	OverlapsDeferred[Index] = bNewDeferred;
+	DoorPrimitive->SetGenerateOverlapEvents(!bNewDeferred);
+	if (!bNewDeferred)
+	{
+		DoorPrimitive->UpdateOverlaps();
+	}
+}
+
+int32 UDoorAnimationSubsystem::GetMovingDoorCount() const
+{
+	return Doors.Num();
+}
+
+float UDoorAnimationSubsystem::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
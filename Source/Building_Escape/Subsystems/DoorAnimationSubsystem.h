@@ -0,0 +1,76 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "DoorAnimationSubsystem.generated.h"
+
+class UOpenDoor;
+class USceneComponent;
+class UCurveFloat;
+
+/**
+ * Animates every door of the world that is in motion, and only those. Doors are woken when they are told to open or close, or when their minimum open time ends,
+ * and are dropped again as soon as they settle at their target, so doors that don't move cost nothing and the subsystem doesn't tick while none of them moves.
+ * The pose is evaluated from the door's motion state at the current server time rather than integrated, so the server and every client show the same pose.
+ * Doors are moved as kinematic bodies without teleporting, so physics pushes the props and held objects in their way instead of the door clipping through them.
+ * Doors that allow it skip their overlap updates while no pawn or physics body is within the volume they sweep, and catch up once something comes close or they settle.
+ * The settle tolerance is read from the [/Script/Building_Escape.DoorAnimationSubsystem] section of DefaultGame.ini.
+ */
+UCLASS(Config = Game)
+class BUILDING_ESCAPE_API UDoorAnimationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//Starts animating the door along its motion state, or takes the new state over if it's already moving; a motion that already ended just moves the door to its end
+	void WakeDoor(UOpenDoor* Door);
+	//Stops animating the door where it is
+	void RemoveDoor(UOpenDoor* Door);
+
+	UFUNCTION(BlueprintPure, Category = "Door Animation")
+	int32 GetMovingDoorCount() const;
+
+	//Server world time as far as this machine knows it; the clock door motions are evaluated against
+	float GetServerTime() const;
+
+private:
+	//Moving doors, one entry per door at the same index in every array
+	TArray<UOpenDoor*> Doors;
+	//Held weakly, a parent can be destroyed while its door is moving; the door is dropped on the next tick
+	TArray<TWeakObjectPtr<USceneComponent>> DoorParents;
+	//Only pitch and roll are used; the yaw is evaluated every frame
+	TArray<FRotator> Rotations;
+	TArray<float> StartYaws;
+	TArray<float> TargetYaws;
+	TArray<float> StartTimes;
+	TArray<float> InterpSpeeds;
+	TArray<UCurveFloat*> Curves;
+	//Time the curve reaches its end at, after which the door has settled
+	TArray<float> CurveEnds;
+	//Box around the hinge that holds the door at any yaw
+	TArray<FVector> SweptCenters;
+	TArray<FVector> SweptExtents;
+	TArray<bool> DefersOverlaps;
+	TArray<bool> OverlapsDeferred;
+	TMap<const UOpenDoor*, int32> DoorIndices;
+
+	void RemoveDoorAt(int32 Index);
+	bool IsSettled(int32 Index, float Elapsed, float Yaw) const;
+	bool IsSweptVolumeClear(int32 Index) const;
+	void SetOverlapsDeferred(int32 Index, bool bNewDeferred);
+
+	//Doors closer than this to their target yaw, in degrees, are snapped to it and stop moving
+	UPROPERTY(Config)
+	float SettleTolerance = 0.05f;
+};
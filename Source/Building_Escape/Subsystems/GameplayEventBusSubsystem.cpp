@@ -0,0 +1,91 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "GameplayEventBusSubsystem.h"
+#include "Components/Interactable.h"
+#include "Components/MassTreshold.h"
+#include "Engine/World.h"
+
+bool FParkourStateEvent::TryMerge(const FParkourStateEvent& Later)
+{
+	NewState = Later.NewState;
+	return true;
+}
+
+bool FParkourStateEvent::HasBlueprintListeners() const
+{
+	return Source.IsValid() && Source->ParkourMovementStateChangedDelegate.IsBound();
+}
+
+void FParkourStateEvent::BroadcastToBlueprint() const
+{
+	Source->ParkourMovementStateChangedDelegate.Broadcast(PreviousState, NewState);
+}
+
+bool FHangingStateEvent::TryMerge(const FHangingStateEvent& Later)
+{
+	bIsHanging = Later.bIsHanging;
+	return true;
+}
+
+bool FHangingStateEvent::HasBlueprintListeners() const
+{
+	return Source.IsValid() && Source->HangingStateChanged.IsBound();
+}
+
+void FHangingStateEvent::BroadcastToBlueprint() const
+{
+	Source->HangingStateChanged.Broadcast(bIsHanging);
+}
+
+bool FFocusStateEvent::TryMerge(const FFocusStateEvent& Later)
+{
+	NewState = Later.NewState;
+	return true;
+}
+
+bool FMassTresholdEvent::TryMerge(const FMassTresholdEvent& Later)
+{
+	bIsAboveTreshold = Later.bIsAboveTreshold;
+	return true;
+}
+
+bool FMassTresholdEvent::HasBlueprintListeners() const
+{
+	return Source.IsValid() && Source->ResultChanged.IsBound();
+}
+
+void FMassTresholdEvent::BroadcastToBlueprint() const
+{
+	Source->ResultChanged.Broadcast(bIsAboveTreshold);
+}
+
+void UGameplayEventBusSubsystem::Deinitialize()
+{
+	ParkourState.Reset();
+	HangingState.Reset();
+	FocusState.Reset();
+	Interaction.Reset();
+	MassTreshold.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UGameplayEventBusSubsystem::IsTickable() const
+{
+	return ParkourState.HasPending() || HangingState.HasPending() || FocusState.HasPending() || Interaction.HasPending() || MassTreshold.HasPending();
+}
+
+TStatId UGameplayEventBusSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGameplayEventBusSubsystem, STATGROUP_Tickables);
+}
+
+void UGameplayEventBusSubsystem::Tick(float DeltaTime)
+{
+	ParkourState.Flush();
+	HangingState.Flush();
+	FocusState.Flush();
+	Interaction.Flush();
+	MassTreshold.Flush();
+}
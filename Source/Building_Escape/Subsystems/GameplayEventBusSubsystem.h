@@ -0,0 +1,161 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "InteractionSystemLibrary.h"
+#include "Components/ParkourMovementComponent.h"
+#include "GameplayEventBusSubsystem.generated.h"
+
+class UInteractable;
+class UMassTreshold;
+
+//Events of the bus. Each one knows how to merge with a later event of the same source within the frame, whether the merged result still changes anything,
+//and how to reach the Blueprint delegate of its source, which is only done when something is bound to it.
+//Sources are held weakly; they can be destroyed before the end of the frame, or before the next one for the focus changes the registry posts
+
+struct BUILDING_ESCAPE_API FParkourStateEvent
+{
+	TWeakObjectPtr<UParkourMovementComponent> Source;
+	TEnumAsByte<EParkourMovementState> PreviousState = ParkourState_Walk;
+	TEnumAsByte<EParkourMovementState> NewState = ParkourState_Walk;
+
+	bool TryMerge(const FParkourStateEvent& Later);
+	bool IsNoOp() const { return PreviousState == NewState; }
+	bool HasBlueprintListeners() const;
+	void BroadcastToBlueprint() const;
+};
+
+struct BUILDING_ESCAPE_API FHangingStateEvent
+{
+	TWeakObjectPtr<UParkourMovementComponent> Source;
+	bool bWasHanging = false;
+	bool bIsHanging = false;
+
+	bool TryMerge(const FHangingStateEvent& Later);
+	bool IsNoOp() const { return bWasHanging == bIsHanging; }
+	bool HasBlueprintListeners() const;
+	void BroadcastToBlueprint() const;
+};
+
+//Focus changes are already coalesced by the interactable registry, which also broadcasts the Blueprint delegate
+struct BUILDING_ESCAPE_API FFocusStateEvent
+{
+	TWeakObjectPtr<UInteractable> Source;
+	TEnumAsByte<EFocusState> PreviousState = InactiveState;
+	TEnumAsByte<EFocusState> NewState = InactiveState;
+
+	bool TryMerge(const FFocusStateEvent& Later);
+	bool IsNoOp() const { return PreviousState == NewState; }
+	bool HasBlueprintListeners() const { return false; }
+	void BroadcastToBlueprint() const {}
+};
+
+//Interactions are commands rather than states, so only exact repeats within the frame are dropped; their Blueprint delegates are broadcast right away by the interactable
+struct BUILDING_ESCAPE_API FInteractionEvent
+{
+	TWeakObjectPtr<UInteractable> Source;
+	bool bIsStart = true;
+
+	bool TryMerge(const FInteractionEvent& Later) { return bIsStart == Later.bIsStart; }
+	bool IsNoOp() const { return false; }
+	bool HasBlueprintListeners() const { return false; }
+	void BroadcastToBlueprint() const {}
+};
+
+struct BUILDING_ESCAPE_API FMassTresholdEvent
+{
+	TWeakObjectPtr<UMassTreshold> Source;
+	bool bWasAboveTreshold = false;
+	bool bIsAboveTreshold = false;
+
+	bool TryMerge(const FMassTresholdEvent& Later);
+	bool IsNoOp() const { return bWasAboveTreshold == bIsAboveTreshold; }
+	bool HasBlueprintListeners() const;
+	void BroadcastToBlueprint() const;
+};
+
+//Queue and listeners of a single event type. Events nobody listens to, natively or in Blueprint, are dropped as soon as they are posted
+template <typename EventType>
+class TGameplayEventChannel
+{
+public:
+	DECLARE_MULTICAST_DELEGATE_OneParam(FListeners, const EventType&);
+	FListeners Listeners;
+
+	void Post(const EventType& Event)
+	{
+		if (!Listeners.IsBound() && !Event.HasBlueprintListeners())
+		{
+			return;
+		}
+
+		//Only the latest queued event of the same source can absorb the new one, so the order of events that can't be merged is kept.
+		//Queues rarely hold more than a handful of events, so this is a linear search
+		for (int32 Index = Queue.Num() - 1; Index >= 0; Index--)
+		{
+			if (Queue[Index].Source != Event.Source) { continue; }
+			if (Queue[Index].TryMerge(Event)) { return; }
+			break;
+		}
+		Queue.Add(Event);
+	}
+
+	bool HasPending() const { return Queue.Num() > 0; }
+
+	void Flush()
+	{
+		//Listeners can post again while the queue is flushed; those events are delivered next frame
+		Swap(Queue, FlushedQueue);
+		for (const EventType& Event : FlushedQueue)
+		{
+			//Events of sources destroyed since they were posted are dropped
+			if (Event.IsNoOp() || !Event.Source.IsValid()) { continue; }
+
+			Listeners.Broadcast(Event);
+			if (Event.HasBlueprintListeners())
+			{
+				Event.BroadcastToBlueprint();
+			}
+		}
+		FlushedQueue.Reset();
+	}
+
+	void Reset()
+	{
+		Queue.Empty();
+		FlushedQueue.Empty();
+	}
+
+private:
+	TArray<EventType> Queue;
+	TArray<EventType> FlushedQueue;
+};
+
+/**
+ * Typed, native event bus for the gameplay notifications C++ systems(UI, analytics, audio) react to, without going through reflection.
+ * Events posted during a frame are merged per source, so a state that changed several times is delivered once with its first previous and last new value,
+ * and changes that ended where they started are dropped. Everything is delivered at the end of the frame.
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UGameplayEventBusSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	TGameplayEventChannel<FParkourStateEvent> ParkourState;
+	TGameplayEventChannel<FHangingStateEvent> HangingState;
+	TGameplayEventChannel<FFocusStateEvent> FocusState;
+	TGameplayEventChannel<FInteractionEvent> Interaction;
+	TGameplayEventChannel<FMassTresholdEvent> MassTreshold;
+};
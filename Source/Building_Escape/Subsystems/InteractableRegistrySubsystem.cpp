@@ -0,0 +1,247 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "InteractableRegistrySubsystem.h"
+#include "Components/Interactable.h"
+#include "Components/PrimitiveComponent.h"
+#include "ConvexVolume.h"
+#include "Subsystems/GameplayEventBusSubsystem.h"
+
+void UInteractableRegistrySubsystem::Deinitialize()
+{
+	for (FInteractableEntry& Entry : Entries)
+	{
+		if (Entry.Interactable)
+		{
+			Entry.Interactable->TransformUpdated.Remove(Entry.TransformUpdatedHandle);
+		}
+	}
+	Entries.Empty();
+	FreeSlots.Empty();
+	SlotLookup.Empty();
+	Grid.Empty();
+	CellRevisions.Empty();
+	QueuedFocusChanges.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UInteractableRegistrySubsystem::IsTickable() const
+{
+	return QueuedFocusChanges.Num() > 0;
+}
+
+TStatId UInteractableRegistrySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UInteractableRegistrySubsystem, STATGROUP_Tickables);
+}
+
+void UInteractableRegistrySubsystem::Tick(float DeltaTime)
+{
+	Swap(QueuedFocusChanges, FlushedFocusChanges);
+	FocusChanges.Reset();
+
+	for (UInteractable* Interactable : FlushedFocusChanges)
+	{
+		const int32* Slot = SlotLookup.Find(Interactable);
+		TEnumAsByte<EFocusState> PreviousState;
+		if (!Slot || !Interactable->FlushFocusStateChange(OUT PreviousState)) { continue; }
+
+		FInteractableFocusChange& FocusChange = FocusChanges.AddDefaulted_GetRef();
+		FocusChange.Handle.Slot = *Slot;
+		FocusChange.Handle.Generation = Entries[*Slot].Generation;
+		FocusChange.PreviousState = PreviousState;
+		FocusChange.NewState = Interactable->GetFocusState();
+	}
+	FlushedFocusChanges.Reset();
+
+	if (FocusChanges.Num() > 0)
+	{
+		OnFocusStatesChanged.Broadcast(FocusChanges);
+	}
+
+	//The same changes are offered to the native listeners of the event bus, one event per interactable
+	UGameplayEventBusSubsystem* EventBus = GetWorld()->GetSubsystem<UGameplayEventBusSubsystem>();
+	if (!EventBus || !EventBus->FocusState.Listeners.IsBound())
+	{
+		return;
+	}
+	for (const FInteractableFocusChange& FocusChange : FocusChanges)
+	{
+		FFocusStateEvent Event;
+		Event.Source = Resolve(FocusChange.Handle);
+		Event.PreviousState = FocusChange.PreviousState;
+		Event.NewState = FocusChange.NewState;
+		EventBus->FocusState.Post(Event);
+	}
+}
+
+void UInteractableRegistrySubsystem::QueueFocusStateChange(UInteractable* Interactable)
+{
+	QueuedFocusChanges.AddUnique(Interactable);
+}
+
+void UInteractableRegistrySubsystem::RegisterInteractable(UInteractable* Interactable)
+{
+	if (!Interactable || SlotLookup.Contains(Interactable))
+	{
+		return;
+	}
+
+	const int32 Slot = FreeSlots.Num() > 0 ? FreeSlots.Pop(false) : Entries.AddDefaulted();
+	FInteractableEntry& Entry = Entries[Slot];
+	Entry.Interactable = Interactable;
+	Entry.Location = Interactable->GetComponentLocation();
+	Entry.BoundsRadius = Interactable->GetOwningPrimitive() ? Interactable->GetOwningPrimitive()->Bounds.SphereRadius : 0.f;
+	Entry.Cell = GetCell(Entry.Location);
+	//Static interactables never fire this; props that are carried or pushed around keep their cell up to date through it
+	Entry.TransformUpdatedHandle = Interactable->TransformUpdated.AddUObject(this, &UInteractableRegistrySubsystem::OnInteractableMoved, Slot);
+
+	SlotLookup.Add(Interactable, Slot);
+	AddToCell(Slot);
+	StampCell(Entry.Cell);
+}
+
+void UInteractableRegistrySubsystem::UnregisterInteractable(UInteractable* Interactable)
+{
+	int32 Slot;
+	if (!SlotLookup.RemoveAndCopyValue(Interactable, Slot))
+	{
+		return;
+	}
+
+	FInteractableEntry& Entry = Entries[Slot];
+	Interactable->TransformUpdated.Remove(Entry.TransformUpdatedHandle);
+	RemoveFromCell(Slot);
+	StampCell(Entry.Cell);
+	//Listeners drop the handle on their own once it stops resolving, so queued changes of the interactable are simply forgotten
+	QueuedFocusChanges.Remove(Interactable);
+
+	const uint32 NextGeneration = Entry.Generation + 1;
+	Entry = FInteractableEntry();
+	Entry.Generation = NextGeneration;
+	FreeSlots.Add(Slot);
+}
+
+void UInteractableRegistrySubsystem::NotifyInteractableChanged(UInteractable* Interactable)
+{
+	if (const int32* Slot = SlotLookup.Find(Interactable))
+	{
+		StampCell(Entries[*Slot].Cell);
+	}
+}
+
+uint32 UInteractableRegistrySubsystem::GetRevision(const FVector& Origin, float Range) const
+{
+	const FIntVector MinCell = GetCell(Origin - FVector(Range));
+	const FIntVector MaxCell = GetCell(Origin + FVector(Range));
+	uint32 LatestRevision = 0;
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+			{
+				if (const uint32* CellRevision = CellRevisions.Find(FIntVector(X, Y, Z)))
+				{
+					LatestRevision = FMath::Max(LatestRevision, *CellRevision);
+				}
+			}
+		}
+	}
+	return LatestRevision;
+}
+
+void UInteractableRegistrySubsystem::QueryInteractables(const FVector& Origin, float Range, const FConvexVolume* Frustum, TArray<FInteractableHandle>& OutHandles) const
+{
+	const FIntVector MinCell = GetCell(Origin - FVector(Range));
+	const FIntVector MaxCell = GetCell(Origin + FVector(Range));
+	const float RangeSquared = FMath::Square(Range);
+
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+			{
+				const TArray<int32>* CellSlots = Grid.Find(FIntVector(X, Y, Z));
+				if (!CellSlots) { continue; }
+
+				for (int32 Slot : *CellSlots)
+				{
+					const FInteractableEntry& Entry = Entries[Slot];
+					if (FVector::DistSquared(Origin, Entry.Location) > RangeSquared) { continue; }
+					if (Frustum && !Frustum->IntersectSphere(Entry.Location, Entry.BoundsRadius)) { continue; }
+
+					FInteractableHandle Handle;
+					Handle.Slot = Slot;
+					Handle.Generation = Entry.Generation;
+					OutHandles.Add(Handle);
+				}
+			}
+		}
+	}
+}
+
+UInteractable* UInteractableRegistrySubsystem::Resolve(const FInteractableHandle& Handle) const
+{
+	if (!Entries.IsValidIndex(Handle.Slot) || Entries[Handle.Slot].Generation != Handle.Generation)
+	{
+		return nullptr;
+	}
+	return Entries[Handle.Slot].Interactable;
+}
+
+int32 UInteractableRegistrySubsystem::GetSlotCount() const
+{
+	return Entries.Num();
+}
+
+FIntVector UInteractableRegistrySubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+void UInteractableRegistrySubsystem::AddToCell(int32 Slot)
+{
+	Grid.FindOrAdd(Entries[Slot].Cell).Add(Slot);
+}
+
+void UInteractableRegistrySubsystem::RemoveFromCell(int32 Slot)
+{
+	const FIntVector Cell = Entries[Slot].Cell;
+	TArray<int32>* CellSlots = Grid.Find(Cell);
+	if (!CellSlots)
+	{
+		return;
+	}
+
+	CellSlots->RemoveSingleSwap(Slot, false);
+	if (CellSlots->Num() == 0)
+	{
+		Grid.Remove(Cell);
+	}
+}
+
+void UInteractableRegistrySubsystem::OnInteractableMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport, int32 Slot)
+{
+	FInteractableEntry& Entry = Entries[Slot];
+	Entry.Location = UpdatedComponent->GetComponentLocation();
+
+	//Most moves stay within the same cell, which only costs the location update and the stamp
+	const FIntVector NewCell = GetCell(Entry.Location);
+	if (NewCell != Entry.Cell)
+	{
+		RemoveFromCell(Slot);
+		StampCell(Entry.Cell);
+		Entry.Cell = NewCell;
+		AddToCell(Slot);
+	}
+	StampCell(Entry.Cell);
+}
+
+void UInteractableRegistrySubsystem::StampCell(const FIntVector& Cell)
+{
+	Revision++;
+	CellRevisions.FindOrAdd(Cell) = Revision;
+}
@@ -0,0 +1,128 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "InteractionSystemLibrary.h"
+#include "InteractableRegistrySubsystem.generated.h"
+
+class UInteractable;
+class USceneComponent;
+struct FConvexVolume;
+struct FCheckpoint;
+
+//Refers to a registered interactable by its slot; the generation tells a slot reused by another interactable apart from the one the handle was made for
+struct FInteractableHandle
+{
+	int32 Slot = INDEX_NONE;
+	uint32 Generation = 0;
+
+	bool IsSet() const { return Slot != INDEX_NONE; }
+	bool operator==(const FInteractableHandle& Other) const { return Slot == Other.Slot && Generation == Other.Generation; }
+	bool operator!=(const FInteractableHandle& Other) const { return !(*this == Other); }
+};
+
+//The focus state of an interactable as it changed over a single frame; intermediate states within the frame aren't reported
+struct FInteractableFocusChange
+{
+	FInteractableHandle Handle;
+	TEnumAsByte<EFocusState> PreviousState = InactiveState;
+	TEnumAsByte<EFocusState> NewState = InactiveState;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FInteractableFocusChangesDelegate, const TArray<FInteractableFocusChange>&);
+
+//Open while an interactor applies an interaction. On a predicting client, doors and interactables record their state into the rollback state before the interaction changes them;
+//on the server, doors that start moving within it start at the time the client predicted them at, so the confirmed motion matches the predicted one
+struct FInteractionWindow
+{
+	FCheckpoint* RollbackState = nullptr;
+	float MotionStartTime = 0.f;
+};
+
+/**
+ * Keeps every interactable of the world in a uniform grid so interactors can find the candidates around them without any overlap events.
+ * Interactables register on BeginPlay and leave on EndPlay(including when their streaming cell unloads); moving interactables update their grid cell as they move.
+ * Focus and mark changes are collected over the frame and sent out once at its end as a single change list.
+ * The cell size is read from the [/Script/Building_Escape.InteractableRegistrySubsystem] section of DefaultGame.ini.
+ */
+UCLASS(Config = Game)
+class BUILDING_ESCAPE_API UInteractableRegistrySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	void RegisterInteractable(UInteractable* Interactable);
+	void UnregisterInteractable(UInteractable* Interactable);
+
+	//Appends the handle of every registered interactable within Range from Origin whose bounds intersect the frustum(if one is given) to OutHandles
+	void QueryInteractables(const FVector& Origin, float Range, const FConvexVolume* Frustum, TArray<FInteractableHandle>& OutHandles) const;
+
+	//Interactables call this when something the interactors evaluate changed without the interactable moving, like its activity
+	void NotifyInteractableChanged(UInteractable* Interactable);
+	//Every registration, unregistration, move and change stamps the cells it touches with a new revision; this is the latest stamp of the cells within Range
+	//from Origin, so interactors skip their evaluation while nothing changed around them, no matter what moves elsewhere
+	uint32 GetRevision(const FVector& Origin, float Range) const;
+
+	//Interactables call this whenever their focus state changes; the change is reported at the end of the frame, once, and only if the state differs from the last reported one
+	void QueueFocusStateChange(UInteractable* Interactable);
+	//Broadcast at the end of every frame in which a focus state changed
+	FInteractableFocusChangesDelegate OnFocusStatesChanged;
+
+	//Set by an interactor for as long as it applies an interaction; nullptr otherwise
+	void SetInteractionWindow(const FInteractionWindow* Window) { InteractionWindow = Window; }
+	const FInteractionWindow* GetInteractionWindow() const { return InteractionWindow; }
+
+	//Returns nullptr once the interactable the handle was made for has left the registry
+	UInteractable* Resolve(const FInteractableHandle& Handle) const;
+	//Slots are numbered from 0 to this; users can keep their own per slot data in plain arrays of this size
+	int32 GetSlotCount() const;
+
+private:
+	struct FInteractableEntry
+	{
+		UInteractable* Interactable = nullptr;
+		//Increased every time the slot is freed, which invalidates all the handles to it
+		uint32 Generation = 1;
+		FVector Location = FVector::ZeroVector;
+		//Radius of the bounds of the owning primitive; used for the frustum test
+		float BoundsRadius = 0.f;
+		FIntVector Cell = FIntVector::ZeroValue;
+		FDelegateHandle TransformUpdatedHandle;
+	};
+
+	//Entries never move once added, freed slots are reused by the next registration
+	TArray<FInteractableEntry> Entries;
+	TArray<int32> FreeSlots;
+	TMap<UInteractable*, int32> SlotLookup;
+	TMap<FIntVector, TArray<int32>> Grid;
+	uint32 Revision = 0;
+	//Cells keep their last stamp even once they're empty, so a removal still counts as a change
+	TMap<FIntVector, uint32> CellRevisions;
+	const FInteractionWindow* InteractionWindow = nullptr;
+
+	//The queue is swapped out before it's flushed, so changes queued by the listeners end up in the next frame
+	TArray<UInteractable*> QueuedFocusChanges;
+	TArray<UInteractable*> FlushedFocusChanges;
+	TArray<FInteractableFocusChange> FocusChanges;
+
+	FIntVector GetCell(const FVector& Location) const;
+	void AddToCell(int32 Slot);
+	void RemoveFromCell(int32 Slot);
+	void StampCell(const FIntVector& Cell);
+	void OnInteractableMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport, int32 Slot);
+
+	//Edge length of a single grid cell; roughly the interaction range works best
+	UPROPERTY(Config)
+	float CellSize = 400.f;
+};
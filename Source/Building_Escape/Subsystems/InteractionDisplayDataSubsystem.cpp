@@ -0,0 +1,190 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "InteractionDisplayDataSubsystem.h"
+#include "Components/Interactable.h"
+#include "Engine/DataTable.h"
+#include "Engine/Texture2D.h"
+#include "GameFramework/Actor.h"
+
+void UInteractionDisplayDataSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CacheDisplayDataTable();
+	CacheClassOverrides();
+	CacheParkourStateIcons();
+}
+
+void UInteractionDisplayDataSubsystem::Deinitialize()
+{
+	DisplayData.Empty();
+	InteractionTypeIndices.Empty();
+	ParkourStateIcons.Empty();
+	RowIndices.Empty();
+	OverrideClasses.Empty();
+	ClassOverrideIndices.Empty();
+	ResolvedClassIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+void UInteractionDisplayDataSubsystem::CacheDisplayDataTable()
+{
+	UDataTable* Table = Cast<UDataTable>(DisplayDataTable.TryLoad());
+	if (!Table || !Table->GetRowStruct())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Interaction display data table %s couldn't be loaded, interactions will have no display data!"), *DisplayDataTable.ToString());
+		return;
+	}
+
+	//The row struct is defined in Blueprint, so its fields are read by their authored names rather than through a native struct
+	const UScriptStruct* RowStruct = Table->GetRowStruct();
+	for (const TPair<FName, uint8*>& Row : Table->GetRowMap())
+	{
+		FInteractionDisplayData& Data = DisplayData.AddDefaulted_GetRef();
+		Data.RowName = Row.Key;
+		Data.DisplayName = FText::FromName(Row.Key);
+
+		for (TFieldIterator<FProperty> PropertyIterator(RowStruct); PropertyIterator; ++PropertyIterator)
+		{
+			const FProperty* Property = *PropertyIterator;
+			const FString FieldName = RowStruct->GetAuthoredNameForField(Property);
+
+			if (const FTextProperty* TextProperty = CastField<FTextProperty>(Property))
+			{
+				if (FieldName == TEXT("InteractionName"))
+				{
+					Data.DisplayName = TextProperty->GetPropertyValue_InContainer(Row.Value);
+				}
+			}
+			else if (const FSoftObjectProperty* SoftObjectProperty = CastField<FSoftObjectProperty>(Property))
+			{
+				if (!Data.Icon)
+				{
+					Data.Icon = Cast<UTexture2D>(SoftObjectProperty->GetPropertyValue_InContainer(Row.Value).LoadSynchronous());
+				}
+			}
+			else if (const FObjectProperty* ObjectProperty = CastField<FObjectProperty>(Property))
+			{
+				if (!Data.Icon)
+				{
+					Data.Icon = Cast<UTexture2D>(ObjectProperty->GetObjectPropertyValue_InContainer(Row.Value));
+				}
+			}
+		}
+
+		RowIndices.Add(Row.Key, DisplayData.Num() - 1);
+	}
+
+	//Interaction types show the row named after them(Use, Hold)
+	const UEnum* InteractionTypeEnum = StaticEnum<EInteractionType>();
+	InteractionTypeIndices.Init(INDEX_NONE, InteractionTypeEnum->NumEnums() - 1);
+	for (int32 TypeIndex = 0; TypeIndex < InteractionTypeIndices.Num(); TypeIndex++)
+	{
+		const FName RowName(*InteractionTypeEnum->GetNameStringByIndex(TypeIndex));
+		InteractionTypeIndices[TypeIndex] = FindDisplayDataIndex(RowName);
+		if (InteractionTypeIndices[TypeIndex] == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s has no row for interaction type %s!"), *Table->GetName(), *RowName.ToString());
+		}
+	}
+}
+
+void UInteractionDisplayDataSubsystem::CacheClassOverrides()
+{
+	for (const FInteractionDisplayClassOverride& Override : ClassOverrides)
+	{
+		UClass* Class = Override.Class.LoadSynchronous();
+		const int32 RowIndex = FindDisplayDataIndex(Override.Row);
+		if (!Class || RowIndex == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Interaction display override %s -> %s couldn't be resolved and was skipped!"), *Override.Class.ToString(), *Override.Row.ToString());
+			continue;
+		}
+
+		OverrideClasses.Add(Class);
+		ClassOverrideIndices.Add(Class, RowIndex);
+	}
+}
+
+void UInteractionDisplayDataSubsystem::CacheParkourStateIcons()
+{
+	ParkourStateIcons.Init(nullptr, StaticEnum<EParkourMovementState>()->NumEnums() - 1);
+	for (const FParkourStateIcon& StateIcon : ParkourStateIconAssets)
+	{
+		if (!ParkourStateIcons.IsValidIndex(StateIcon.State)) { continue; }
+
+		ParkourStateIcons[StateIcon.State] = StateIcon.Icon.LoadSynchronous();
+		if (!ParkourStateIcons[StateIcon.State])
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Parkour state icon %s couldn't be loaded!"), *StateIcon.Icon.ToString());
+		}
+	}
+}
+
+int32 UInteractionDisplayDataSubsystem::FindDisplayDataIndex(const UInteractable* Interactable)
+{
+	if (!Interactable)
+	{
+		return INDEX_NONE;
+	}
+
+	//The component class is more specific than the class of the actor owning it
+	if (ClassOverrideIndices.Num() > 0)
+	{
+		int32 RowIndex = ResolveClassIndex(Interactable->GetClass());
+		if (RowIndex == INDEX_NONE && Interactable->GetOwner())
+		{
+			RowIndex = ResolveClassIndex(Interactable->GetOwner()->GetClass());
+		}
+		if (RowIndex != INDEX_NONE)
+		{
+			return RowIndex;
+		}
+	}
+
+	return FindDisplayDataIndex(Interactable->GetInteractionType());
+}
+
+int32 UInteractionDisplayDataSubsystem::FindDisplayDataIndex(TEnumAsByte<EInteractionType> InteractionType) const
+{
+	return InteractionTypeIndices.IsValidIndex(InteractionType) ? InteractionTypeIndices[InteractionType] : INDEX_NONE;
+}
+
+int32 UInteractionDisplayDataSubsystem::FindDisplayDataIndex(FName RowName) const
+{
+	const int32* RowIndex = RowIndices.Find(RowName);
+	return RowIndex ? *RowIndex : INDEX_NONE;
+}
+
+int32 UInteractionDisplayDataSubsystem::ResolveClassIndex(const UClass* Class)
+{
+	if (const int32* ResolvedIndex = ResolvedClassIndices.Find(Class))
+	{
+		return *ResolvedIndex;
+	}
+
+	int32 RowIndex = INDEX_NONE;
+	for (const UClass* SuperClass = Class; SuperClass; SuperClass = SuperClass->GetSuperClass())
+	{
+		if (const int32* OverrideIndex = ClassOverrideIndices.Find(SuperClass))
+		{
+			RowIndex = *OverrideIndex;
+			break;
+		}
+	}
+
+	ResolvedClassIndices.Add(Class, RowIndex);
+	return RowIndex;
+}
+
+FInteractionDisplayData UInteractionDisplayDataSubsystem::GetDisplayDataForType(TEnumAsByte<EInteractionType> InteractionType) const
+{
+	return GetDisplayDataAt(FindDisplayDataIndex(InteractionType));
+}
+
+FInteractionDisplayData UInteractionDisplayDataSubsystem::GetDisplayDataForRow(FName RowName) const
+{
+	return GetDisplayDataAt(FindDisplayDataIndex(RowName));
+}
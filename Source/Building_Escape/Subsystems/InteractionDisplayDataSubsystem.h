@@ -0,0 +1,123 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "InteractionSystemLibrary.h"
+#include "Components/ParkourMovementComponent.h"
+#include "InteractionDisplayDataSubsystem.generated.h"
+
+class UInteractable;
+class UTexture2D;
+
+//Display data of a single row of dt_InteractionDisplayData, with every reference already resolved
+USTRUCT(BlueprintType)
+struct FInteractionDisplayData
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Interaction")
+	FName RowName;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Interaction")
+	FText DisplayName;
+
+	//Null if the row doesn't reference a texture
+	UPROPERTY(BlueprintReadOnly, Category = "Interaction")
+	UTexture2D* Icon = nullptr;
+};
+
+//Makes interactables of Class(an interactable component class or the class of the actor owning it) show Row instead of the row of their interaction type
+USTRUCT()
+struct FInteractionDisplayClassOverride
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	TSoftClassPtr<UObject> Class;
+
+	UPROPERTY(Config)
+	FName Row;
+};
+
+USTRUCT()
+struct FParkourStateIcon
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	TEnumAsByte<EParkourMovementState> State = ParkourState_Walk;
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UTexture2D> Icon;
+};
+
+/**
+ * Reads dt_InteractionDisplayData once when the game instance starts and keeps every row, and the textures of the parkour states, resolved and referenced for its whole lifetime.
+ * Rows are indexed by interaction type and by interactable class, so the HUD and the interactables get their display data through an array access instead of
+ * string keyed data table lookups and soft object resolution every time the UI refreshes.
+ * The table, the class overrides and the parkour icons are read from the [/Script/Building_Escape.InteractionDisplayDataSubsystem] section of DefaultGame.ini.
+ */
+UCLASS(Config = Game)
+class BUILDING_ESCAPE_API UInteractionDisplayDataSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	//Index of the row an interactable shows; resolved once per class, so interactables can cache it and read their data with GetDisplayDataAt
+	int32 FindDisplayDataIndex(const UInteractable* Interactable);
+	int32 FindDisplayDataIndex(TEnumAsByte<EInteractionType> InteractionType) const;
+	int32 FindDisplayDataIndex(FName RowName) const;
+
+	//Returns empty display data for INDEX_NONE
+	const FInteractionDisplayData& GetDisplayDataAt(int32 Index) const { return DisplayData.IsValidIndex(Index) ? DisplayData[Index] : EmptyDisplayData; }
+
+	UFUNCTION(BlueprintPure, Category = "Interaction", DisplayName = "Get Interaction Display Data")
+	FInteractionDisplayData GetDisplayDataForType(TEnumAsByte<EInteractionType> InteractionType) const;
+
+	UFUNCTION(BlueprintPure, Category = "Interaction", DisplayName = "Get Interaction Display Data By Row")
+	FInteractionDisplayData GetDisplayDataForRow(FName RowName) const;
+
+	UFUNCTION(BlueprintPure, Category = "Parkour", DisplayName = "Get Parkour State Icon")
+	UTexture2D* GetParkourStateIcon(TEnumAsByte<EParkourMovementState> State) const { return ParkourStateIcons.IsValidIndex(State) ? ParkourStateIcons[State] : nullptr; }
+
+private:
+	void CacheDisplayDataTable();
+	void CacheClassOverrides();
+	void CacheParkourStateIcons();
+	int32 ResolveClassIndex(const UClass* Class);
+
+	//Every row of the table, in table order; the textures they reference are kept loaded through this array
+	UPROPERTY()
+	TArray<FInteractionDisplayData> DisplayData;
+
+	//Indexed by EInteractionType and EParkourMovementState
+	TArray<int32> InteractionTypeIndices;
+	UPROPERTY()
+	TArray<UTexture2D*> ParkourStateIcons;
+
+	TMap<FName, int32> RowIndices;
+	//Configured overrides, keyed by the exact class; the classes are kept loaded so the keys stay valid
+	UPROPERTY()
+	TArray<UClass*> OverrideClasses;
+	TMap<const UClass*, int32> ClassOverrideIndices;
+	//Result of the lookup through the class hierarchy, filled the first time a class asks for its row; INDEX_NONE when the class has no override.
+	//Blueprint classes can be unloaded with their level, so they are keyed by FObjectKey, which never matches a new class reusing the address
+	TMap<FObjectKey, int32> ResolvedClassIndices;
+
+	FInteractionDisplayData EmptyDisplayData;
+
+	UPROPERTY(Config)
+	FSoftObjectPath DisplayDataTable = FSoftObjectPath(TEXT("/Game/Data/dt_InteractionDisplayData.dt_InteractionDisplayData"));
+
+	UPROPERTY(Config)
+	TArray<FInteractionDisplayClassOverride> ClassOverrides;
+
+	UPROPERTY(Config)
+	TArray<FParkourStateIcon> ParkourStateIconAssets;
+};
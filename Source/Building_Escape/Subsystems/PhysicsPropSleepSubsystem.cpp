@@ -0,0 +1,277 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "PhysicsPropSleepSubsystem.h"
+#include "Components/MassTreshold.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+void UPhysicsPropSleepSubsystem::Deinitialize()
+{
+	//Frozen bodies are given back to the simulation, so nothing stays kinematic if the world outlives the subsystem
+	for (FManagedBody& ManagedBody : Bodies)
+	{
+		if (ManagedBody.bIsFrozen && ManagedBody.Body.IsValid())
+		{
+			Thaw(ManagedBody);
+		}
+	}
+	Bodies.Empty();
+	BodyIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UPhysicsPropSleepSubsystem::IsTickable() const
+{
+	//Clients don't simulate replicated props, so there is nothing to manage there
+	return Bodies.Num() > 0 && GetWorld() && GetWorld()->GetNetMode() != NM_Client;
+}
+
+TStatId UPhysicsPropSleepSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPhysicsPropSleepSubsystem, STATGROUP_Tickables);
+}
+
+void UPhysicsPropSleepSubsystem::Tick(float DeltaTime)
+{
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate >= UpdateInterval)
+	{
+		UpdateBodies(TimeSinceUpdate);
+		TimeSinceUpdate = 0.f;
+	}
+
+	TimeSinceSample += DeltaTime;
+	if (TimeSinceSample >= SampleInterval)
+	{
+		TakeSample();
+		TimeSinceSample = 0.f;
+	}
+}
+
+void UPhysicsPropSleepSubsystem::RegisterBody(UPrimitiveComponent* Body)
+{
+	if (!Body || BodyIndices.Contains(Body))
+	{
+		return;
+	}
+
+	FManagedBody& ManagedBody = Bodies.AddDefaulted_GetRef();
+	ManagedBody.Body = Body;
+	BodyIndices.Add(Body, Bodies.Num() - 1);
+}
+
+void UPhysicsPropSleepSubsystem::UnregisterBody(UPrimitiveComponent* Body)
+{
+	const int32* Index = BodyIndices.Find(Body);
+	if (!Index)
+	{
+		return;
+	}
+
+	const int32 RemovedIndex = *Index;
+	if (Bodies[RemovedIndex].bIsFrozen && Body)
+	{
+		Thaw(Bodies[RemovedIndex]);
+	}
+	RemoveBodyAt(RemovedIndex);
+}
+
+void UPhysicsPropSleepSubsystem::RemoveBodyAt(int32 Index)
+{
+	BodyIndices.Remove(Bodies[Index].Body.Get());
+	Bodies.RemoveAtSwap(Index, 1, false);
+	if (Bodies.IsValidIndex(Index))
+	{
+		BodyIndices.Add(Bodies[Index].Body.Get(), Index);
+	}
+}
+
+void UPhysicsPropSleepSubsystem::WakeBody(UPrimitiveComponent* Body)
+{
+	if (const int32* Index = BodyIndices.Find(Body))
+	{
+		FManagedBody& ManagedBody = Bodies[*Index];
+		if (ManagedBody.bIsFrozen)
+		{
+			Thaw(ManagedBody);
+		}
+		ManagedBody.RestingTime = 0.f;
+	}
+}
+
+void UPhysicsPropSleepSubsystem::GatherPlayerLocations(TArray<FVector, TInlineAllocator<4>>& OutPlayerLocations) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->GetPawn())
+		{
+			OutPlayerLocations.Add(PlayerController->GetPawn()->GetActorLocation());
+		}
+	}
+}
+
+void UPhysicsPropSleepSubsystem::UpdateBodies(float ElapsedTime)
+{
+	TArray<FVector, TInlineAllocator<4>> PlayerLocations;
+	GatherPlayerLocations(PlayerLocations);
+
+	const float WakeRadiusSquared = FMath::Square(WakeRadius);
+	const float FreezeRadiusSquared = FMath::Square(FreezeRadius);
+	for (int32 Index = Bodies.Num() - 1; Index >= 0; Index--)
+	{
+		FManagedBody& ManagedBody = Bodies[Index];
+		UPrimitiveComponent* Body = ManagedBody.Body.Get();
+		if (!Body)
+		{
+			RemoveBodyAt(Index);
+			continue;
+		}
+
+		float ClosestPlayerDistanceSquared = MAX_flt;
+		for (const FVector& PlayerLocation : PlayerLocations)
+		{
+			ClosestPlayerDistanceSquared = FMath::Min(ClosestPlayerDistanceSquared, FVector::DistSquared(PlayerLocation, Body->GetComponentLocation()));
+		}
+
+		if (ManagedBody.bIsFrozen)
+		{
+			if (ClosestPlayerDistanceSquared <= WakeRadiusSquared)
+			{
+				Thaw(ManagedBody);
+			}
+			continue;
+		}
+
+		//Bodies something else made kinematic aren't touched
+		if (!Body->IsSimulatingPhysics())
+		{
+			ManagedBody.RestingTime = 0.f;
+			continue;
+		}
+
+		if (Body->RigidBodyIsAwake())
+		{
+			ManagedBody.RestingTime = 0.f;
+			ManagedBody.bIsKeptOnPlate = false;
+			continue;
+		}
+
+		ManagedBody.RestingTime += ElapsedTime;
+		if (ManagedBody.RestingTime >= FreezeRestTime && ClosestPlayerDistanceSquared > FreezeRadiusSquared && !ManagedBody.bIsKeptOnPlate)
+		{
+			Freeze(ManagedBody);
+		}
+	}
+}
+
+bool UPhysicsPropSleepSubsystem::IsCountedByMassTreshold(UPrimitiveComponent* Body) const
+{
+	//Mass tresholds are attached to the primitive whose overlaps they count
+	TArray<UPrimitiveComponent*> OverlappingComponents;
+	Body->GetOverlappingComponents(OUT OverlappingComponents);
+	for (const UPrimitiveComponent* OverlappingComponent : OverlappingComponents)
+	{
+		for (const USceneComponent* Child : OverlappingComponent->GetAttachChildren())
+		{
+			//The plate decides if it counts the body, so welded and non simulating bodies follow the same rules as its mass
+			const UMassTreshold* MassTreshold = Cast<UMassTreshold>(Child);
+			if (MassTreshold && MassTreshold->IsCountingBody(Body))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void UPhysicsPropSleepSubsystem::Freeze(FManagedBody& ManagedBody)
+{
+	UPrimitiveComponent* Body = ManagedBody.Body.Get();
+
+	//A plate only counts simulating bodies, so the ones on plates stay simulated and are just kept asleep
+	if (IsCountedByMassTreshold(Body))
+	{
+		ManagedBody.bIsKeptOnPlate = true;
+		Body->PutAllRigidBodiesToSleep();
+		return;
+	}
+
+	//A kinematic body doesn't react to hits on its own, so it reports them to get woken up
+	ManagedBody.bIsFrozen = true;
+	ManagedBody.bHadHitNotify = Body->BodyInstance.bNotifyRigidBodyCollision;
+	Body->SetSimulatePhysics(false);
+	Body->SetNotifyRigidBodyCollision(true);
+	Body->OnComponentHit.AddDynamic(this, &UPhysicsPropSleepSubsystem::OnFrozenBodyHit);
+	Stats.Freezes++;
+}
+
+void UPhysicsPropSleepSubsystem::Thaw(FManagedBody& ManagedBody)
+{
+	UPrimitiveComponent* Body = ManagedBody.Body.Get();
+	ManagedBody.bIsFrozen = false;
+	ManagedBody.RestingTime = 0.f;
+
+	Body->OnComponentHit.RemoveDynamic(this, &UPhysicsPropSleepSubsystem::OnFrozenBodyHit);
+	Body->SetNotifyRigidBodyCollision(ManagedBody.bHadHitNotify);
+	Body->SetSimulatePhysics(true);
+	Body->WakeAllRigidBodies();
+	Stats.Wakes++;
+}
+
+void UPhysicsPropSleepSubsystem::OnFrozenBodyHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
+{
+	WakeBody(HitComponent);
+}
+
+void UPhysicsPropSleepSubsystem::TakeSample()
+{
+	FPhysicsPropSleepSample Sample;
+	Sample.Time = GetWorld()->GetTimeSeconds();
+	for (const FManagedBody& ManagedBody : Bodies)
+	{
+		const UPrimitiveComponent* Body = ManagedBody.Body.Get();
+		if (!Body) { continue; }
+
+		Sample.RegisteredBodies++;
+		Sample.FrozenBodies += ManagedBody.bIsFrozen ? 1 : 0;
+		Sample.BodiesKeptOnPlates += ManagedBody.bIsKeptOnPlate ? 1 : 0;
+		if (Body->IsSimulatingPhysics())
+		{
+			Sample.SimulatingBodies++;
+			Sample.AwakeBodies += Body->RigidBodyIsAwake() ? 1 : 0;
+		}
+	}
+
+	Stats.Current = Sample;
+	if (Stats.History.Num() >= HistoryLength && Stats.History.Num() > 0)
+	{
+		Stats.History.RemoveAt(0, 1, false);
+	}
+	Stats.History.Add(Sample);
+}
+
+void UPhysicsPropSleepSubsystem::GetRegisteredBodies(TArray<UPrimitiveComponent*>& OutBodies) const
+{
+	OutBodies.Reset(Bodies.Num());
+	for (const FManagedBody& ManagedBody : Bodies)
+	{
+		if (UPrimitiveComponent* Body = ManagedBody.Body.Get())
+		{
+			OutBodies.Add(Body);
+		}
+	}
+}
+
+FPhysicsPropSleepStats UPhysicsPropSleepSubsystem::GetStats() const
+{
+	return Stats;
+}
+
+void UPhysicsPropSleepSubsystem::ResetStats()
+{
+	Stats = FPhysicsPropSleepStats();
+}
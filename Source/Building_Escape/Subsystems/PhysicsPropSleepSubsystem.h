@@ -0,0 +1,142 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "PhysicsPropSleepSubsystem.generated.h"
+
+class UPrimitiveComponent;
+
+//Body counts of the managed props at one point in time
+USTRUCT(BlueprintType)
+struct FPhysicsPropSleepSample
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	float Time = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	int32 RegisteredBodies = 0;
+
+	//Bodies the physics scene still simulates, asleep or not
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	int32 SimulatingBodies = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	int32 AwakeBodies = 0;
+
+	//Bodies made kinematic by the manager
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	int32 FrozenBodies = 0;
+
+	//Resting bodies that were only put to sleep because a mass treshold counts them
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	int32 BodiesKeptOnPlates = 0;
+};
+
+USTRUCT(BlueprintType)
+struct FPhysicsPropSleepStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	FPhysicsPropSleepSample Current;
+
+	//One sample per sample interval, oldest first
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	TArray<FPhysicsPropSleepSample> History;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	int32 Freezes = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Physics Prop Sleep")
+	int32 Wakes = 0;
+};
+
+/**
+ * Takes resting puzzle props(holdables and weights for mass tresholds) far from every player out of the simulation by making them kinematic,
+ * and brings them back once a player comes close, interacts with them or something hits them.
+ * Props a mass treshold counts are only put to sleep, never made kinematic, so the mass already registered on the plate stays there.
+ * Only runs where the props are simulated, i.e. not on clients. The radii and intervals are read from the [/Script/Building_Escape.PhysicsPropSleepSubsystem] section of DefaultGame.ini.
+ */
+UCLASS(Config = Game)
+class BUILDING_ESCAPE_API UPhysicsPropSleepSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//Registering a body twice does nothing; destroyed bodies are dropped on their own
+	void RegisterBody(UPrimitiveComponent* Body);
+	void UnregisterBody(UPrimitiveComponent* Body);
+	//Brings a frozen body back into the simulation right away, e.g. when it's about to be grabbed
+	void WakeBody(UPrimitiveComponent* Body);
+	//Every managed body that still exists, frozen or not; the props a checkpoint covers
+	void GetRegisteredBodies(TArray<UPrimitiveComponent*>& OutBodies) const;
+
+	UFUNCTION(BlueprintPure, Category = "Physics Prop Sleep")
+	FPhysicsPropSleepStats GetStats() const;
+
+	UFUNCTION(BlueprintCallable, Category = "Physics Prop Sleep")
+	void ResetStats();
+
+private:
+	struct FManagedBody
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Body;
+		//Seconds the body has been resting for, counted in update intervals
+		float RestingTime = 0.f;
+		bool bIsFrozen = false;
+		bool bIsKeptOnPlate = false;
+		bool bHadHitNotify = false;
+	};
+
+	TArray<FManagedBody> Bodies;
+	TMap<const UPrimitiveComponent*, int32> BodyIndices;
+
+	float TimeSinceUpdate = 0.f;
+	float TimeSinceSample = 0.f;
+	FPhysicsPropSleepStats Stats;
+
+	void UpdateBodies(float ElapsedTime);
+	void GatherPlayerLocations(TArray<FVector, TInlineAllocator<4>>& OutPlayerLocations) const;
+	void RemoveBodyAt(int32 Index);
+	void Freeze(FManagedBody& ManagedBody);
+	void Thaw(FManagedBody& ManagedBody);
+	bool IsCountedByMassTreshold(UPrimitiveComponent* Body) const;
+	void TakeSample();
+
+	UFUNCTION()
+	void OnFrozenBodyHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
+
+	UPROPERTY(Config)
+	float UpdateInterval = 0.25f;
+
+	//Frozen bodies closer than this to any player are simulated again
+	UPROPERTY(Config)
+	float WakeRadius = 1500.f;
+
+	//Resting bodies further than this from every player are frozen; larger than WakeRadius so bodies at the edge don't flip every update
+	UPROPERTY(Config)
+	float FreezeRadius = 2500.f;
+
+	//Bodies have to rest this long before they're frozen
+	UPROPERTY(Config)
+	float FreezeRestTime = 2.f;
+
+	UPROPERTY(Config)
+	float SampleInterval = 1.f;
+
+	UPROPERTY(Config)
+	int32 HistoryLength = 120;
+};
@@ -0,0 +1,458 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "PuzzleLogicSubsystem.h"
+#include "Components/Interactable.h"
+#include "Components/MassTreshold.h"
+#include "Components/PuzzleLogicComponent.h"
+#include "Subsystems/GameplayEventBusSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "TimerManager.h"
+
+void UPuzzleLogicSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	//Plates and interactables are followed through the bus, so their changes of a frame reach the graph already merged
+	UGameplayEventBusSubsystem* EventBus = Cast<UGameplayEventBusSubsystem>(Collection.InitializeDependency(UGameplayEventBusSubsystem::StaticClass()));
+	if (EventBus)
+	{
+		MassTresholdHandle = EventBus->MassTreshold.Listeners.AddUObject(this, &UPuzzleLogicSubsystem::OnMassTresholdEvent);
+		InteractionHandle = EventBus->Interaction.Listeners.AddUObject(this, &UPuzzleLogicSubsystem::OnInteractionEvent);
+	}
+}
+
+void UPuzzleLogicSubsystem::Deinitialize()
+{
+	if (UGameplayEventBusSubsystem* EventBus = GetWorld()->GetSubsystem<UGameplayEventBusSubsystem>())
+	{
+		EventBus->MassTreshold.Listeners.Remove(MassTresholdHandle);
+		EventBus->Interaction.Listeners.Remove(InteractionHandle);
+	}
+	Nodes.Empty();
+	Order.Empty();
+	Positions.Empty();
+	SourcePositions.Empty();
+	DirtyHeap.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UPuzzleLogicSubsystem::IsTickable() const
+{
+	//Clients only receive the outputs of the sinks
+	return Nodes.Num() > 0 && GetWorld() && GetWorld()->IsGameWorld() && GetWorld()->GetNetMode() != NM_Client;
+}
+
+TStatId UPuzzleLogicSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPuzzleLogicSubsystem, STATGROUP_Tickables);
+}
+
+void UPuzzleLogicSubsystem::Tick(float DeltaTime)
+{
+	//Nodes register on BeginPlay, so the whole level is compiled at once on the first frame after it loaded
+	if (bNeedsCompile)
+	{
+		Compile();
+	}
+
+	if (DirtyHeap.Num() > 0)
+	{
+		Evaluate();
+	}
+}
+
+void UPuzzleLogicSubsystem::RegisterNode(UPuzzleLogicComponent* Node)
+{
+	if (!Node || Nodes.Contains(Node))
+	{
+		return;
+	}
+
+	Nodes.Add(Node);
+	bNeedsCompile = true;
+}
+
+void UPuzzleLogicSubsystem::UnregisterNode(UPuzzleLogicComponent* Node)
+{
+	if (Nodes.RemoveSingleSwap(Node, false) == 0)
+	{
+		return;
+	}
+
+	//The slot stays in the compiled graph until it's compiled again, but is never evaluated
+	int32 Position;
+	if (Positions.RemoveAndCopyValue(Node, OUT Position))
+	{
+		Order[Position] = nullptr;
+	}
+	bNeedsCompile = true;
+}
+
+void UPuzzleLogicSubsystem::SetSignal(UPuzzleLogicComponent* Node, bool bNewSignal)
+{
+	if (const int32* Position = Positions.Find(Node))
+	{
+		SetSignalAt(*Position, bNewSignal);
+	}
+	else
+	{
+		Node->bSignal = bNewSignal;
+	}
+}
+
+void UPuzzleLogicSubsystem::RefreshNode(UPuzzleLogicComponent* Node, float DelayRemaining)
+{
+	GetWorld()->GetTimerManager().ClearTimer(Node->DelayTimer);
+	Node->bIsDelayElapsed = false;
+	//The evaluation keeps a running delay, so the node only changes once the time it had left is up
+	if (DelayRemaining >= 0.f)
+	{
+		StartDelay(Node, DelayRemaining);
+	}
+
+	if (const int32* Position = Positions.Find(Node))
+	{
+		Signals[*Position] = Node->bSignal;
+		Outputs[*Position] = Node->bOutput;
+		MarkDirty(*Position);
+	}
+}
+
+void UPuzzleLogicSubsystem::SetSignalAt(int32 Position, bool bNewSignal)
+{
+	UPuzzleLogicComponent* Node = Order[Position];
+	if (!Node || Signals[Position] == bNewSignal)
+	{
+		return;
+	}
+
+	Signals[Position] = bNewSignal;
+	Node->bSignal = bNewSignal;
+	MarkDirty(Position);
+}
+
+void UPuzzleLogicSubsystem::MarkDirty(int32 Position)
+{
+	if (!Dirty[Position])
+	{
+		Dirty[Position] = true;
+		DirtyHeap.HeapPush(Position);
+	}
+}
+
+void UPuzzleLogicSubsystem::Compile()
+{
+	bNeedsCompile = false;
+
+	const int32 NodeCount = Nodes.Num();
+	TMap<const UPuzzleLogicComponent*, int32> NodeIndices;
+	NodeIndices.Reserve(NodeCount);
+	for (int32 Index = 0; Index < NodeCount; Index++)
+	{
+		NodeIndices.Add(Nodes[Index], Index);
+	}
+
+	//Edges by the index of the node in Nodes
+	TArray<TArray<int32, TInlineAllocator<4>>> NodeInputs;
+	TArray<TArray<int32, TInlineAllocator<4>>> NodeDependents;
+	TArray<int32> InDegrees;
+	NodeInputs.SetNum(NodeCount);
+	NodeDependents.SetNum(NodeCount);
+	InDegrees.SetNumZeroed(NodeCount);
+	int32 EdgeCount = 0;
+	for (int32 Index = 0; Index < NodeCount; Index++)
+	{
+		const UPuzzleLogicComponent* Node = Nodes[Index];
+		const EPuzzleLogicOperation Operation = Node->Operation;
+		if (Operation == PuzzleLogic_Signal || Operation == PuzzleLogic_Plate || Operation == PuzzleLogic_Interaction)
+		{
+			continue;
+		}
+
+		for (const AActor* InputActor : Node->Inputs)
+		{
+			if (!InputActor) { continue; }
+
+			//Inputs in cells that aren't loaded aren't registered; they join once their cell streams in and the graph is compiled again
+			const UPuzzleLogicComponent* Input = InputActor->FindComponentByClass<UPuzzleLogicComponent>();
+			const int32* InputIndex = Input ? NodeIndices.Find(Input) : nullptr;
+			if (!InputIndex)
+			{
+				UE_LOG(LogTemp, Log, TEXT("Input %s of puzzle logic node %s on %s has no registered puzzle logic component and is ignored."), *InputActor->GetName(), *Node->GetName(), *Node->GetOwner()->GetName());
+				continue;
+			}
+
+			NodeInputs[Index].Add(*InputIndex);
+			NodeDependents[*InputIndex].Add(Index);
+			InDegrees[Index]++;
+			EdgeCount++;
+		}
+	}
+
+	//Kahn's algorithm; every node ends up after all of its inputs
+	TArray<int32> Sorted;
+	Sorted.Reserve(NodeCount);
+	for (int32 Index = 0; Index < NodeCount; Index++)
+	{
+		if (InDegrees[Index] == 0)
+		{
+			Sorted.Add(Index);
+		}
+	}
+	for (int32 Head = 0; Head < Sorted.Num(); Head++)
+	{
+		for (int32 Dependent : NodeDependents[Sorted[Head]])
+		{
+			if (--InDegrees[Dependent] == 0)
+			{
+				Sorted.Add(Dependent);
+			}
+		}
+	}
+
+	//Nodes left with inputs are in a cycle or depend on one; they keep their last output and are left out until the cycle is fixed
+	if (Sorted.Num() < NodeCount)
+	{
+		for (int32 Index = 0; Index < NodeCount; Index++)
+		{
+			if (InDegrees[Index] > 0)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Puzzle logic node %s on %s is part of or depends on a cycle and won't be evaluated!"), *Nodes[Index]->GetName(), *Nodes[Index]->GetOwner()->GetName());
+			}
+		}
+	}
+
+	TArray<int32> NodePositions;
+	NodePositions.Init(INDEX_NONE, NodeCount);
+	for (int32 Position = 0; Position < Sorted.Num(); Position++)
+	{
+		NodePositions[Sorted[Position]] = Position;
+	}
+
+	const int32 CompiledCount = Sorted.Num();
+	Order.Reset(CompiledCount);
+	Operations.Reset(CompiledCount);
+	Inverted.Reset();
+	Sinks.Reset();
+	Signals.Reset();
+	Outputs.Reset();
+	InputOffsets.Reset(CompiledCount + 1);
+	InputPositions.Reset();
+	DependentOffsets.Reset(CompiledCount + 1);
+	DependentPositions.Reset();
+	Positions.Reset();
+	SourcePositions.Reset();
+	for (int32 Position = 0; Position < CompiledCount; Position++)
+	{
+		const int32 Index = Sorted[Position];
+		UPuzzleLogicComponent* Node = Nodes[Index];
+
+		//Plates keep counting mass while the graph isn't compiled, so their signal is taken from the plate itself
+		if (const UMassTreshold* MassTreshold = Cast<UMassTreshold>(Node->SignalSource))
+		{
+			Node->bSignal = MassTreshold->IsAboveTreshold();
+		}
+
+		Order.Add(Node);
+		Operations.Add(Node->Operation);
+		Inverted.Add(Node->bInvertOutput);
+		Sinks.Add(Node->bIsSink);
+		Signals.Add(Node->bSignal);
+		Outputs.Add(Node->bOutput);
+		Positions.Add(Node, Position);
+		if (Node->SignalSource)
+		{
+			SourcePositions.Add(Node->SignalSource, Position);
+		}
+
+		InputOffsets.Add(InputPositions.Num());
+		for (int32 Input : NodeInputs[Index])
+		{
+			InputPositions.Add(NodePositions[Input]);
+		}
+
+		DependentOffsets.Add(DependentPositions.Num());
+		for (int32 Dependent : NodeDependents[Index])
+		{
+			if (NodePositions[Dependent] != INDEX_NONE)
+			{
+				DependentPositions.Add(NodePositions[Dependent]);
+			}
+		}
+	}
+	InputOffsets.Add(InputPositions.Num());
+	DependentOffsets.Add(DependentPositions.Num());
+
+	//Every node is evaluated once after compiling, which also applies the initial outputs of new sinks
+	Dirty.Init(false, CompiledCount);
+	DirtyHeap.Reset();
+	for (int32 Position = 0; Position < CompiledCount; Position++)
+	{
+		MarkDirty(Position);
+	}
+
+	Stats.Nodes = CompiledCount;
+	Stats.Edges = EdgeCount;
+	Stats.Compiles++;
+}
+
+void UPuzzleLogicSubsystem::Evaluate()
+{
+	//Dependents always come after the node that marked them, so popping the lowest position evaluates every node at most once per frame
+	int32 EvaluatedNodes = 0;
+	while (DirtyHeap.Num() > 0)
+	{
+		int32 Position;
+		DirtyHeap.HeapPop(OUT Position, false);
+		Dirty[Position] = false;
+		EvaluatedNodes++;
+
+		if (!EvaluateNode(Position))
+		{
+			continue;
+		}
+
+		for (int32 Edge = DependentOffsets[Position]; Edge < DependentOffsets[Position + 1]; Edge++)
+		{
+			MarkDirty(DependentPositions[Edge]);
+		}
+	}
+
+	Stats.LastEvaluatedNodes = EvaluatedNodes;
+	Stats.Evaluations += EvaluatedNodes;
+}
+
+bool UPuzzleLogicSubsystem::EvaluateNode(int32 Position)
+{
+	UPuzzleLogicComponent* Node = Order[Position];
+	if (!Node)
+	{
+		return false;
+	}
+
+	const int32 FirstInput = InputOffsets[Position];
+	const int32 LastInput = InputOffsets[Position + 1];
+	bool bValue = false;
+	switch (Operations[Position])
+	{
+	case PuzzleLogic_Signal:
+	case PuzzleLogic_Plate:
+	case PuzzleLogic_Interaction:
+		bValue = Signals[Position];
+		break;
+	case PuzzleLogic_And:
+		bValue = LastInput > FirstInput;
+		for (int32 Input = FirstInput; Input < LastInput && bValue; Input++)
+		{
+			bValue = Outputs[InputPositions[Input]];
+		}
+		break;
+	default:
+		for (int32 Input = FirstInput; Input < LastInput && !bValue; Input++)
+		{
+			bValue = Outputs[InputPositions[Input]];
+		}
+		break;
+	}
+	bValue = bValue != Inverted[Position];
+
+	const bool bIsChanged = bValue != Outputs[Position];
+	if (Operations[Position] == PuzzleLogic_Delay)
+	{
+		//A change has to last for the whole delay; going back cancels it
+		if (!bIsChanged)
+		{
+			GetWorld()->GetTimerManager().ClearTimer(Node->DelayTimer);
+			Node->bIsDelayElapsed = false;
+			return false;
+		}
+		if (!Node->bIsDelayElapsed && Node->Delay > 0.f)
+		{
+			if (!GetWorld()->GetTimerManager().IsTimerActive(Node->DelayTimer))
+			{
+				StartDelay(Node, Node->Delay);
+			}
+			return false;
+		}
+		Node->bIsDelayElapsed = false;
+	}
+
+	//Sinks that never applied their output do it once, so doors and interactables start out matching the graph
+	if (!bIsChanged && (!Sinks[Position] || Node->bHasAppliedOutput))
+	{
+		return false;
+	}
+
+	Outputs[Position] = bValue;
+	Node->bOutput = bValue;
+	if (Sinks[Position])
+	{
+		Node->ApplyOutput();
+		Stats.SinkChanges++;
+	}
+	return bIsChanged;
+}
+
+void UPuzzleLogicSubsystem::StartDelay(UPuzzleLogicComponent* Node, float Duration)
+{
+	FTimerDelegate DelayElapsed = FTimerDelegate::CreateUObject(this, &UPuzzleLogicSubsystem::OnDelayElapsed, TWeakObjectPtr<UPuzzleLogicComponent>(Node));
+	//A zero rate would clear the timer instead of setting it
+	GetWorld()->GetTimerManager().SetTimer(Node->DelayTimer, DelayElapsed, FMath::Max(Duration, KINDA_SMALL_NUMBER), false);
+}
+
+void UPuzzleLogicSubsystem::OnDelayElapsed(TWeakObjectPtr<UPuzzleLogicComponent> Node)
+{
+	if (!Node.IsValid())
+	{
+		return;
+	}
+
+	Node->bIsDelayElapsed = true;
+	if (const int32* Position = Positions.Find(Node.Get()))
+	{
+		MarkDirty(*Position);
+	}
+}
+
+void UPuzzleLogicSubsystem::OnMassTresholdEvent(const FMassTresholdEvent& Event)
+{
+	for (TMultiMap<const UObject*, int32>::TConstKeyIterator It(SourcePositions, Event.Source.Get()); It; ++It)
+	{
+		SetSignalAt(It.Value(), Event.bIsAboveTreshold);
+	}
+}
+
+void UPuzzleLogicSubsystem::OnInteractionEvent(const FInteractionEvent& Event)
+{
+	if (!Event.Source.IsValid())
+	{
+		return;
+	}
+
+	//Held interactables are on while held; used ones flip with every use
+	const bool bIsHold = Event.Source->GetInteractionType() == Hold;
+	for (TMultiMap<const UObject*, int32>::TConstKeyIterator It(SourcePositions, Event.Source.Get()); It; ++It)
+	{
+		if (bIsHold)
+		{
+			SetSignalAt(It.Value(), Event.bIsStart);
+		}
+		else if (Event.bIsStart)
+		{
+			SetSignalAt(It.Value(), !Signals[It.Value()]);
+		}
+	}
+}
+
+FPuzzleLogicStats UPuzzleLogicSubsystem::GetStats() const
+{
+	return Stats;
+}
+
+void UPuzzleLogicSubsystem::ResetStats()
+{
+	Stats = FPuzzleLogicStats();
+}
@@ -0,0 +1,111 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "PuzzleLogicSubsystem.generated.h"
+
+class UPuzzleLogicComponent;
+struct FMassTresholdEvent;
+struct FInteractionEvent;
+
+USTRUCT(BlueprintType)
+struct FPuzzleLogicStats
+{
+	GENERATED_BODY()
+
+	//Nodes and edges of the compiled graph; nodes in a cycle aren't part of it
+	UPROPERTY(BlueprintReadOnly, Category = "Puzzle Logic")
+	int32 Nodes = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Puzzle Logic")
+	int32 Edges = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Puzzle Logic")
+	int32 Compiles = 0;
+
+	//Nodes evaluated in the last frame anything was dirty
+	UPROPERTY(BlueprintReadOnly, Category = "Puzzle Logic")
+	int32 LastEvaluatedNodes = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Puzzle Logic")
+	int32 Evaluations = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Puzzle Logic")
+	int32 SinkChanges = 0;
+};
+
+/**
+ * Compiles the puzzle logic components of the world into a flat graph, sorted so every node comes after its inputs, and evaluates it once per frame.
+ * Only nodes whose signal or inputs changed are evaluated; a changed output marks its dependents, which always come later in the order, so a single pass settles the graph.
+ * Plates and interactables are followed through the gameplay event bus, and the graph is compiled again whenever nodes register or leave(e.g. when cells stream).
+ * Runs on the server only; clients just receive the outputs of the sinks.
+ */
+UCLASS()
+class BUILDING_ESCAPE_API UPuzzleLogicSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	void RegisterNode(UPuzzleLogicComponent* Node);
+	void UnregisterNode(UPuzzleLogicComponent* Node);
+	void SetSignal(UPuzzleLogicComponent* Node, bool bNewSignal);
+	//Takes over a signal and output set on the node from outside the graph(e.g. by a restored checkpoint) and evaluates it again.
+	//A pending delay is replaced by one with DelayRemaining seconds left, or dropped if that's negative
+	void RefreshNode(UPuzzleLogicComponent* Node, float DelayRemaining);
+
+	UFUNCTION(BlueprintPure, Category = "Puzzle Logic")
+	FPuzzleLogicStats GetStats() const;
+
+	UFUNCTION(BlueprintCallable, Category = "Puzzle Logic")
+	void ResetStats();
+
+private:
+	TArray<UPuzzleLogicComponent*> Nodes;
+	bool bNeedsCompile = false;
+
+	//The compiled graph; everything is indexed by the position of the node in the evaluation order.
+	//Inputs and dependents of a node are the ranges [Offsets[Position], Offsets[Position + 1]) of the flat arrays
+	TArray<UPuzzleLogicComponent*> Order;
+	TArray<uint8> Operations;
+	TBitArray<> Inverted;
+	TBitArray<> Sinks;
+	TBitArray<> Signals;
+	TBitArray<> Outputs;
+	TArray<int32> InputOffsets;
+	TArray<int32> InputPositions;
+	TArray<int32> DependentOffsets;
+	TArray<int32> DependentPositions;
+	TMap<const UPuzzleLogicComponent*, int32> Positions;
+	TMultiMap<const UObject*, int32> SourcePositions;
+
+	//Min heap of dirty positions, so nodes are evaluated in order no matter in which order they got dirty
+	TArray<int32> DirtyHeap;
+	TBitArray<> Dirty;
+
+	FDelegateHandle MassTresholdHandle;
+	FDelegateHandle InteractionHandle;
+	FPuzzleLogicStats Stats;
+
+	void Compile();
+	void Evaluate();
+	bool EvaluateNode(int32 Position);
+	void MarkDirty(int32 Position);
+	void SetSignalAt(int32 Position, bool bNewSignal);
+	void StartDelay(UPuzzleLogicComponent* Node, float Duration);
+	void OnDelayElapsed(TWeakObjectPtr<UPuzzleLogicComponent> Node);
+
+	void OnMassTresholdEvent(const FMassTresholdEvent& Event);
+	void OnInteractionEvent(const FInteractionEvent& Event);
+};
@@ -0,0 +1,232 @@
+// Copyright Roch Karwacki 2020
+
+
+#include "TraceSchedulerSubsystem.h"
+#include "Engine/World.h"
+
+void UTraceSchedulerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TraceDoneDelegate.BindUObject(this, &UTraceSchedulerSubsystem::OnTraceDone);
+	ResetStats();
+}
+
+void UTraceSchedulerSubsystem::Deinitialize()
+{
+	for (TArray<FPendingTrace>& Queue : Queues)
+	{
+		Queue.Empty();
+	}
+	InFlight.Empty();
+	TraceDoneDelegate.Unbind();
+
+	Super::Deinitialize();
+}
+
+bool UTraceSchedulerSubsystem::IsTickable() const
+{
+	return GetWorld() && GetWorld()->IsGameWorld();
+}
+
+TStatId UTraceSchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTraceSchedulerSubsystem, STATGROUP_Tickables);
+}
+
+uint32 UTraceSchedulerSubsystem::SubmitTrace(const FScheduledTraceRequest& Request)
+{
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+
+	FPendingTrace& PendingTrace = Queues[Request.Priority].AddDefaulted_GetRef();
+	PendingTrace.Request = Request;
+	PendingTrace.RequestId = NextRequestId;
+	PendingTrace.SubmitTime = CurrentTime;
+	PendingTrace.DeadlineTime = CurrentTime + (Request.Deadline >= 0.f ? Request.Deadline : GetDefaultDeadline(Request.Priority));
+
+	//0 is kept free so requesters can use it for "nothing pending"
+	NextRequestId = NextRequestId == MAX_uint32 ? 1 : NextRequestId + 1;
+	Stats.Priorities[Request.Priority].Submitted++;
+	return PendingTrace.RequestId;
+}
+
+void UTraceSchedulerSubsystem::CancelRequests(const UObject* Requester)
+{
+	for (TArray<FPendingTrace>& Queue : Queues)
+	{
+		Queue.RemoveAll([Requester](const FPendingTrace& PendingTrace) { return PendingTrace.Request.Requester == Requester; });
+	}
+}
+
+void UTraceSchedulerSubsystem::RecordImmediateTraces(ETracePriority Priority, int32 Count)
+{
+	ImmediateThisFrame += Count;
+	Stats.Priorities[Priority].Submitted += Count;
+	Stats.Priorities[Priority].Dispatched += Count;
+}
+
+void UTraceSchedulerSubsystem::Tick(float DeltaTime)
+{
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	int32 Budget = FMath::Max(0, MaxTracesPerFrame - ImmediateThisFrame);
+
+	//Critical requests can't wait, so they are dispatched even if the budget is already used up
+	for (FPendingTrace& PendingTrace : Queues[TracePriority_Critical])
+	{
+		Dispatch(PendingTrace);
+		Budget--;
+	}
+	Budget = FMath::Max(0, Budget);
+
+	//Late requests go first, then the others by priority
+	DispatchLate(Budget, CurrentTime);
+	for (int32 Priority = TracePriority_High; Priority < TracePriority_MAX; Priority++)
+	{
+		DispatchRoundRobin(Queues[Priority], Budget);
+	}
+
+	Stats.PendingRequests = 0;
+	for (int32 Priority = 0; Priority < TracePriority_MAX; Priority++)
+	{
+		TArray<FPendingTrace>& Queue = Queues[Priority];
+		Queue.RemoveAll([](const FPendingTrace& PendingTrace) { return PendingTrace.bIsDispatched; });
+
+		//Queues are kept oldest first, so the starving requests are at the front
+		int32 Starving = 0;
+		while (Starving < Queue.Num() && CurrentTime - Queue[Starving].SubmitTime > StarvationThreshold)
+		{
+			Starving++;
+		}
+		Stats.Priorities[Priority].Starving = Starving;
+		Stats.PendingRequests += Queue.Num();
+	}
+
+	Stats.DispatchedLastFrame = DispatchedThisFrame;
+	Stats.ImmediateLastFrame = ImmediateThisFrame;
+	DispatchedThisFrame = 0;
+	ImmediateThisFrame = 0;
+}
+
+void UTraceSchedulerSubsystem::DispatchLate(int32& Budget, float CurrentTime)
+{
+	for (int32 Priority = TracePriority_High; Priority < TracePriority_MAX && Budget > 0; Priority++)
+	{
+		for (FPendingTrace& PendingTrace : Queues[Priority])
+		{
+			if (Budget <= 0) { return; }
+			if (PendingTrace.DeadlineTime > CurrentTime) { continue; }
+
+			Dispatch(PendingTrace);
+			Stats.Priorities[Priority].LateDispatches++;
+			Budget--;
+		}
+	}
+}
+
+void UTraceSchedulerSubsystem::DispatchRoundRobin(TArray<FPendingTrace>& Queue, int32& Budget)
+{
+	//Every pass serves the oldest remaining request of each requester once, until the budget or the queue runs out
+	TArray<const UObject*, TInlineAllocator<8>> ServedRequesters;
+	bool bDispatchedAny = true;
+	while (Budget > 0 && bDispatchedAny)
+	{
+		bDispatchedAny = false;
+		ServedRequesters.Reset();
+		for (FPendingTrace& PendingTrace : Queue)
+		{
+			if (Budget <= 0) { return; }
+			if (PendingTrace.bIsDispatched || ServedRequesters.Contains(PendingTrace.Request.Requester)) { continue; }
+
+			Dispatch(PendingTrace);
+			ServedRequesters.Add(PendingTrace.Request.Requester);
+			bDispatchedAny = true;
+			Budget--;
+		}
+	}
+}
+
+void UTraceSchedulerSubsystem::Dispatch(FPendingTrace& PendingTrace)
+{
+	const FScheduledTraceRequest& Request = PendingTrace.Request;
+
+	FInFlightTrace InFlightTrace;
+	InFlightTrace.RequestId = PendingTrace.RequestId;
+	InFlightTrace.UserData = Request.UserData;
+	InFlightTrace.Priority = Request.Priority;
+	InFlightTrace.SubmitTime = PendingTrace.SubmitTime;
+	InFlightTrace.Delegate = Request.Delegate;
+	const int32 InFlightIndex = InFlight.Add(InFlightTrace);
+
+	//All the traces dispatched during a frame run as one asynchronous batch; their results come back through OnTraceDone on the next frame
+	GetWorld()->AsyncLineTraceByObjectType
+	(
+		EAsyncTraceType::Single,
+		Request.Start,
+		Request.End,
+		Request.ObjectQueryParams,
+		Request.QueryParams,
+		&TraceDoneDelegate,
+		(uint32)InFlightIndex
+	);
+
+	PendingTrace.bIsDispatched = true;
+	Stats.Priorities[Request.Priority].Dispatched++;
+	DispatchedThisFrame++;
+}
+
+void UTraceSchedulerSubsystem::OnTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	const int32 InFlightIndex = (int32)TraceDatum.UserData;
+	if (!InFlight.IsAllocated(InFlightIndex))
+	{
+		return;
+	}
+
+	//The entry is moved out first, so requesters may submit again from within the delegate
+	const FInFlightTrace InFlightTrace = InFlight[InFlightIndex];
+	InFlight.RemoveAt(InFlightIndex);
+
+	FScheduledTraceResult Result;
+	Result.RequestId = InFlightTrace.RequestId;
+	Result.UserData = InFlightTrace.UserData;
+	Result.Latency = GetWorld()->GetTimeSeconds() - InFlightTrace.SubmitTime;
+	if (TraceDatum.OutHits.Num() > 0)
+	{
+		Result.HitResult = TraceDatum.OutHits[0];
+		Result.bHasBlockingHit = Result.HitResult.bBlockingHit;
+	}
+
+	//Averaging over roughly the last ten results keeps the stat readable while the demand changes
+	FTracePriorityStats& PriorityStats = Stats.Priorities[InFlightTrace.Priority];
+	const float LatencyMilliseconds = Result.Latency * 1000.f;
+	PriorityStats.AverageLatencyMilliseconds = FMath::Lerp(PriorityStats.AverageLatencyMilliseconds, LatencyMilliseconds, 0.1f);
+	PriorityStats.MaxLatencyMilliseconds = FMath::Max(PriorityStats.MaxLatencyMilliseconds, LatencyMilliseconds);
+
+	InFlightTrace.Delegate.ExecuteIfBound(Result);
+}
+
+FTraceSchedulerStats UTraceSchedulerSubsystem::GetStats() const
+{
+	return Stats;
+}
+
+void UTraceSchedulerSubsystem::ResetStats()
+{
+	Stats = FTraceSchedulerStats();
+	Stats.Priorities.SetNum(TracePriority_MAX);
+}
+
+float UTraceSchedulerSubsystem::GetDefaultDeadline(ETracePriority Priority) const
+{
+	switch (Priority)
+	{
+	case TracePriority_Critical:
+		return 0.f;
+	case TracePriority_High:
+		return HighPriorityDeadline;
+	case TracePriority_Normal:
+		return NormalPriorityDeadline;
+	default:
+		return LowPriorityDeadline;
+	}
+}
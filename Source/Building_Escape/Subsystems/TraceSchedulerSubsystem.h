@@ -0,0 +1,184 @@
+// Copyright Roch Karwacki 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "TraceSchedulerSubsystem.generated.h"
+
+UENUM(BlueprintType)
+enum ETracePriority
+{
+	//Never deferred; used for traces whose result decides what happens this frame
+	TracePriority_Critical   UMETA(DisplayName = "Critical"),
+	TracePriority_High   UMETA(DisplayName = "High"),
+	TracePriority_Normal   UMETA(DisplayName = "Normal"),
+	TracePriority_Low   UMETA(DisplayName = "Low"),
+	TracePriority_MAX   UMETA(Hidden)
+};
+
+struct FScheduledTraceResult
+{
+	uint32 RequestId = 0;
+	uint32 UserData = 0;
+	bool bHasBlockingHit = false;
+	FHitResult HitResult;
+	//Seconds between the submission and the delivery of the result
+	float Latency = 0.f;
+};
+
+DECLARE_DELEGATE_OneParam(FScheduledTraceDelegate, const FScheduledTraceResult&);
+
+//A single line trace against the given object types; the result is delivered through the delegate on the frame after the trace was dispatched
+struct FScheduledTraceRequest
+{
+	FVector Start = FVector::ZeroVector;
+	FVector End = FVector::ZeroVector;
+	FCollisionObjectQueryParams ObjectQueryParams;
+	FCollisionQueryParams QueryParams;
+	TEnumAsByte<ETracePriority> Priority = TracePriority_Normal;
+	//Seconds the request may wait for the budget; late requests are served before anything else. A negative value uses the default of the priority
+	float Deadline = -1.f;
+	//Deferred requests are served round-robin between requesters, so a single system can't use up the whole budget
+	const UObject* Requester = nullptr;
+	uint32 UserData = 0;
+	FScheduledTraceDelegate Delegate;
+};
+
+USTRUCT(BlueprintType)
+struct FTracePriorityStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	int32 Submitted = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	int32 Dispatched = 0;
+
+	//Requests dispatched after their deadline passed
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	int32 LateDispatches = 0;
+
+	//Requests currently waiting for longer than the starvation threshold
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	int32 Starving = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	float AverageLatencyMilliseconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	float MaxLatencyMilliseconds = 0.f;
+};
+
+USTRUCT(BlueprintType)
+struct FTraceSchedulerStats
+{
+	GENERATED_BODY()
+
+	//Indexed by ETracePriority
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	TArray<FTracePriorityStats> Priorities;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	int32 PendingRequests = 0;
+
+	//Queries dispatched by the scheduler during the last frame
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	int32 DispatchedLastFrame = 0;
+
+	//Queries systems ran on their own during the last frame and reported with RecordImmediateTraces
+	UPROPERTY(BlueprintReadOnly, Category = "Trace Scheduler")
+	int32 ImmediateLastFrame = 0;
+};
+
+/**
+ * Shares a per-frame budget of scene queries between the interaction and the parkour systems, so their traces can't spike together.
+ * Requests are dispatched as asynchronous traces in order of priority: critical ones always, late ones next, the rest round-robin between requesters
+ * until the budget is used up. Whatever doesn't fit waits for the next frame.
+ * Queries that have to run right away are still run by their systems, but are reported so they take their share of the budget.
+ * The budget and the deadlines are read from the [/Script/Building_Escape.TraceSchedulerSubsystem] section of DefaultGame.ini.
+ */
+UCLASS(Config = Game)
+class BUILDING_ESCAPE_API UTraceSchedulerSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//Returns the id the result will carry; never 0
+	uint32 SubmitTrace(const FScheduledTraceRequest& Request);
+	//Drops every request of the requester that wasn't dispatched yet
+	void CancelRequests(const UObject* Requester);
+	//Counts queries a system ran synchronously this frame against the budget
+	void RecordImmediateTraces(ETracePriority Priority, int32 Count);
+
+	UFUNCTION(BlueprintPure, Category = "Trace Scheduler")
+	FTraceSchedulerStats GetStats() const;
+
+	UFUNCTION(BlueprintCallable, Category = "Trace Scheduler")
+	void ResetStats();
+
+private:
+	struct FPendingTrace
+	{
+		FScheduledTraceRequest Request;
+		uint32 RequestId = 0;
+		float SubmitTime = 0.f;
+		float DeadlineTime = 0.f;
+		bool bIsDispatched = false;
+	};
+
+	struct FInFlightTrace
+	{
+		uint32 RequestId = 0;
+		uint32 UserData = 0;
+		TEnumAsByte<ETracePriority> Priority = TracePriority_Normal;
+		float SubmitTime = 0.f;
+		FScheduledTraceDelegate Delegate;
+	};
+
+	//One queue per priority, oldest requests first
+	TArray<FPendingTrace> Queues[TracePriority_MAX];
+	TSparseArray<FInFlightTrace> InFlight;
+	FTraceDelegate TraceDoneDelegate;
+	uint32 NextRequestId = 1;
+
+	int32 ImmediateThisFrame = 0;
+	int32 DispatchedThisFrame = 0;
+	FTraceSchedulerStats Stats;
+
+	void Dispatch(FPendingTrace& PendingTrace);
+	void DispatchLate(int32& Budget, float CurrentTime);
+	void DispatchRoundRobin(TArray<FPendingTrace>& Queue, int32& Budget);
+	void OnTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+	float GetDefaultDeadline(ETracePriority Priority) const;
+
+	//Scene queries allowed per frame, the immediate ones included
+	UPROPERTY(Config)
+	int32 MaxTracesPerFrame = 48;
+
+	//Default deadlines of the deferrable priorities, in seconds
+	UPROPERTY(Config)
+	float HighPriorityDeadline = 0.05f;
+
+	UPROPERTY(Config)
+	float NormalPriorityDeadline = 0.1f;
+
+	UPROPERTY(Config)
+	float LowPriorityDeadline = 0.3f;
+
+	//Requests waiting longer than this are reported as starving
+	UPROPERTY(Config)
+	float StarvationThreshold = 0.5f;
+};